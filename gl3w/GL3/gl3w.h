@@ -621,6 +621,7 @@ extern PFNGLTEXSTORAGE2DMULTISAMPLEPROC gl3wTexStorage2DMultisample;
 extern PFNGLTEXSTORAGE3DMULTISAMPLEPROC gl3wTexStorage3DMultisample;
 extern PFNGLTEXTURESTORAGE2DMULTISAMPLEEXTPROC gl3wTextureStorage2DMultisampleEXT;
 extern PFNGLTEXTURESTORAGE3DMULTISAMPLEEXTPROC gl3wTextureStorage3DMultisampleEXT;
+extern PFNGLBUFFERSTORAGEPROC gl3wBufferStorage;
 
 #define glCullFace		gl3wCullFace
 #define glFrontFace		gl3wFrontFace
@@ -1226,6 +1227,7 @@ extern PFNGLTEXTURESTORAGE3DMULTISAMPLEEXTPROC gl3wTextureStorage3DMultisampleEX
 #define glTexStorage3DMultisample		gl3wTexStorage3DMultisample
 #define glTextureStorage2DMultisampleEXT		gl3wTextureStorage2DMultisampleEXT
 #define glTextureStorage3DMultisampleEXT		gl3wTextureStorage3DMultisampleEXT
+#define glBufferStorage		gl3wBufferStorage
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,180 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Headless basin-of-attraction renderer.
+    @file mpsim_basin.cpp
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "src/BasinRenderer.h"
+#include "src/PendulumParams.h"
+
+
+void printUsage( const char* prog ) {
+    fprintf(stderr,"Usage: %s [options] params.par\n\n",prog);
+    fprintf(stderr,"  -w <width>        width of basin map (default: 512)\n");
+    fprintf(stderr,"  -h <height>       height of basin map (default: 512)\n");
+    fprintf(stderr,"  -o <file.ppm>     colored basin map (default: basin.ppm)\n");
+    fprintf(stderr,"  -r <file.raw>     raw magnet index and capture time\n");
+    fprintf(stderr,"  -t <threads>      number of threads (default: all cores)\n");
+    fprintf(stderr,"  -s <tileSize>     edge length of a tile (default: 32)\n");
+    fprintf(stderr,"  --tscale <val>    time scaling of color, 0 disables it (default: 1)\n");
+    fprintf(stderr,"  --tmax <val>      maximum integration time (default: 100)\n");
+    fprintf(stderr,"  --eps <val>       integration tolerance (default: 1e-8)\n");
+    fprintf(stderr,"  --method <name>   cashkarp, dopri5, bs23 (default: parameter file)\n");
+    fprintf(stderr,"  --simd <level>    auto, off, sse2, avx2, avx512, neon (default: auto)\n");
+    fprintf(stderr,"  --mode <name>     full, mariani (Mariani-Silver subdivision) (default: full)\n");
+    fprintf(stderr,"  --verify <val>    verification samples per pixel in mariani mode (default: 0)\n");
+    fprintf(stderr,"  --grid <n>        nodes per axis of the tabulated magnet field, 0 = exact (default: parameter file)\n");
+    fprintf(stderr,"  --theta <val>     opening angle of the magnet tree, 0 = exact (default: parameter file)\n");
+}
+
+
+int main( int argc, char* argv[] )
+{
+    int width = 512;
+    int height = 512;
+    int numThreads = 0;
+    int tileSize = 32;
+    double tScale = 1.0;
+    double tMax = 100.0;
+    double eps = 1e-8;
+    simdLevel simd = SIMD_AUTO;
+    basinMode mode = BASIN_FULL;
+    double verifyDensity = 0.0;
+    int fieldGrid = -1;
+    double treeTheta = -1.0;
+    const char* methodName = NULL;
+    const char* parFilename = NULL;
+    const char* imgFilename = "basin.ppm";
+    const char* rawFilename = NULL;
+
+    for(int i=1; i<argc; i++) {
+        bool hasArg = (i+1<argc);
+        if (strcmp(argv[i],"-w")==0 && hasArg) {
+            width = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i],"-h")==0 && hasArg) {
+            height = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i],"-o")==0 && hasArg) {
+            imgFilename = argv[++i];
+        }
+        else if (strcmp(argv[i],"-r")==0 && hasArg) {
+            rawFilename = argv[++i];
+        }
+        else if (strcmp(argv[i],"-t")==0 && hasArg) {
+            numThreads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i],"-s")==0 && hasArg) {
+            tileSize = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i],"--tscale")==0 && hasArg) {
+            tScale = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i],"--tmax")==0 && hasArg) {
+            tMax = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i],"--eps")==0 && hasArg) {
+            eps = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i],"--method")==0 && hasArg) {
+            methodName = argv[++i];
+        }
+        else if (strcmp(argv[i],"--simd")==0 && hasArg) {
+            simd = SimdStepper::LevelFromName(argv[++i]);
+        }
+        else if (strcmp(argv[i],"--mode")==0 && hasArg) {
+            i++;
+            if (strcmp(argv[i],"full")==0) {
+                mode = BASIN_FULL;
+            } else if (strcmp(argv[i],"mariani")==0) {
+                mode = BASIN_MARIANI_SILVER;
+            } else {
+                fprintf(stderr,"Unknown mode %s\n",argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i],"--verify")==0 && hasArg) {
+            verifyDensity = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i],"--grid")==0 && hasArg) {
+            fieldGrid = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i],"--theta")==0 && hasArg) {
+            treeTheta = atof(argv[++i]);
+        }
+        else if (argv[i][0]!='-' && parFilename==NULL) {
+            parFilename = argv[i];
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (parFilename==NULL || width<1 || height<1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    PendulumParams params;
+    if (!params.LoadParams(parFilename)) {
+        return 1;
+    }
+    if (methodName!=NULL && !RKMethodFromName(methodName,params.m_integrator)) {
+        fprintf(stderr,"Unknown integration method %s\n",methodName);
+        return 1;
+    }
+    if (fieldGrid>=0) {
+        params.m_fieldGrid = fieldGrid;
+    }
+    if (treeTheta>=0.0) {
+        params.m_treeTheta = treeTheta;
+    }
+
+    BasinRenderer renderer(params);
+    renderer.SetResolution(width,height);
+    renderer.SetNumThreads(numThreads);
+    renderer.SetTileSize(tileSize);
+    renderer.SetMaxTime(tMax);
+    renderer.SetTolerance(eps);
+    renderer.SetSimdLevel(simd);
+    renderer.SetMode(mode);
+    renderer.SetVerifyDensity(verifyDensity);
+
+    fprintf(stderr,"Render %dx%d basin map with %d magnets (%s, force: %s, simd: %s) ...\n",width,height,
+            static_cast<int>(params.m_magnets.size()),RKMethodName(renderer.GetMethod()),
+            ForceLawName(ForceLawFromKappa(params.m_kappa)),SimdStepper::LevelName(renderer.GetSimdLevel()));
+    const MagnetTree &tree = renderer.GetMagnetTable().Tree();
+    if (tree.IsValid()) {
+        fprintf(stderr,"    magnet tree with %d nodes, opening angle %g\n",tree.NumNodes(),tree.OpeningAngle());
+    }
+    const FieldGrid &grid = renderer.GetMagnetTable().Grid();
+    if (grid.IsValid()) {
+        double maxAbs, maxRel;
+        grid.EstimateError(renderer.GetMagnetTable(),maxAbs,maxRel);
+        fprintf(stderr,"    field grid %dx%d, max. error %g (%g relative)\n",grid.NumNodes(),grid.NumNodes(),maxAbs,maxRel);
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    renderer.Render();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr,"... done in %.2f sec, %ld of %d pixels integrated\n",sec,renderer.NumIntegrated(),width*height);
+
+    if (!renderer.WriteImage(imgFilename,tScale)) {
+        return 1;
+    }
+    if (rawFilename!=NULL && !renderer.WriteRaw(rawFilename)) {
+        return 1;
+    }
+    return 0;
+}
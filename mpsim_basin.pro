@@ -0,0 +1,33 @@
+######################################################################  headless basin renderer
+#
+#  Does not need Qt libraries, OpenGL or a display:
+#      qmake mpsim_basin.pro && make
+#      ./mpsim-basin -w 1024 -h 1024 -o basin.ppm examples/exp.par
+#
+
+include( mpsim_core.pri )
+
+TOP_DIR = $$PWD
+
+CONFIG  += console warn_on
+CONFIG  -= qt app_bundle
+TEMPLATE = app
+
+INCLUDEPATH += . $$CORE_DIR
+
+HEADERS += $$CORE_HEADERS
+SOURCES += $$CORE_SOURCES mpsim_basin.cpp
+
+TARGET  = mpsim-basin
+DESTDIR = $$TOP_DIR
+
+CONFIG(debug, debug|release) {
+    OBJECTS_DIR = $$TOP_DIR/compiled/basin/debug/object
+}
+CONFIG(release, debug|release) {
+    OBJECTS_DIR = $$TOP_DIR/compiled/basin/release/object
+}
+
+unix:!macx {
+    QMAKE_CXXFLAGS += -Wall -Wno-comment
+}
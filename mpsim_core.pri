@@ -0,0 +1,47 @@
+######################################################################  Qt-free simulation core
+
+CORE_DIR = $$PWD/src
+
+CORE_HEADERS = $$CORE_DIR/PendulumParams.h \
+               $$CORE_DIR/TileScheduler.h \
+               $$CORE_DIR/ForceLaw.h \
+               $$CORE_DIR/FieldGrid.h \
+               $$CORE_DIR/MagnetTable.h \
+               $$CORE_DIR/MagnetTree.h \
+               $$CORE_DIR/RKStepper.h \
+               $$CORE_DIR/Equilibria.h \
+               $$CORE_DIR/SimdStepper.h \
+               $$CORE_DIR/SimdKernel.inl \
+               $$CORE_DIR/BasinCostMap.h \
+               $$CORE_DIR/BasinRenderer.h \
+               $$CORE_DIR/BasinService.h \
+               $$CORE_DIR/BasinTileCache.h \
+               $$CORE_DIR/TrajectoryStore.h \
+               $$CORE_DIR/PolylineSimplifier.h \
+               $$CORE_DIR/TrajectoryService.h
+
+CORE_SOURCES = $$CORE_DIR/PendulumParams.cpp \
+               $$CORE_DIR/TileScheduler.cpp \
+               $$CORE_DIR/FieldGrid.cpp \
+               $$CORE_DIR/MagnetTable.cpp \
+               $$CORE_DIR/MagnetTree.cpp \
+               $$CORE_DIR/Equilibria.cpp \
+               $$CORE_DIR/SimdStepper.cpp \
+               $$CORE_DIR/SimdStepper_sse2.cpp \
+               $$CORE_DIR/SimdStepper_avx2.cpp \
+               $$CORE_DIR/SimdStepper_avx512.cpp \
+               $$CORE_DIR/SimdStepper_neon.cpp \
+               $$CORE_DIR/BasinCostMap.cpp \
+               $$CORE_DIR/BasinRenderer.cpp \
+               $$CORE_DIR/BasinService.cpp \
+               $$CORE_DIR/BasinTileCache.cpp \
+               $$CORE_DIR/TrajectoryStore.cpp \
+               $$CORE_DIR/PolylineSimplifier.cpp \
+               $$CORE_DIR/TrajectoryService.cpp
+
+CONFIG += c++11 thread
+
+unix:!macx {
+    QMAKE_CXXFLAGS += -std=c++11
+    LIBS += -lpthread
+}
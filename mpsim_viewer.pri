@@ -19,6 +19,7 @@ MY_HEADERS  = $$SRC_DIR/qtdefs.h \
               $$SRC_DIR/MainWindow.h \
               $$SRC_DIR/OpenGL2d.h \
               $$SRC_DIR/OpenGL3d.h \
+              $$SRC_DIR/ParticleThread.h \
               $$SRC_DIR/SystemData.h \
               $$SRC_DIR/SystemView.h \
               $$SRC_DIR/DoubleEdit.h \
@@ -29,6 +30,7 @@ MY_HEADERS  = $$SRC_DIR/qtdefs.h \
 MY_SOURCES  = $$SRC_DIR/MainWindow.cpp \
               $$SRC_DIR/OpenGL2d.cpp \
               $$SRC_DIR/OpenGL3d.cpp \
+              $$SRC_DIR/ParticleThread.cpp \
               $$SRC_DIR/SystemData.cpp \
               $$SRC_DIR/SystemView.cpp \
               $$SRC_DIR/DoubleEdit.cpp \
@@ -36,6 +38,8 @@ MY_SOURCES  = $$SRC_DIR/MainWindow.cpp \
               $$SRC_DIR/Camera.cpp \
               $$SRC_DIR/glutils.cpp
 
+# Qt-free simulation core, shared with mpsim-basin
+include( mpsim_core.pri )
 
 ######################################################################  INCLUDE and DEPEND
 
@@ -73,9 +77,8 @@ OTHER_FILES += $$SHD_DIR/quad.frag \
                $$SHD_DIR/rod.vert \
                $$SHD_DIR/rod.geom \
                $$SHD_DIR/rod.frag \
-               $$SHD_DIR/pendulum.vert \
-               $$SHD_DIR/pendulum.frag \
                $$SHD_DIR/pendulum.comp \
+               $$SHD_DIR/activelist.comp \
                $$SHD_DIR/magnet.vert \
                $$SHD_DIR/magnet.geom \
                $$SHD_DIR/magnet.frag \
@@ -97,8 +100,8 @@ QT += widgets
 }
 
 ######################################################################  Input
-HEADERS += $$MY_HEADERS
-SOURCES += $$MY_SOURCES $$PROJECT_MAIN
+HEADERS += $$MY_HEADERS $$CORE_HEADERS
+SOURCES += $$MY_SOURCES $$CORE_SOURCES $$PROJECT_MAIN
 
 RESOURCES += mpsim_viewer.qrc
 
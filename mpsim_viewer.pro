@@ -1,8 +1,5 @@
 HOME=$$system(echo $HOME)
 
-# If your graphics board supports compute shader
-DEFINES += HAVE_COMP_SHADER
-
 # To have access to all parameters
 #DEFINES += EXPERT_MODE
 
@@ -1,12 +1,59 @@
 #version 330
 
+// basin map written by pendulum.comp, supersample x supersample texels per pixel
+uniform usampler2D basinClass;   // 0 while undecided, magnet index + 1 otherwise; CLASS_DECIDED when finished
+uniform sampler2D  basinTime;    // integration time of the sample
+uniform int   supersample;
+uniform int   overlay;           // pixels without a finished sample are left out, see OpenGL2d::drawBasin
 
-uniform sampler2D tex;
+uniform vec3  initColor;
+uniform samplerBuffer palette;   // magnet colors
+uniform float tScale;
 
 layout(location = 0) out vec4 fragColor;
 in vec2 texCoords;
 
+#define CLASS_DECIDED  0x8000u
+
+// Samples are integrated coarse to fine, see OpenGL2d::activateStage. One
+// that is not finished yet shows the nearest finished sample of the lattices
+// of every second and every fourth sample, so the map is upscaled at first.
+vec3 sampleColor( ivec2 tex, inout int numDecided ) {
+    uint cls = texelFetch(basinClass,tex,0).r;
+    for(int s=1; s<=3 && (cls & CLASS_DECIDED)==0u; s+=2) {
+        ivec2 coarse = tex & ivec2(~s);
+        uint c = texelFetch(basinClass,coarse,0).r;
+        if ((c & CLASS_DECIDED)!=0u) {
+            tex = coarse;
+            cls = c;
+        }
+    }
+    float time = texelFetch(basinTime,tex,0).r;
+    if ((cls & CLASS_DECIDED)!=0u) {
+        numDecided++;
+    }
+
+    vec3 color = initColor;
+    cls &= ~CLASS_DECIDED;
+    if (cls>0u) {
+        color = texelFetch(palette,int(cls)-1).rgb;
+    }
+    return color*clamp(1.0 - log(tScale*time),0.2,1);
+}
+
 void main() {
-    fragColor = vec4(texCoords,0,1);
-    fragColor = texture( tex, texCoords );
+    ivec2 size = textureSize(basinClass,0)/supersample;
+    ivec2 pix = clamp(ivec2(texCoords*vec2(size)),ivec2(0),size-ivec2(1));
+
+    vec3 color = vec3(0);
+    int numDecided = 0;
+    for(int j=0; j<supersample; j++) {
+        for(int i=0; i<supersample; i++) {
+            color += sampleColor(pix*supersample + ivec2(i,j),numDecided);
+        }
+    }
+    if (overlay!=0 && numDecided==0) {
+        discard;
+    }
+    fragColor = vec4(color/float(supersample*supersample),1);
 }
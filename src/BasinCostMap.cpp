@@ -0,0 +1,132 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file BasinCostMap.cpp
+*/
+
+#include "BasinCostMap.h"
+
+#define DEF_MAX(x,y)  ((x)>(y)?(x):(y))
+#define DEF_MIN(x,y)  ((x)<(y)?(x):(y))
+
+#define COST_SAMPLES  4   // samples per axis of a predicted rectangle
+
+
+BasinCostMap::BasinCostMap() :
+    m_xmin(0.0),
+    m_ymin(0.0),
+    m_xmax(0.0),
+    m_ymax(0.0),
+    m_mean(0.0),
+    m_stepsPerSecond(0.0)
+{
+}
+
+BasinCostMap::~BasinCostMap() {
+}
+
+void BasinCostMap::Clear() {
+    m_cells.clear();
+    m_mean = 0.0;
+    m_stepsPerSecond = 0.0;
+}
+
+bool BasinCostMap::IsEmpty() const {
+    return m_cells.empty();
+}
+
+void BasinCostMap::Record( double xmin, double ymin, double xmax, double ymax, int width, int height,
+                           const std::vector<int> &steps, double seconds ) {
+    const int N = BASIN_COST_CELLS;
+    std::vector<double> sum(N*N,0.0);
+    std::vector<int> count(N*N,0);
+    double total = 0.0;
+    long numKnown = 0;
+    for(int py=0; py<height; py++) {
+        int cy = DEF_MIN(py*N/height,N-1);
+        for(int px=0; px<width; px++) {
+            int s = steps[py*width + px];
+            if (s<0) {
+                continue;
+            }
+            int cx = DEF_MIN(px*N/width,N-1);
+            sum[cy*N + cx] += s;
+            count[cy*N + cx]++;
+            total += s;
+            numKnown++;
+        }
+    }
+    if (numKnown==0) {
+        return;
+    }
+
+    // cells without data are taken from the previous map, which is still in place
+    std::vector<double> cells(N*N);
+    double cw = (xmax - xmin)/N;
+    double ch = (ymax - ymin)/N;
+    for(int cy=0; cy<N; cy++) {
+        for(int cx=0; cx<N; cx++) {
+            int c = cy*N + cx;
+            if (count[c]>0) {
+                cells[c] = sum[c]/count[c];
+            } else if (!IsEmpty()) {
+                cells[c] = stepsAt(xmin + (cx+0.5)*cw,ymin + (cy+0.5)*ch);
+            } else {
+                cells[c] = total/numKnown;
+            }
+        }
+    }
+
+    m_cells.swap(cells);
+    m_xmin = xmin;
+    m_ymin = ymin;
+    m_xmax = xmax;
+    m_ymax = ymax;
+    m_mean = 0.0;
+    for(int c=0; c<N*N; c++) {
+        m_mean += m_cells[c];
+    }
+    m_mean /= N*N;
+    if (seconds>0.0) {
+        m_stepsPerSecond = total/seconds;
+    }
+}
+
+/**
+ *  Mean of COST_SAMPLES x COST_SAMPLES positions within the rectangle, so a
+ *  rectangle smaller than a cell and one over many cells are both covered.
+ */
+double BasinCostMap::Predict( double xmin, double ymin, double xmax, double ymax, int numPixels ) const {
+    if (IsEmpty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for(int j=0; j<COST_SAMPLES; j++) {
+        double y = ymin + (j+0.5)*(ymax - ymin)/COST_SAMPLES;
+        for(int i=0; i<COST_SAMPLES; i++) {
+            sum += stepsAt(xmin + (i+0.5)*(xmax - xmin)/COST_SAMPLES,y);
+        }
+    }
+    return sum/(COST_SAMPLES*COST_SAMPLES)*numPixels;
+}
+
+double BasinCostMap::StepsPerSecond() const {
+    return m_stepsPerSecond;
+}
+
+// *********************************** protected methods ******************************
+
+double BasinCostMap::stepsAt( double x, double y ) const {
+    const int N = BASIN_COST_CELLS;
+    if (x<m_xmin || x>=m_xmax || y<m_ymin || y>=m_ymax) {
+        return m_mean;
+    }
+    int cx = DEF_MIN(static_cast<int>((x - m_xmin)/(m_xmax - m_xmin)*N),N-1);
+    int cy = DEF_MIN(static_cast<int>((y - m_ymin)/(m_ymax - m_ymin)*N),N-1);
+    return m_cells[DEF_MAX(cy,0)*N + DEF_MAX(cx,0)];
+}
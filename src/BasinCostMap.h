@@ -0,0 +1,74 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the cost model of basin tiles.
+    @file BasinCostMap.h
+*/
+
+#ifndef MPSIM_BASIN_COST_MAP_H
+#define MPSIM_BASIN_COST_MAP_H
+
+#include <vector>
+
+#define BASIN_COST_CELLS  64   // cells per axis of the cost map
+
+/**
+ * @brief The BasinCostMap class
+ *
+ *  Integration steps per pixel of the last basin maps, averaged over a grid
+ *  of BASIN_COST_CELLS x BASIN_COST_CELLS cells of the region they covered.
+ *  A pixel near a magnet takes a few hundred steps, one on a basin boundary
+ *  tens of thousands; the map of the previous rendering, or of one with
+ *  slightly different parameters, predicts where the expensive tiles of the
+ *  next one are. The BasinRenderer schedules the tiles accordingly.
+ *
+ *  The map lives in positions, not pixels, so it also serves a panned or
+ *  zoomed view. Outside of the recorded region, the mean of all cells is
+ *  taken.
+ */
+class BasinCostMap
+{
+public:
+    BasinCostMap();
+    ~BasinCostMap();
+
+public:
+    void   Clear();
+    bool   IsEmpty() const;
+
+    /** Replace the map by the steps of a rendering. Cells without any
+     *  integrated pixel keep the prediction of the previous map.
+     * @param xmin,ymin,xmax,ymax  Region of the pixels, see BasinRenderer::SetRegion.
+     * @param width,height         Pixels of the rendering.
+     * @param steps                Steps per pixel, rows from the bottom; negative if unknown.
+     * @param seconds              Duration of the rendering; <= 0 if it was incomplete.
+     */
+    void   Record( double xmin, double ymin, double xmax, double ymax, int width, int height,
+                   const std::vector<int> &steps, double seconds );
+
+    /** Predicted steps of the pixels of a rectangle.
+     * @param numPixels  Pixels within the rectangle.
+     */
+    double Predict( double xmin, double ymin, double xmax, double ymax, int numPixels ) const;
+
+    /** Steps per second of the last complete rendering, 0 if unknown.
+     */
+    double StepsPerSecond() const;
+
+protected:
+    double stepsAt( double x, double y ) const;
+
+private:
+    double  m_xmin, m_ymin;
+    double  m_xmax, m_ymax;
+    std::vector<double>  m_cells;   //!< mean steps per pixel, row by row from the bottom
+    double  m_mean;
+    double  m_stepsPerSecond;
+};
+
+#endif // MPSIM_BASIN_COST_MAP_H
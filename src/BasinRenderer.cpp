@@ -0,0 +1,611 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file BasinRenderer.cpp
+*/
+
+#include "BasinRenderer.h"
+
+#include <cmath>
+#include <cstring>
+
+#define DEF_MAX(x,y)  ((x)>(y)?(x):(y))
+#define DEF_MIN(x,y)  ((x)<(y)?(x):(y))
+
+#define BASIN_UNKNOWN  -2   // pixel not yet integrated
+#define BASIN_QUEUED   -3   // pixel is part of the current batch
+
+
+BasinRenderer::BasinRenderer( const PendulumParams &params ) :
+    m_params(params),
+    m_width(0),
+    m_height(0),
+    m_numThreads(0),
+    m_tileSize(32),
+    m_xmin(-1.0),
+    m_ymin(-1.0),
+    m_xmax(1.0),
+    m_ymax(1.0),
+    m_maxTime(100.0),
+    m_maxSteps(100000),
+    m_eps(1e-8),
+    m_method(params.m_integrator),
+    m_mode(BASIN_FULL),
+    m_verifyDensity(0.0),
+    m_numIntegrated(0),
+    m_simdLevel(SIMD_AUTO),
+    m_laneFunc(NULL),
+    m_costMap(NULL),
+    m_costInSteps(false),
+    m_costTotal(0),
+    m_costDone(0)
+{
+    SetResolution(512,512);
+    m_table.Build(m_params);
+    m_table.BuildTree(m_params);
+    m_table.BuildFieldGrid(m_params);
+    m_equilibria.Solve(m_params);
+}
+
+BasinRenderer::~BasinRenderer() {
+}
+
+/**
+ *  The domain is the one of the unzoomed view of OpenGL2d.
+ */
+void BasinRenderer::SetResolution( int width, int height ) {
+    m_width  = (width>0 ? width : 1);
+    m_height = (height>0 ? height : 1);
+
+    double aspect = m_width/static_cast<double>(m_height);
+    m_xmax = m_params.RMax() * aspect;
+    m_ymax = m_params.RMax();
+    m_xmin = -m_xmax;
+    m_ymin = -m_ymax;
+}
+
+void BasinRenderer::SetRegion( double xmin, double ymin, double xmax, double ymax ) {
+    m_xmin = xmin;
+    m_ymin = ymin;
+    m_xmax = xmax;
+    m_ymax = ymax;
+}
+
+void BasinRenderer::SetNumThreads( int numThreads ) {
+    m_numThreads = numThreads;
+}
+
+void BasinRenderer::SetTileSize( int tileSize ) {
+    m_tileSize = (tileSize>0 ? tileSize : 1);
+}
+
+void BasinRenderer::SetMaxTime( double maxTime ) {
+    m_maxTime = maxTime;
+}
+
+void BasinRenderer::SetMaxSteps( int maxSteps ) {
+    m_maxSteps = maxSteps;
+}
+
+void BasinRenderer::SetTolerance( double eps ) {
+    m_eps = eps;
+}
+
+void BasinRenderer::SetMethod( rkMethod method ) {
+    m_method = method;
+}
+
+rkMethod BasinRenderer::GetMethod() const {
+    return m_method;
+}
+
+void BasinRenderer::SetSimdLevel( simdLevel level ) {
+    m_simdLevel = level;
+}
+
+/**
+ *  The lanes only implement the Cash-Karp tableau; the other methods are
+ *  integrated pixel by pixel.
+ */
+simdLevel BasinRenderer::GetSimdLevel() const {
+    if (m_simdLevel==SIMD_NONE || m_method!=RK_CASH_KARP) {
+        return SIMD_NONE;
+    }
+    return SimdStepper::Resolve(m_simdLevel);
+}
+
+void BasinRenderer::SetMode( basinMode mode ) {
+    m_mode = mode;
+}
+
+basinMode BasinRenderer::GetMode() const {
+    return m_mode;
+}
+
+void BasinRenderer::SetVerifyDensity( double density ) {
+    m_verifyDensity = DEF_MAX(0.0,density);
+}
+
+const MagnetTable& BasinRenderer::GetMagnetTable() const {
+    return m_table;
+}
+
+long BasinRenderer::NumIntegrated() const {
+    return m_numIntegrated;
+}
+
+void BasinRenderer::SetProgress( std::function<void(const basinTile&)> tileDone, std::function<bool()> abort ) {
+    m_tileDone = tileDone;
+    m_abort = abort;
+}
+
+void BasinRenderer::SetCostMap( BasinCostMap *costMap ) {
+    m_costMap = costMap;
+}
+
+void BasinRenderer::SetTileFilter( std::function<bool(const basinTile&)> filter ) {
+    m_tileFilter = filter;
+}
+
+bool BasinRenderer::Render() {
+    m_magnetIndex.assign(m_width*m_height,BASIN_UNKNOWN);
+    m_captureTime.assign(m_width*m_height,0.0f);
+    m_stepCount.assign(m_width*m_height,-1);
+    m_numIntegrated = 0;
+
+    m_laneFunc = NULL;
+    if (GetSimdLevel()!=SIMD_NONE) {
+        m_laneFunc = SimdStepper::Select(m_simdLevel);
+        setupLaneSystem();
+    }
+
+    TileScheduler scheduler;
+    scheduler.SetImage(m_width,m_height,m_tileSize);
+    predictCosts(scheduler);
+
+    int tilesX = (m_width + m_tileSize - 1)/m_tileSize;
+    m_costDone = 0;
+    m_startTime = std::chrono::steady_clock::now();
+    scheduler.Run(m_numThreads,[this,tilesX](const basinTile &tile) {
+        if (aborted() || (m_tileFilter && !m_tileFilter(tile))) {
+            return;
+        }
+        switch (m_mode) {
+            default:
+            case BASIN_FULL:
+                renderTile(tile);
+                break;
+            case BASIN_MARIANI_SILVER:
+                renderTileSubdivided(tile);
+                break;
+        }
+        m_costDone += m_tileCost[(tile.y0/m_tileSize)*tilesX + tile.x0/m_tileSize];
+        if (m_tileDone && !aborted()) {
+            m_tileDone(tile);
+        }
+    });
+
+    bool complete = !aborted();
+    if (m_costMap!=NULL) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+        m_costMap->Record(m_xmin,m_ymin,m_xmax,m_ymax,m_width,m_height,m_stepCount,(complete ? seconds : 0.0));
+    }
+    return complete;
+}
+
+/**
+ *  The finished part of the predicted cost is extrapolated. Before the first
+ *  tile is done, the speed of the last complete rendering is used.
+ */
+double BasinRenderer::TimeLeft() const {
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+    long long done = m_costDone;
+    if (done>0) {
+        return elapsed*(m_costTotal - done)/done;
+    }
+    if (m_costInSteps && m_costMap->StepsPerSecond()>0.0) {
+        return DEF_MAX(0.0,m_costTotal/m_costMap->StepsPerSecond() - elapsed);
+    }
+    return -1.0;
+}
+
+int BasinRenderer::IntegratePixel( double x0, double y0, float &time ) const {
+    int steps;
+    return integrateScalar(x0,y0,time,steps);
+}
+
+/**
+ *  Same coloring as in 'quad.frag'. Pixels that were not captured get the
+ *  initial color of OpenGL2d.
+ */
+bool BasinRenderer::WriteImage( const char* filename, double tScale ) const {
+    FILE* fptr = fopen(filename,"wb");
+    if (fptr==NULL) {
+        fprintf(stderr,"Cannot write image file %s\n",filename);
+        return false;
+    }
+
+    fprintf(fptr,"P6\n%d %d\n255\n",m_width,m_height);
+    std::vector<unsigned char> row(3*m_width);
+    for(int py=m_height-1; py>=0; py--) {
+        for(int px=0; px<m_width; px++) {
+            int num = py*m_width + px;
+            float col[3] = { 0.2f, 0.2f, 0.2f };
+            int idx = m_magnetIndex[num];
+            if (idx>=0 && idx<static_cast<int>(m_params.m_magnets.size())) {
+                memcpy(col,m_params.m_magnets[idx].color,sizeof(float)*3);
+            }
+
+            double f = 1.0 - log(tScale*m_captureTime[num]);
+            f = DEF_MAX(0.2,DEF_MIN(f,1.0));
+            for(int c=0; c<3; c++) {
+                double val = col[c]*f*255.0 + 0.5;
+                row[3*px+c] = static_cast<unsigned char>(DEF_MAX(0.0,DEF_MIN(val,255.0)));
+            }
+        }
+        fwrite(&row[0],sizeof(unsigned char),row.size(),fptr);
+    }
+    fclose(fptr);
+    return true;
+}
+
+bool BasinRenderer::WriteRaw( const char* filename ) const {
+    FILE* fptr = fopen(filename,"wb");
+    if (fptr==NULL) {
+        fprintf(stderr,"Cannot write raw file %s\n",filename);
+        return false;
+    }
+
+    int size[2] = { m_width, m_height };
+    fwrite("MPBASIN1",sizeof(char),8,fptr);
+    fwrite(size,sizeof(int),2,fptr);
+    fwrite(&m_magnetIndex[0],sizeof(int),m_magnetIndex.size(),fptr);
+    fwrite(&m_captureTime[0],sizeof(float),m_captureTime.size(),fptr);
+    fclose(fptr);
+    return true;
+}
+
+int BasinRenderer::Width() const {
+    return m_width;
+}
+
+int BasinRenderer::Height() const {
+    return m_height;
+}
+
+/**
+ *  Pixel center; py=0 is the bottom row.
+ */
+void BasinRenderer::PixelToPos( int px, int py, double &x, double &y ) const {
+    double xstep = (m_xmax - m_xmin)/m_width;
+    double ystep = (m_ymax - m_ymin)/m_height;
+    x = m_xmin + (px+0.5)*xstep;
+    y = m_ymin + (py+0.5)*ystep;
+}
+
+const std::vector<int>& BasinRenderer::MagnetIndex() const {
+    return m_magnetIndex;
+}
+
+const std::vector<float>& BasinRenderer::CaptureTime() const {
+    return m_captureTime;
+}
+
+const std::vector<int>& BasinRenderer::StepCount() const {
+    return m_stepCount;
+}
+
+// *********************************** protected methods ******************************
+
+/**
+ *  Every tile costs its number of pixels, or the steps that the cost map
+ *  predicts for them. Tiles that the filter rejects cost nothing. Only a
+ *  prediction from a map changes the order of the tiles.
+ */
+void BasinRenderer::predictCosts( TileScheduler &scheduler ) {
+    m_costInSteps = (m_costMap!=NULL && !m_costMap->IsEmpty());
+
+    double xstep = (m_xmax - m_xmin)/m_width;
+    double ystep = (m_ymax - m_ymin)/m_height;
+    int num = scheduler.NumTiles();
+    std::vector<double> costs(num,0.0);
+    m_tileCost.assign(num,0);
+    m_costTotal = 0;
+    for(int t=0; t<num; t++) {
+        const basinTile &tile = scheduler.Tile(t);
+        if (m_tileFilter && !m_tileFilter(tile)) {
+            continue;
+        }
+        int numPixels = (tile.x1 - tile.x0)*(tile.y1 - tile.y0);
+        costs[t] = numPixels;
+        if (m_costInSteps) {
+            costs[t] = m_costMap->Predict(m_xmin + tile.x0*xstep,m_ymin + tile.y0*ystep,
+                                          m_xmin + tile.x1*xstep,m_ymin + tile.y1*ystep,numPixels);
+        }
+        m_tileCost[t] = static_cast<long long>(costs[t] + 0.5);
+        m_costTotal += m_tileCost[t];
+    }
+    if (m_costInSteps) {
+        scheduler.SetCosts(costs);
+    }
+}
+
+void BasinRenderer::renderTile( const basinTile &tile ) {
+    std::vector<int> pixels;
+    pixels.reserve((tile.x1 - tile.x0)*(tile.y1 - tile.y0));
+    for(int py=tile.y0; py<tile.y1; py++) {
+        for(int px=tile.x0; px<tile.x1; px++) {
+            pixels.push_back(py*m_width + px);
+        }
+    }
+    integratePixels(pixels);
+}
+
+/**
+ *  Mariani-Silver subdivision of a tile. Rectangles include their border; the
+ *  two halves of a rectangle share its middle line.
+ */
+void BasinRenderer::renderTileSubdivided( const basinTile &tile ) {
+    std::vector<basinTile> rects(1,tile), next;
+    std::vector<int> pixels, check;
+
+    while (!rects.empty()) {
+        pixels.clear();
+        for(unsigned int r=0; r<rects.size(); r++) {
+            appendBorder(rects[r],pixels);
+        }
+        integratePixels(pixels);
+
+        if (m_verifyDensity>0.0) {
+            pixels.clear();
+            for(unsigned int r=0; r<rects.size(); r++) {
+                check.clear();
+                appendBorder(rects[r],check);
+                if (isUniform(check,m_magnetIndex[check[0]])) {
+                    appendSamples(rects[r],pixels);
+                }
+            }
+            integratePixels(pixels);
+        }
+
+        next.clear();
+        for(unsigned int r=0; r<rects.size(); r++) {
+            const basinTile &rect = rects[r];
+            int w = rect.x1 - rect.x0;
+            int h = rect.y1 - rect.y0;
+            if (w<3 || h<3) {
+                continue;
+            }
+
+            check.clear();
+            appendBorder(rect,check);
+            appendSamples(rect,check);
+            int index = m_magnetIndex[check[0]];
+            if (isUniform(check,index)) {
+                fillRect(rect,index);
+            }
+            else if (w>=h) {
+                int xm = rect.x0 + w/2;
+                basinTile left  = { rect.x0, rect.y0, xm+1, rect.y1 };
+                basinTile right = { xm, rect.y0, rect.x1, rect.y1 };
+                next.push_back(left);
+                next.push_back(right);
+            }
+            else {
+                int ym = rect.y0 + h/2;
+                basinTile bottom = { rect.x0, rect.y0, rect.x1, ym+1 };
+                basinTile top    = { rect.x0, ym, rect.x1, rect.y1 };
+                next.push_back(bottom);
+                next.push_back(top);
+            }
+        }
+        rects.swap(next);
+    }
+}
+
+void BasinRenderer::appendBorder( const basinTile &rect, std::vector<int> &pixels ) const {
+    int w = rect.x1 - rect.x0;
+    int h = rect.y1 - rect.y0;
+    for(int px=rect.x0; px<rect.x1; px++) {
+        pixels.push_back(rect.y0*m_width + px);
+        if (h>1) {
+            pixels.push_back((rect.y1-1)*m_width + px);
+        }
+    }
+    for(int py=rect.y0+1; py<rect.y1-1; py++) {
+        pixels.push_back(py*m_width + rect.x0);
+        if (w>1) {
+            pixels.push_back(py*m_width + rect.x1-1);
+        }
+    }
+}
+
+/**
+ *  Verification samples in the interior: R2 low-discrepancy sequence (Roberts),
+ *  so the same rectangle always gets the same samples.
+ */
+void BasinRenderer::appendSamples( const basinTile &rect, std::vector<int> &pixels ) const {
+    int iw = rect.x1 - rect.x0 - 2;
+    int ih = rect.y1 - rect.y0 - 2;
+    if (m_verifyDensity<=0.0 || iw<1 || ih<1) {
+        return;
+    }
+    int numSamples = static_cast<int>(ceil(m_verifyDensity*iw*ih));
+    for(int i=0; i<numSamples; i++) {
+        double u = fmod(0.5 + 0.7548776662466927*(i+1),1.0);
+        double v = fmod(0.5 + 0.5698402909980532*(i+1),1.0);
+        int px = rect.x0 + 1 + DEF_MIN(static_cast<int>(u*iw),iw-1);
+        int py = rect.y0 + 1 + DEF_MIN(static_cast<int>(v*ih),ih-1);
+        pixels.push_back(py*m_width + px);
+    }
+}
+
+bool BasinRenderer::isUniform( const std::vector<int> &pixels, int index ) const {
+    for(unsigned int i=0; i<pixels.size(); i++) {
+        if (m_magnetIndex[pixels[i]]!=index) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ *  Set the interior pixels that were not integrated to 'index'. Their capture
+ *  time is the mean of the linear interpolations between opposite borders.
+ */
+void BasinRenderer::fillRect( const basinTile &rect, int index ) {
+    int x0 = rect.x0, x1 = rect.x1 - 1;
+    int y0 = rect.y0, y1 = rect.y1 - 1;
+    for(int py=y0+1; py<y1; py++) {
+        double v = (py-y0)/static_cast<double>(y1-y0);
+        double tl = m_captureTime[py*m_width + x0];
+        double tr = m_captureTime[py*m_width + x1];
+        for(int px=x0+1; px<x1; px++) {
+            int num = py*m_width + px;
+            if (m_magnetIndex[num]!=BASIN_UNKNOWN) {
+                continue;
+            }
+            double u = (px-x0)/static_cast<double>(x1-x0);
+            double tb = m_captureTime[y0*m_width + px];
+            double tt = m_captureTime[y1*m_width + px];
+            m_magnetIndex[num] = index;
+            m_captureTime[num] = static_cast<float>(0.5*((1.0-u)*tl + u*tr + (1.0-v)*tb + v*tt));
+            m_stepCount[num] = 0;
+        }
+    }
+}
+
+/**
+ *  Integrate those of the given pixels that are not known yet; duplicates are
+ *  integrated once. With lanes, all of them form one batch so that lanes whose
+ *  pixel is captured can be refilled.
+ */
+void BasinRenderer::integratePixels( const std::vector<int> &pixels ) {
+    if (aborted()) {
+        return;
+    }
+    std::vector<int> todo;
+    todo.reserve(pixels.size());
+    for(unsigned int i=0; i<pixels.size(); i++) {
+        if (m_magnetIndex[pixels[i]]==BASIN_UNKNOWN) {
+            m_magnetIndex[pixels[i]] = BASIN_QUEUED;
+            todo.push_back(pixels[i]);
+        }
+    }
+    int num = static_cast<int>(todo.size());
+    if (num==0) {
+        return;
+    }
+    m_numIntegrated += num;
+
+    if (m_laneFunc==NULL) {
+        double x,y;
+        for(int i=0; i<num; i++) {
+            PixelToPos(todo[i]%m_width,todo[i]/m_width,x,y);
+            m_magnetIndex[todo[i]] = integrateScalar(x,y,m_captureTime[todo[i]],m_stepCount[todo[i]]);
+        }
+        return;
+    }
+
+    std::vector<double> x0(num), y0(num);
+    std::vector<int>    index(num), steps(num);
+    std::vector<float>  time(num);
+    for(int i=0; i<num; i++) {
+        PixelToPos(todo[i]%m_width,todo[i]/m_width,x0[i],y0[i]);
+    }
+
+    lanePixels pix = { num, &x0[0], &y0[0], &index[0], &time[0], &steps[0] };
+    m_laneFunc(m_laneSystem,pix);
+
+    for(int i=0; i<num; i++) {
+        m_magnetIndex[todo[i]] = index[i];
+        m_captureTime[todo[i]] = time[i];
+        m_stepCount[todo[i]] = steps[i];
+    }
+}
+
+void BasinRenderer::setupLaneSystem() {
+    m_laneSystem.g_l = m_table.G_L();
+    m_laneSystem.gamma = m_table.Gamma();
+    m_laneSystem.kappa = m_table.Kappa();
+    m_laneSystem.law = m_table.Law();
+    m_laneSystem.numMagnets = m_table.Size();
+    m_laneSystem.mx = m_table.X();
+    m_laneSystem.my = m_table.Y();
+    m_laneSystem.mrz2 = m_table.RZ2();
+    m_laneSystem.mam = m_table.AM();
+    m_laneSystem.mkam = m_table.KAM();
+    m_laneSystem.field = (m_table.IsExact() ? NULL : &m_table);
+    m_laneSystem.eps = m_eps;
+    m_laneSystem.hInit = 0.001;
+    m_laneSystem.maxTime = m_maxTime;
+    m_laneSystem.maxSteps = m_maxSteps;
+    m_laneSystem.trapEnergy = m_equilibria.TrapEnergy();
+    m_laneSystem.equilibria = &m_equilibria;
+}
+
+int BasinRenderer::integrateScalar( double x0, double y0, float &time, int &steps ) const {
+    switch (m_method) {
+        default:
+        case RK_CASH_KARP:
+            return integratePixel<CashKarp>(x0,y0,time,steps);
+        case RK_DOPRI5:
+            return integratePixel<DormandPrince5>(x0,y0,time,steps);
+        case RK_BS23:
+            return integratePixel<BogackiShampine3>(x0,y0,time,steps);
+    }
+}
+
+int BasinRenderer::capturedBy( const double *y ) const {
+    return m_equilibria.CapturedBy(y);
+}
+
+bool BasinRenderer::aborted() const {
+    return (m_abort && m_abort());
+}
+
+/**
+ *  Cartesian model of SystemData::calcRHS.
+ */
+void BasinRenderer::calcRHS( const double *y, double *dydx ) const {
+    m_table.CalcRHS(y,dydx);
+}
+
+template <class Tableau>
+int BasinRenderer::integratePixel( double x0, double y0, float &time, int &steps ) const {
+    double y[4];
+    y[0] = x0;
+    y[1] = y0;
+    y[2] = 0.0;
+    y[3] = 0.0;
+
+    double t = 0.0;
+    double h = 0.001;
+    double hdid, hnext;
+
+    Stepper<Tableau,4> stepper(m_eps,1e-12);
+    stepper.Init(*this,y);
+    steps = 0;
+    while (steps<m_maxSteps && t<m_maxTime) {
+        stepper.Step(*this,y,h,hdid,hnext);
+        t += hdid;
+        steps++;
+
+        int idx = capturedBy(y);
+        if (idx>=0) {
+            time = static_cast<float>(t);
+            return idx;
+        }
+        if (fabs(hnext)<1e-12) {
+            break;
+        }
+        h = hnext;
+    }
+    time = static_cast<float>(t);
+    return -1;
+}
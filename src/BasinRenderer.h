@@ -0,0 +1,228 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the CPU basin-of-attraction renderer.
+    @file BasinRenderer.h
+*/
+
+#ifndef MPSIM_BASIN_RENDERER_H
+#define MPSIM_BASIN_RENDERER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "BasinCostMap.h"
+#include "Equilibria.h"
+#include "MagnetTable.h"
+#include "PendulumParams.h"
+#include "RKStepper.h"
+#include "SimdStepper.h"
+#include "TileScheduler.h"
+
+enum basinMode {
+    BASIN_FULL = 0,          //!< integrate every pixel
+    BASIN_MARIANI_SILVER     //!< integrate rectangle borders, fill uniform interiors
+};
+
+/**
+ * @brief The BasinRenderer class
+ *
+ *  CPU counterpart of the compute shader 'pendulum.comp'. Every pixel of a
+ *  width x height grid is an initial position of the bob (at rest). The bob is
+ *  integrated until it is trapped near a magnet (see Equilibria) or until the
+ *  maximum time is reached. By default the grid covers [-rmax*aspect,rmax*aspect] x [-rmax,rmax],
+ *  the unzoomed view of OpenGL2d; SetRegion() chooses any other rectangle.
+ *
+ *  The pixels are distributed as tiles over all cores by the TileScheduler.
+ *  Within a tile, the pixels are integrated lane-parallel by the SimdStepper
+ *  unless the vector units are switched off. The accepted steps of every pixel
+ *  are counted; with a BasinCostMap of an earlier rendering, the expensive
+ *  tiles are scheduled first and TimeLeft() estimates the remaining time.
+ *
+ *  In Mariani-Silver mode only the border of a tile is integrated. If the whole
+ *  border ends at the same magnet, the interior is filled; otherwise the tile
+ *  is split in two along its longer side and both halves are treated the same
+ *  way. Islands that do not touch the border are missed; optional verification
+ *  samples inside the rectangle guard against that. The rectangles of a tile
+ *  are processed level by level, so that the borders of one level form a
+ *  single batch for the lanes.
+ */
+class BasinRenderer
+{
+public:
+    BasinRenderer( const PendulumParams &params );
+    ~BasinRenderer();
+
+public:
+    /** Set the number of pixels; the region is reset to the default domain.
+     */
+    void   SetResolution( int width, int height );
+
+    /** Set the rectangle covered by the pixels (outer edges, not pixel centers).
+     */
+    void   SetRegion( double xmin, double ymin, double xmax, double ymax );
+
+    void   SetNumThreads( int numThreads );     //!< 0 uses all cores.
+    void   SetTileSize( int tileSize );
+    void   SetMaxTime( double maxTime );
+    void   SetMaxSteps( int maxSteps );
+    void   SetTolerance( double eps );
+
+    /** Set integration method; the default is taken from the parameter file.
+     */
+    void   SetMethod( rkMethod method );
+    rkMethod   GetMethod() const;
+
+    /** Set instruction set for lane-parallel integration.
+     *    SIMD_NONE uses the scalar stepper pixel by pixel.
+     */
+    void   SetSimdLevel( simdLevel level );
+    simdLevel  GetSimdLevel() const;
+
+    void   SetMode( basinMode mode );
+    basinMode  GetMode() const;
+
+    /** Verification samples per interior pixel in Mariani-Silver mode.
+     *    A rectangle is only filled if all samples agree with its border.
+     */
+    void   SetVerifyDensity( double density );
+
+    /** Magnets of the parameter set, including the field grid if any.
+     */
+    const MagnetTable& GetMagnetTable() const;
+
+    /** Number of pixels actually integrated by the last Render().
+     */
+    long   NumIntegrated() const;
+
+    /** Functions for progressive rendering; both are called by the worker threads.
+     * @param tileDone  Called with every finished tile.
+     * @param abort     Polled before every tile and batch of pixels; the
+     *                  rendering stops as soon as it returns true.
+     */
+    void   SetProgress( std::function<void(const basinTile&)> tileDone, std::function<bool()> abort );
+
+    /** Cost map that predicts the tiles of Render() and that is updated with
+     *  its step counts afterwards; NULL schedules by the number of pixels.
+     *  The map is not owned by the renderer.
+     */
+    void   SetCostMap( BasinCostMap *costMap );
+
+    /** Only tiles for which the filter returns true are rendered; the pixels
+     *  of the others keep the index -2. Without filter, all tiles are rendered.
+     */
+    void   SetTileFilter( std::function<bool(const basinTile&)> filter );
+
+    /** Integrate all pixels.
+     * @return false if the rendering was aborted.
+     */
+    bool   Render();
+
+    /** Estimated seconds until the running Render() is finished, from the
+     *  predicted cost of the finished tiles; may be called by the tileDone
+     *  function. Negative if there is no estimate yet.
+     */
+    double TimeLeft() const;
+
+    /** Integrate a single initial position.
+     * @param x0    Initial x-position.
+     * @param y0    Initial y-position.
+     * @param time  Reference to capture time.
+     * @return magnet index or -1 if the bob was not captured.
+     */
+    int    IntegratePixel( double x0, double y0, float &time ) const;
+
+    /** Write colored image as binary PPM.
+     * @param filename  Name of image file.
+     * @param tScale    Time scaling of color (see quad.frag); 0 disables it.
+     */
+    bool   WriteImage( const char* filename, double tScale ) const;
+
+    /** Write raw magnet indices and capture times.
+     *    Format: "MPBASIN1", int32 width, int32 height, int32 index[width*height],
+     *    float32 time[width*height]; rows start at the bottom.
+     */
+    bool   WriteRaw( const char* filename ) const;
+
+    int    Width() const;
+    int    Height() const;
+    void   PixelToPos( int px, int py, double &x, double &y ) const;
+
+    const std::vector<int>&    MagnetIndex() const;
+    const std::vector<float>&  CaptureTime() const;
+
+    /** Accepted integration steps per pixel of the last Render(): 0 for pixels
+     *  that were filled, -1 for those that were not rendered.
+     */
+    const std::vector<int>&    StepCount() const;
+
+    /** Cartesian equations of motion; called by the Stepper.
+     */
+    void   calcRHS( const double *y, double *dydx ) const;
+
+protected:
+    void   predictCosts( TileScheduler &scheduler );
+    void   renderTile( const basinTile &tile );
+    void   renderTileSubdivided( const basinTile &tile );
+    void   appendBorder( const basinTile &rect, std::vector<int> &pixels ) const;
+    void   appendSamples( const basinTile &rect, std::vector<int> &pixels ) const;
+    bool   isUniform( const std::vector<int> &pixels, int index ) const;
+    void   fillRect( const basinTile &rect, int index );
+    void   integratePixels( const std::vector<int> &pixels );
+    void   setupLaneSystem();
+    int    integrateScalar( double x0, double y0, float &time, int &steps ) const;
+    int    capturedBy( const double *y ) const;
+    bool   aborted() const;
+
+    template <class Tableau>
+    int    integratePixel( double x0, double y0, float &time, int &steps ) const;
+
+private:
+    PendulumParams  m_params;
+
+    int     m_width;
+    int     m_height;
+    int     m_numThreads;
+    int     m_tileSize;
+    double  m_xmin, m_ymin;
+    double  m_xmax, m_ymax;
+
+    double  m_maxTime;
+    int     m_maxSteps;
+    double  m_eps;
+    MagnetTable m_table;
+    Equilibria  m_equilibria;
+    rkMethod  m_method;
+
+    basinMode  m_mode;
+    double     m_verifyDensity;
+    std::atomic<long>   m_numIntegrated;
+
+    simdLevel           m_simdLevel;
+    laneIntegrateFunc   m_laneFunc;
+    laneSystem          m_laneSystem;
+
+    std::function<void(const basinTile&)>  m_tileDone;
+    std::function<bool()>  m_abort;
+    std::function<bool(const basinTile&)>  m_tileFilter;
+
+    BasinCostMap*  m_costMap;
+    bool           m_costInSteps;         //!< tile costs are predicted steps, not pixels
+    std::vector<long long>  m_tileCost;
+    long long      m_costTotal;
+    std::atomic<long long>  m_costDone;   //!< cost of the finished tiles
+    std::chrono::steady_clock::time_point  m_startTime;
+
+    std::vector<int>    m_magnetIndex;
+    std::vector<float>  m_captureTime;
+    std::vector<int>    m_stepCount;
+};
+
+#endif // MPSIM_BASIN_RENDERER_H
@@ -0,0 +1,217 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file BasinService.cpp
+*/
+
+#include "BasinService.h"
+
+#define DEF_MAX(x,y)  ((x)>(y)?(x):(y))
+#define DEF_MIN(x,y)  ((x)<(y)?(x):(y))
+
+
+BasinService::BasinService() :
+    m_quit(false),
+    m_pending(false),
+    m_mode(BASIN_FULL),
+    m_eps(1e-8),
+    m_newest(0),
+    m_numLeft(0),
+    m_finish(0)
+{
+    m_request.grid.width = m_request.grid.height = 0;
+    m_request.grid.tileSize = 1;
+    m_request.maxTime = 0.0;
+    m_request.mode = m_mode;
+    m_request.eps = m_eps;
+    m_request.number = 0;
+}
+
+BasinService::~BasinService() {
+    Stop();
+}
+
+void BasinService::Start() {
+    if (m_thread.joinable()) {
+        return;
+    }
+    m_quit = false;
+    m_thread = std::thread(&BasinService::workerLoop,this);
+}
+
+void BasinService::Stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_mutex.lock();
+    m_quit = true;
+    m_pending = false;
+    m_newest++;
+    m_mutex.unlock();
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+unsigned int BasinService::Request( const PendulumParams &params, const basinGrid &grid, double maxTime ) {
+    long numLeft = 0;
+    int tileSize = DEF_MAX(grid.tileSize,1);
+    int numTilesX = (grid.width + tileSize - 1)/tileSize;
+    for(int y=0; y<grid.height; y+=tileSize) {
+        for(int x=0; x<grid.width; x+=tileSize) {
+            unsigned int t = (y/tileSize)*numTilesX + x/tileSize;
+            if (t>=grid.skip.size() || !grid.skip[t]) {
+                numLeft += static_cast<long>(DEF_MIN(tileSize,grid.width-x))*DEF_MIN(tileSize,grid.height-y);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_request.params = params;
+    m_request.grid = grid;
+    m_request.grid.tileSize = tileSize;
+    m_request.maxTime = maxTime;
+    m_request.mode = m_mode;
+    m_request.eps = m_eps;
+    m_request.number = ++m_newest;
+    m_pending = true;
+    m_done.clear();
+    m_numLeft = numLeft;
+    m_finish = 0;
+    m_wake.notify_all();
+    return m_request.number;
+}
+
+void BasinService::Cancel() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending = false;
+    m_newest++;
+    m_done.clear();
+    m_numLeft = 0;
+    m_finish = 0;
+}
+
+void BasinService::SetMode( basinMode mode ) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_mode = mode;
+}
+
+void BasinService::SetTolerance( double eps ) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_eps = eps;
+}
+
+void BasinService::SetNotify( std::function<void()> func ) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_notify = func;
+}
+
+bool BasinService::Fetch( std::vector<basinTileData> &tiles ) {
+    tiles.clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    tiles.swap(m_done);
+    return !tiles.empty();
+}
+
+long BasinService::NumPixelsLeft() const {
+    return m_numLeft;
+}
+
+double BasinService::TimeLeft() const {
+    long long finish = m_finish;
+    if (finish==0 || m_numLeft<=0) {
+        return -1.0;
+    }
+    std::chrono::steady_clock::duration left(finish - std::chrono::steady_clock::now().time_since_epoch().count());
+    return DEF_MAX(0.0,std::chrono::duration<double>(left).count());
+}
+
+// *********************************** protected methods ******************************
+
+void BasinService::workerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_quit) {
+        if (!m_pending) {
+            m_wake.wait(lock);
+            continue;
+        }
+        request req = m_request;
+        m_pending = false;
+        lock.unlock();
+
+        // the renderer builds its own magnet table and equilibria
+        const basinGrid &grid = req.grid;
+        int numTilesX = (grid.width + grid.tileSize - 1)/grid.tileSize;
+        BasinRenderer renderer(req.params);
+        renderer.SetResolution(grid.width,grid.height);
+        renderer.SetRegion(grid.xmin,grid.ymin,grid.xmax,grid.ymax);
+        renderer.SetTileSize(grid.tileSize);
+        renderer.SetMaxTime(req.maxTime);
+        renderer.SetMode(req.mode);
+        renderer.SetTolerance(req.eps);
+        renderer.SetCostMap(&m_costMap);
+        renderer.SetTileFilter([&grid,numTilesX](const basinTile &tile) {
+                                   unsigned int t = (tile.y0/grid.tileSize)*numTilesX + tile.x0/grid.tileSize;
+                                   return (t>=grid.skip.size() || !grid.skip[t]);
+                               });
+        renderer.SetProgress([this,&renderer,&req](const basinTile &tile) {
+                                 tileDone(renderer,tile,req.number);
+                             },
+                             [this,&req]() {
+                                 return isStale(req.number);
+                             });
+        if (!isStale(req.number)) {
+            renderer.Render();
+        }
+        lock.lock();
+    }
+}
+
+/**
+ *  Called by the worker threads of the renderer. The tile is copied outside
+ *  of the lock; only tiles of the newest request are kept. The estimate of
+ *  the renderer is turned into a point in time, so TimeLeft() counts down
+ *  between tiles.
+ */
+void BasinService::tileDone( const BasinRenderer &renderer, const basinTile &tile, unsigned int number ) {
+    basinTileData data;
+    data.tile = tile;
+    data.request = number;
+
+    int w = tile.x1 - tile.x0;
+    int h = tile.y1 - tile.y0;
+    data.cls.resize(w*h);
+    data.time.resize(w*h);
+    const std::vector<int> &index = renderer.MagnetIndex();
+    const std::vector<float> &time = renderer.CaptureTime();
+    for(int py=0; py<h; py++) {
+        int num = (tile.y0 + py)*renderer.Width() + tile.x0;
+        for(int px=0; px<w; px++, num++) {
+            data.cls[py*w+px] = static_cast<unsigned short>((index[num]>=0 ? DEF_MIN(index[num]+1,BASIN_CLASS_DECIDED-1) : 0) | BASIN_CLASS_DECIDED);
+            data.time[py*w+px] = time[num];
+        }
+    }
+
+    double left = renderer.TimeLeft();
+    std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now()
+            + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(DEF_MAX(left,0.0)));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (isStale(number)) {
+        return;
+    }
+    m_done.push_back(data);
+    m_numLeft -= w*h;
+    m_finish = (left<0.0 ? 0 : finish.time_since_epoch().count());
+    if (m_done.size()==1 && m_notify) {
+        m_notify();
+    }
+}
+
+bool BasinService::isStale( unsigned int number ) const {
+    return (m_newest.load(std::memory_order_relaxed)!=number);
+}
@@ -0,0 +1,149 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the background basin service.
+    @file BasinService.h
+*/
+
+#ifndef MPSIM_BASIN_SERVICE_H
+#define MPSIM_BASIN_SERVICE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BasinCostMap.h"
+#include "BasinRenderer.h"
+#include "PendulumParams.h"
+
+#define BASIN_CLASS_DECIDED  0x8000   //!< bit of the class of a finished sample, see quad.frag
+
+/**
+ *  Finished tile of a basin map; rows start at the bottom.
+ */
+typedef struct basinTileData_t {
+    basinTile     tile;
+    unsigned int  request;                 //!< number of the request it belongs to
+    std::vector<unsigned short>  cls;      //!< 0 if not captured, magnet index + 1 otherwise; BASIN_CLASS_DECIDED set
+    std::vector<float>           time;     //!< capture time
+} basinTileData;
+
+/**
+ *  Pixels of a requested basin map and the tiles that are known already.
+ */
+typedef struct basinGrid_t {
+    int     width, height;
+    double  xmin, ymin, xmax, ymax;   //!< region, see BasinRenderer::SetRegion
+    int     tileSize;                 //!< edge length of a tile in pixels
+    std::vector<char>  skip;          //!< per tile, row by row from the bottom: not rendered if set
+} basinGrid;
+
+
+/**
+ * @brief The BasinService class
+ *
+ *  Renders basin maps with the BasinRenderer on a background thread; this is
+ *  what the 2D view shows when there are no compute shaders. As with the
+ *  TrajectoryService, only the newest request counts: a new request or
+ *  Cancel() makes the running rendering stop before its next tile or batch
+ *  of pixels, so tiles that are in flight are given up.
+ *
+ *  Every finished tile is copied into a basinTileData, which Fetch() hands
+ *  over. The consumer can thus show the map tile by tile while the
+ *  rendering goes on; the renderer itself stays with the worker. Tiles that
+ *  the consumer knows already, e.g. from its BasinTileCache, are skipped.
+ *
+ *  The worker keeps a BasinCostMap of its previous renderings. The tiles of
+ *  a request are thus scheduled by their expected cost, and the progress is
+ *  an estimate of the remaining time instead of a pixel count.
+ */
+class BasinService
+{
+public:
+    BasinService();
+    ~BasinService();
+
+public:
+    void   Start();
+    void   Stop();   //!< Cancel all requests and join the worker.
+
+    /** Request a basin map. Replaces a pending request and aborts the running one.
+     * @param params   Pendulum parameters.
+     * @param grid     Pixels and tiles of the map.
+     * @param maxTime  Maximum integration time of a pixel.
+     * @return number of the request.
+     */
+    unsigned int  Request( const PendulumParams &params, const basinGrid &grid, double maxTime );
+
+    /** Drop the pending request and abort the running one.
+     */
+    void   Cancel();
+
+    /** Mode and tolerance of the renderer for the following requests, see
+     *  BasinRenderer::SetMode() and BasinRenderer::SetTolerance().
+     */
+    void   SetMode( basinMode mode );
+    void   SetTolerance( double eps );
+
+    /** Function that is called by a worker thread when tiles are waiting
+     *  and the previous ones were fetched. It must not block.
+     */
+    void   SetNotify( std::function<void()> func );
+
+    /** Take the tiles of the newest request that finished since the last call.
+     * @return true if there were any.
+     */
+    bool   Fetch( std::vector<basinTileData> &tiles );
+
+    /** Pixels of the newest request that are neither skipped nor finished yet.
+     */
+    long   NumPixelsLeft() const;
+
+    /** Estimated seconds until the newest request is finished; negative if
+     *  there is no estimate or no request is running.
+     */
+    double TimeLeft() const;
+
+protected:
+    struct request {
+        PendulumParams  params;
+        basinGrid       grid;
+        double  maxTime;
+        basinMode  mode;
+        double  eps;
+        unsigned int  number;
+    };
+
+    void   workerLoop();
+    void   tileDone( const BasinRenderer &renderer, const basinTile &tile, unsigned int number );
+    bool   isStale( unsigned int number ) const;
+
+private:
+    std::thread  m_thread;
+    std::mutex   m_mutex;
+    std::condition_variable  m_wake;
+    bool     m_quit;
+    bool     m_pending;
+    request  m_request;                     //!< pending request, guarded by m_mutex
+    basinMode  m_mode;
+    double     m_eps;
+    std::atomic<unsigned int>  m_newest;    //!< number of the newest request
+    std::function<void()>      m_notify;
+
+    std::vector<basinTileData>  m_done;     //!< finished tiles, guarded by m_mutex
+    std::atomic<long>  m_numLeft;
+    std::atomic<long long>  m_finish;       //!< expected end of the newest request in steady_clock ticks, 0 if unknown
+
+    BasinCostMap  m_costMap;                //!< used by the worker only
+};
+
+#endif // MPSIM_BASIN_SERVICE_H
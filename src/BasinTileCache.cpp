@@ -0,0 +1,166 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file BasinTileCache.cpp
+*/
+
+#include "BasinTileCache.h"
+
+#include <cstring>
+
+
+BasinTileCache::BasinTileCache() :
+    m_capacity(64*1024*1024),
+    m_numBytes(0)
+{
+}
+
+BasinTileCache::~BasinTileCache() {
+}
+
+void BasinTileCache::SetCapacity( size_t numBytes ) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capacity = numBytes;
+    evict();
+}
+
+size_t BasinTileCache::NumBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_numBytes;
+}
+
+int BasinTileCache::NumTiles() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<int>(m_index.size());
+}
+
+void BasinTileCache::Clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_index.clear();
+    m_numBytes = 0;
+}
+
+void BasinTileCache::Insert( const basinTileKey &key, int tileSize, const unsigned short *cls, const float *time, int stride ) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    insert(key,tileSize,cls,time,stride);
+    evict();
+}
+
+bool BasinTileCache::Find( const basinTileKey &key, int tileSize, unsigned short *cls, float *time, int stride ) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool found = gather(key,tileSize,cls,time,stride,BASIN_CACHE_DEPTH);
+    evict();
+    return found;
+}
+
+/**
+ *  FNV-1a, continued from the hash of the parameters.
+ */
+unsigned long long BasinTileCache::LatticeHash( const PendulumParams &params, double maxTime, double spacing, int tileSize ) {
+    double values[3] = { maxTime, spacing, static_cast<double>(tileSize) };
+    unsigned long long hash = params.Hash();
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values);
+    for(size_t i=0; i<sizeof(values); i++) {
+        hash = (hash ^ bytes[i])*1099511628211ULL;
+    }
+    return hash;
+}
+
+bool BasinTileCache::keyLess::operator()( const basinTileKey &a, const basinTileKey &b ) const {
+    if (a.lattice!=b.lattice) {
+        return (a.lattice<b.lattice);
+    }
+    if (a.level!=b.level) {
+        return (a.level<b.level);
+    }
+    if (a.ty!=b.ty) {
+        return (a.ty<b.ty);
+    }
+    return (a.tx<b.tx);
+}
+
+// *********************************** protected methods ******************************
+
+/**
+ *  A tile that is not stored is assembled from every other sample of the
+ *  four tiles of the next level, which may in turn be assembled. Nothing is
+ *  written to 'cls' and 'time' unless the tile is found.
+ */
+bool BasinTileCache::gather( const basinTileKey &key, int tileSize, unsigned short *cls, float *time, int stride, int depth ) {
+    std::map<basinTileKey,entryList::iterator,keyLess>::iterator it = m_index.find(key);
+    if (it!=m_index.end() && it->second->tileSize==tileSize) {
+        m_entries.splice(m_entries.begin(),m_entries,it->second);
+        const entry &e = *(it->second);
+        for(int v=0; v<tileSize; v++) {
+            memcpy(cls + v*stride, &e.cls[v*tileSize], sizeof(unsigned short)*tileSize);
+            memcpy(time + v*stride, &e.time[v*tileSize], sizeof(float)*tileSize);
+        }
+        return true;
+    }
+    if (depth<1 || (tileSize & 1)!=0) {
+        return false;
+    }
+
+    // the four finer tiles side by side, (2*tx,2*ty) at the lower left
+    int fineSize = 2*tileSize;
+    std::vector<unsigned short> fcls(fineSize*fineSize);
+    std::vector<float> ftime(fineSize*fineSize);
+    for(int j=0; j<2; j++) {
+        for(int i=0; i<2; i++) {
+            basinTileKey fine = { key.lattice, key.level + 1, 2*key.tx + i, 2*key.ty + j };
+            int offset = j*tileSize*fineSize + i*tileSize;
+            if (!gather(fine,tileSize,&fcls[offset],&ftime[offset],fineSize,depth-1)) {
+                return false;
+            }
+        }
+    }
+
+    for(int v=0; v<tileSize; v++) {
+        for(int u=0; u<tileSize; u++) {
+            cls[v*stride + u]  = fcls[2*v*fineSize + 2*u];
+            time[v*stride + u] = ftime[2*v*fineSize + 2*u];
+        }
+    }
+    insert(key,tileSize,cls,time,stride);
+    return true;
+}
+
+void BasinTileCache::insert( const basinTileKey &key, int tileSize, const unsigned short *cls, const float *time, int stride ) {
+    std::map<basinTileKey,entryList::iterator,keyLess>::iterator it = m_index.find(key);
+    if (it!=m_index.end()) {
+        m_numBytes -= it->second->cls.size()*(sizeof(unsigned short) + sizeof(float));
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_entries.push_front(entry());
+    entry &e = m_entries.front();
+    e.key = key;
+    e.tileSize = tileSize;
+    e.cls.resize(tileSize*tileSize);
+    e.time.resize(tileSize*tileSize);
+    for(int v=0; v<tileSize; v++) {
+        memcpy(&e.cls[v*tileSize], cls + v*stride, sizeof(unsigned short)*tileSize);
+        memcpy(&e.time[v*tileSize], time + v*stride, sizeof(float)*tileSize);
+    }
+    m_index[key] = m_entries.begin();
+    m_numBytes += e.cls.size()*(sizeof(unsigned short) + sizeof(float));
+}
+
+/**
+ *  Drop the least recently used tiles until the capacity is met.
+ */
+void BasinTileCache::evict() {
+    while (m_numBytes>m_capacity && !m_entries.empty()) {
+        const entry &e = m_entries.back();
+        m_numBytes -= e.cls.size()*(sizeof(unsigned short) + sizeof(float));
+        m_index.erase(e.key);
+        m_entries.pop_back();
+    }
+}
@@ -0,0 +1,118 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the cache of finished basin tiles.
+    @file BasinTileCache.h
+*/
+
+#ifndef MPSIM_BASIN_TILE_CACHE_H
+#define MPSIM_BASIN_TILE_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "PendulumParams.h"
+
+#define BASIN_TILE_PIXELS   32   // edge length of a tile in pixels of the basin map
+#define BASIN_CACHE_DEPTH    3   // finer levels that are searched for a missing tile
+
+/**
+ *  A tile of the sample lattice. At level 0 the samples are 'spacing' apart,
+ *  with every level the spacing halves; sample (0,0) is at the origin. Tile
+ *  (tx,ty) holds the samples [tx*size,(tx+1)*size) x [ty*size,(ty+1)*size).
+ */
+typedef struct basinTileKey_t {
+    unsigned long long  lattice;   //!< see BasinTileCache::LatticeHash
+    int  level;
+    int  tx, ty;
+} basinTileKey;
+
+
+/**
+ * @brief The BasinTileCache class
+ *
+ *  Least recently used store of finished tiles of the basin map: class (0 if
+ *  not captured, magnet index + 1 otherwise, with BASIN_CLASS_DECIDED) and
+ *  capture time per sample, as in 'quad.frag'. A view that is panned only integrates the tiles that were
+ *  not seen before.
+ *
+ *  Every sample of a level is also a sample of the next finer level. A tile
+ *  that is missing is therefore assembled from the four tiles of the finer
+ *  level that cover it, if they are known; so zooming out reuses the tiles
+ *  of the zoomed-in views.
+ *
+ *  All methods lock the cache; the GUI and the particle thread share it.
+ */
+class BasinTileCache
+{
+public:
+    BasinTileCache();
+    ~BasinTileCache();
+
+public:
+    /** Set the memory for the tiles; the least recently used ones are dropped.
+     * @param numBytes  Size of the class and time arrays of all tiles.
+     */
+    void   SetCapacity( size_t numBytes );
+    size_t NumBytes() const;
+    int    NumTiles() const;
+    void   Clear();
+
+    /** Store a tile.
+     * @param key       Tile of the lattice.
+     * @param tileSize  Edge length of the tile in samples.
+     * @param cls       Class of the lower left sample.
+     * @param time      Capture time of the lower left sample.
+     * @param stride    Samples per row of 'cls' and 'time'.
+     */
+    void   Insert( const basinTileKey &key, int tileSize, const unsigned short *cls, const float *time, int stride );
+
+    /** Copy a tile; see Insert() for the parameters.
+     * @return false if the tile is neither known nor assembled from finer levels.
+     */
+    bool   Find( const basinTileKey &key, int tileSize, unsigned short *cls, float *time, int stride );
+
+    /** Key of a sample lattice: everything that decides the outcome of a sample
+     *  except its position.
+     * @param params    Pendulum parameters.
+     * @param maxTime   Maximum integration time of a sample.
+     * @param spacing   Distance of the samples at level 0.
+     * @param tileSize  Edge length of a tile in samples.
+     */
+    static unsigned long long  LatticeHash( const PendulumParams &params, double maxTime, double spacing, int tileSize );
+
+protected:
+    struct entry {
+        basinTileKey  key;
+        int           tileSize;
+        std::vector<unsigned short>  cls;
+        std::vector<float>           time;
+    };
+
+    struct keyLess {
+        bool operator()( const basinTileKey &a, const basinTileKey &b ) const;
+    };
+
+    typedef std::list<entry>  entryList;
+
+    bool   gather( const basinTileKey &key, int tileSize, unsigned short *cls, float *time, int stride, int depth );
+    void   insert( const basinTileKey &key, int tileSize, const unsigned short *cls, const float *time, int stride );
+    void   evict();
+
+private:
+    mutable std::mutex  m_mutex;
+    entryList  m_entries;     //!< most recently used first
+    std::map<basinTileKey,entryList::iterator,keyLess>  m_index;
+    size_t     m_capacity;
+    size_t     m_numBytes;
+};
+
+#endif // MPSIM_BASIN_TILE_CACHE_H
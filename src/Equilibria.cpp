@@ -0,0 +1,410 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file Equilibria.cpp
+*/
+
+#include "Equilibria.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <set>
+
+#define DEF_MAX(x,y)  ((x)>(y)?(x):(y))
+#define DEF_MIN(x,y)  ((x)<(y)?(x):(y))
+
+#define EQ_NEIGHBOURS  6   // neighbours per magnet for the seeds between magnets
+#define EQ_MAX_RISES   3   // gradient increases after which a local Newton search gives up
+
+
+Equilibria::Equilibria() :
+    m_trapEnergy(DBL_MAX),
+    m_stepMax(1.0)
+{
+}
+
+Equilibria::~Equilibria() {
+}
+
+bool Equilibria::Solve( const PendulumParams &params, int numSeeds ) {
+    m_table.Build(params);
+    if (params.m_fieldGrid<2) {
+        // the field grid is built from the exact sum and takes precedence
+        m_table.BuildTree(params);
+    }
+    const double* mx = m_table.X();
+    const double* my = m_table.Y();
+    int numMagnets = m_table.Size();
+
+    m_minima.clear();
+    m_saddles.clear();
+    m_maxima.clear();
+
+    // seeds cover the simulation domain and all magnets
+    double rmax = params.RMax();
+    double xmin = -rmax, xmax = rmax;
+    double ymin = -rmax, ymax = rmax;
+    for(int i=0; i<numMagnets; i++) {
+        xmin = DEF_MIN(xmin,mx[i]);
+        xmax = DEF_MAX(xmax,mx[i]);
+        ymin = DEF_MIN(ymin,my[i]);
+        ymax = DEF_MAX(ymax,my[i]);
+    }
+    double size = DEF_MAX(xmax-xmin,ymax-ymin);
+    xmin -= 0.25*size;
+    xmax += 0.25*size;
+    ymin -= 0.25*size;
+    ymax += 0.25*size;
+
+    numSeeds = DEF_MAX(numSeeds,2);
+    double dx = (xmax-xmin)/(numSeeds-1);
+    double dy = (ymax-ymin)/(numSeeds-1);
+    for(int iy=0; iy<numSeeds; iy++) {
+        for(int ix=0; ix<numSeeds; ix++) {
+            double x = xmin + ix*dx;
+            double y = ymin + iy*dy;
+            if (newton(x,y,DEF_MAX(dx,dy))) {
+                addEquilibrium(x,y,1e-6*size);
+            }
+        }
+    }
+
+    // seeds x, y, and maximum step
+    std::vector<double> seeds;
+    appendMagnetSeeds(seeds);
+    for(unsigned int i=0; i<seeds.size(); i+=3) {
+        double x = seeds[i];
+        double y = seeds[i+1];
+        if (newton(x,y,seeds[i+2],4.0*seeds[i+2])) {
+            addEquilibrium(x,y,1e-6*size);
+        }
+    }
+
+    // nearest magnet and isolation radius of every minimum
+    m_trapEnergy = DBL_MAX;
+    for(unsigned int i=0; i<m_saddles.size(); i++) {
+        m_trapEnergy = DEF_MIN(m_trapEnergy,m_saddles[i].potential);
+    }
+    int index = static_cast<int>(m_minima.size() + m_maxima.size()) - static_cast<int>(m_saddles.size());
+    if (index!=1) {
+        fprintf(stderr,"Equilibria: %d minima, %d saddles and %d maxima do not add up, trapping test is off\n",
+                static_cast<int>(m_minima.size()),static_cast<int>(m_saddles.size()),static_cast<int>(m_maxima.size()));
+        m_trapEnergy = -DBL_MAX;
+    }
+
+    m_stepMax = size;
+    for(unsigned int i=0; i<m_minima.size(); i++) {
+        equilibrium &eq = m_minima[i];
+        double d2min = DBL_MAX;
+        for(int m=0; m<numMagnets; m++) {
+            double d2 = (eq.x-mx[m])*(eq.x-mx[m]) + (eq.y-my[m])*(eq.y-my[m]);
+            if (d2<d2min) {
+                d2min = d2;
+                eq.magnet = m;
+            }
+        }
+
+        double dmin = size;
+        const std::vector<equilibrium>* lists[3] = { &m_minima, &m_saddles, &m_maxima };
+        for(int k=0; k<3; k++) {
+            for(unsigned int j=0; j<lists[k]->size(); j++) {
+                const equilibrium &other = (*lists[k])[j];
+                if (&other!=&eq) {
+                    dmin = DEF_MIN(dmin,hypot(other.x-eq.x,other.y-eq.y));
+                }
+            }
+        }
+        eq.radius = 0.5*dmin;
+        m_stepMax = DEF_MIN(m_stepMax,eq.radius);
+    }
+    return (index==1);
+}
+
+double Equilibria::Potential( double x, double y ) const {
+    return m_table.Potential(x,y);
+}
+
+void Equilibria::Gradient( double x, double y, double &gx, double &gy ) const {
+    m_table.MagnetAccel(x,y,gx,gy);
+    gx += m_table.G_L()*x;
+    gy += m_table.G_L()*y;
+}
+
+void Equilibria::Hessian( double x, double y, double &hxx, double &hxy, double &hyy ) const {
+    switch (m_table.Law()) {
+        default:
+        case FORCE_KAPPA1:
+            hessian<ForceKappa1>(x,y,hxx,hxy,hyy);
+            break;
+        case FORCE_KAPPA2:
+            hessian<ForceKappa2>(x,y,hxx,hxy,hyy);
+            break;
+        case FORCE_GENERIC:
+            hessian<ForceGeneric>(x,y,hxx,hxy,hyy);
+            break;
+    }
+}
+
+double Equilibria::Energy( const double *y ) const {
+    return 0.5*(y[2]*y[2] + y[3]*y[3]) + Potential(y[0],y[1]);
+}
+
+double Equilibria::TrapEnergy() const {
+    return m_trapEnergy;
+}
+
+/**
+ *  Descend V from (x,y). Every step decreases V and is shorter than the
+ *  isolation radius of the minima, so the path cannot jump over a saddle into
+ *  another trapping region. Newton steps are used where V is convex.
+ */
+int Equilibria::Classify( double x, double y ) const {
+    if (m_minima.size()<2) {
+        return (m_minima.empty() ? -1 : 0);
+    }
+
+    double V = Potential(x,y);
+    for(int iter=0; iter<500; iter++) {
+        for(unsigned int i=0; i<m_minima.size(); i++) {
+            double dx = x - m_minima[i].x;
+            double dy = y - m_minima[i].y;
+            if (dx*dx + dy*dy < m_minima[i].radius*m_minima[i].radius) {
+                return static_cast<int>(i);
+            }
+        }
+
+        double gx, gy, hxx, hxy, hyy;
+        Gradient(x,y,gx,gy);
+        Hessian(x,y,hxx,hxy,hyy);
+
+        double sx = -gx;
+        double sy = -gy;
+        double det = hxx*hyy - hxy*hxy;
+        if (det>0.0 && hxx>0.0) {
+            sx = -( hyy*gx - hxy*gy)/det;
+            sy = -(-hxy*gx + hxx*gy)/det;
+        } else {
+            double hn = fabs(hxx) + fabs(hyy) + fabs(hxy) + 1e-30;
+            sx /= hn;
+            sy /= hn;
+        }
+        double len = sqrt(sx*sx + sy*sy);
+        if (len>m_stepMax) {
+            sx *= m_stepMax/len;
+            sy *= m_stepMax/len;
+        }
+
+        double Vnew = Potential(x+sx,y+sy);
+        int n = 0;
+        while (Vnew>=V && n<30) {
+            sx *= 0.5;
+            sy *= 0.5;
+            Vnew = Potential(x+sx,y+sy);
+            n++;
+        }
+        if (Vnew>=V) {
+            break;
+        }
+        x += sx;
+        y += sy;
+        V = Vnew;
+    }
+
+    // fallback: nearest minimum
+    int idx = 0;
+    double d2min = DBL_MAX;
+    for(unsigned int i=0; i<m_minima.size(); i++) {
+        double d2 = (x-m_minima[i].x)*(x-m_minima[i].x) + (y-m_minima[i].y)*(y-m_minima[i].y);
+        if (d2<d2min) {
+            d2min = d2;
+            idx = static_cast<int>(i);
+        }
+    }
+    return idx;
+}
+
+int Equilibria::CapturedBy( const double *y ) const {
+    if (m_minima.empty() || Energy(y)>=m_trapEnergy) {
+        return -1;
+    }
+    return m_minima[Classify(y[0],y[1])].magnet;
+}
+
+double Equilibria::StepMax() const {
+    return m_stepMax;
+}
+
+const std::vector<equilibrium>& Equilibria::Minima() const {
+    return m_minima;
+}
+
+const std::vector<equilibrium>& Equilibria::Saddles() const {
+    return m_saddles;
+}
+
+const std::vector<equilibrium>& Equilibria::Maxima() const {
+    return m_maxima;
+}
+
+// *********************************** protected methods ******************************
+
+/**
+ *  Newton's method for grad V = 0 with step length limited to 'maxStep'.
+ *  With a finite 'maxDist', the search is local: it gives up once the iterate
+ *  is farther than 'maxDist' from the seed or the gradient keeps growing, which stops
+ *  the Newton cycles of a seed without an equilibrium nearby early.
+ */
+bool Equilibria::newton( double &x, double &y, double maxStep, double maxDist ) const {
+    double x0 = x;
+    double y0 = y;
+    double g2prev = DBL_MAX;
+    int numRises = 0;
+    for(int iter=0; iter<50; iter++) {
+        double gx, gy, hxx, hxy, hyy;
+        Gradient(x,y,gx,gy);
+        double g2 = gx*gx + gy*gy;
+        if (g2>g2prev && maxDist<DBL_MAX && ++numRises>EQ_MAX_RISES) {
+            return false;
+        }
+        g2prev = g2;
+        Hessian(x,y,hxx,hxy,hyy);
+
+        double det = hxx*hyy - hxy*hxy;
+        if (fabs(det)<1e-300) {
+            return false;
+        }
+        double sx = -( hyy*gx - hxy*gy)/det;
+        double sy = -(-hxy*gx + hxx*gy)/det;
+        double len = sqrt(sx*sx + sy*sy);
+        if (len>maxStep) {
+            sx *= maxStep/len;
+            sy *= maxStep/len;
+        }
+        x += sx;
+        y += sy;
+        if (len<1e-13) {
+            return true;
+        }
+        if ((x-x0)*(x-x0) + (y-y0)*(y-y0) > maxDist*maxDist) {
+            return false;
+        }
+    }
+    return false;
+}
+
+/**
+ *  Every magnet, the midpoints to its EQ_NEIGHBOURS nearest magnets, and the
+ *  centroids of the triangles it forms with angularly adjacent neighbours;
+ *  this covers the minima, saddles, and maxima of a lattice. The Newton steps
+ *  are limited to half the distance to the nearest neighbour, so a seed
+ *  converges to an equilibrium of its own neighbourhood; seeds that wander
+ *  off are left to the grid. This happens where magnets are much closer than
+ *  their height and their wells merge.
+ */
+void Equilibria::appendMagnetSeeds( std::vector<double> &seeds ) const {
+    const double* mx = m_table.X();
+    const double* my = m_table.Y();
+    int numMagnets = m_table.Size();
+    int numNeighbours = DEF_MIN(EQ_NEIGHBOURS,numMagnets-1);
+
+    std::set<std::pair<int,int> > pairs;
+    std::set<std::vector<int> > triangles;
+    std::vector<std::pair<double,int> > dist(numMagnets);
+    std::vector<std::pair<double,int> > fan(numNeighbours);
+    for(int i=0; i<numMagnets; i++) {
+        for(int j=0; j<numMagnets; j++) {
+            double d2 = (mx[j]-mx[i])*(mx[j]-mx[i]) + (my[j]-my[i])*(my[j]-my[i]);
+            dist[j] = std::make_pair((j==i ? DBL_MAX : d2),j);
+        }
+        std::partial_sort(dist.begin(),dist.begin()+numNeighbours,dist.end());
+        double step = (numNeighbours>0 ? 0.5*sqrt(dist[0].first) : 1.0);
+
+        seeds.push_back(mx[i]);
+        seeds.push_back(my[i]);
+        seeds.push_back(step);
+
+        for(int k=0; k<numNeighbours; k++) {
+            int j = dist[k].second;
+            fan[k] = std::make_pair(atan2(my[j]-my[i],mx[j]-mx[i]),j);
+            if (pairs.insert(std::make_pair(DEF_MIN(i,j),DEF_MAX(i,j))).second) {
+                seeds.push_back(0.5*(mx[i] + mx[j]));
+                seeds.push_back(0.5*(my[i] + my[j]));
+                seeds.push_back(step);
+            }
+        }
+
+        std::sort(fan.begin(),fan.end());
+        for(int k=0; k<numNeighbours && numNeighbours>1; k++) {
+            int a = fan[k].second;
+            int b = fan[(k+1) % numNeighbours].second;
+            double gap = fan[(k+1) % numNeighbours].first - fan[k].first;
+            if (gap<0.0) {
+                gap += 2.0*M_PI;
+            }
+            if (gap>=M_PI) {
+                continue;
+            }
+            std::vector<int> tri(3);
+            tri[0] = i;
+            tri[1] = a;
+            tri[2] = b;
+            std::sort(tri.begin(),tri.end());
+            if (triangles.insert(tri).second) {
+                seeds.push_back((mx[i] + mx[a] + mx[b])/3.0);
+                seeds.push_back((my[i] + my[a] + my[b])/3.0);
+                seeds.push_back(step);
+            }
+        }
+    }
+}
+
+template <class Law>
+void Equilibria::hessian( double x, double y, double &hxx, double &hxy, double &hyy ) const {
+    const double* mx  = m_table.X();
+    const double* my  = m_table.Y();
+    const double* rz2 = m_table.RZ2();
+    const double* kam = m_table.KAM();
+    double kappa = m_table.Kappa();
+
+    hxx = hyy = m_table.G_L();
+    hxy = 0.0;
+    for(int i=0; i<m_table.Size(); i++) {
+        double rx = x - mx[i];
+        double ry = y - my[i];
+        double r2 = rx*rx + ry*ry + rz2[i];
+        double f = kam[i]*Law::Numer(r2,kappa);
+        double q = (kappa+2.0)*f/r2;
+        hxx += f - q*rx*rx;
+        hxy -= q*rx*ry;
+        hyy += f - q*ry*ry;
+    }
+}
+
+void Equilibria::addEquilibrium( double x, double y, double tol ) {
+    double hxx, hxy, hyy;
+    Hessian(x,y,hxx,hxy,hyy);
+    double det = hxx*hyy - hxy*hxy;
+
+    equilibrium eq;
+    eq.x = x;
+    eq.y = y;
+    eq.potential = Potential(x,y);
+    eq.type = (det<0.0 ? EQ_SADDLE : (hxx>0.0 ? EQ_MINIMUM : EQ_MAXIMUM));
+    eq.magnet = -1;
+    eq.radius = 0.0;
+
+    std::vector<equilibrium> &list = (eq.type==EQ_MINIMUM ? m_minima : (eq.type==EQ_SADDLE ? m_saddles : m_maxima));
+    for(unsigned int i=0; i<list.size(); i++) {
+        if (fabs(list[i].x-x)<tol && fabs(list[i].y-y)<tol) {
+            return;
+        }
+    }
+    list.push_back(eq);
+}
@@ -0,0 +1,127 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the equilibria of the gravity+magnet potential.
+    @file Equilibria.h
+*/
+
+#ifndef MPSIM_EQUILIBRIA_H
+#define MPSIM_EQUILIBRIA_H
+
+#include <cfloat>
+#include <vector>
+
+#include "MagnetTable.h"
+#include "PendulumParams.h"
+
+enum eqType {
+    EQ_MINIMUM = 0,
+    EQ_SADDLE,
+    EQ_MAXIMUM
+};
+
+typedef struct equilibrium_t {
+    double  x, y;
+    double  potential;   //!< V(x,y)
+    eqType  type;
+    int     magnet;      //!< nearest magnet
+    double  radius;      //!< half distance to the nearest other equilibrium
+} equilibrium;
+
+
+/**
+ * @brief The Equilibria class
+ *
+ *  Critical points of the potential of the Cartesian model (see calcRHS)
+ *
+ *     V(x,y) = g/(2l)*(x^2+y^2) - sum_i alpha_i*magFactor*r_i^(-kappa),
+ *
+ *  found by Newton's method. The seeds are a grid over the domain and, since
+ *  a lattice of many magnets has an equilibrium near every magnet and between
+ *  neighbouring ones, every magnet, the midpoint of every pair of neighbours,
+ *  and the centroid of every triangle of neighbours. The total energy
+ *  E = v^2/2 + V never increases. Once E is below the lowest saddle, the bob
+ *  cannot leave its connected component of {V < E}, which contains exactly one
+ *  minimum. This trapping test decides the final magnet long before the bob
+ *  comes to rest. Note that the minima are not at the magnet positions.
+ *
+ *  A missed saddle would make the threshold too high, so the equilibria are
+ *  checked against the Poincare-Hopf theorem: V grows like r^2, so
+ *  #minima - #saddles + #maxima = 1 on the plane. If the sum does not match,
+ *  the trapping test is switched off (TrapEnergy() is -DBL_MAX) and the bob
+ *  is integrated until the maximum time.
+ *
+ *  With a magnet tree (treeTheta > 0) and no field grid, the equilibria are
+ *  those of the tree potential. Its error can exceed the depth of shallow minima, and the trap
+ *  test has to agree with the field the bob actually moves in. The Hessian
+ *  stays exact; Newton's method converges to the tree equilibria all the same.
+ */
+class Equilibria
+{
+public:
+    Equilibria();
+    ~Equilibria();
+
+public:
+    /** Find all equilibria for the given parameters.
+     * @param params   Pendulum parameters.
+     * @param numSeeds Number of grid seeds per axis; the seeds near the magnets come on top.
+     * @return false if the index sum does not match and the trapping test is off.
+     */
+    bool   Solve( const PendulumParams &params, int numSeeds = 32 );
+
+    double Potential( double x, double y ) const;
+    void   Gradient( double x, double y, double &gx, double &gy ) const;
+    void   Hessian( double x, double y, double &hxx, double &hxy, double &hyy ) const;
+
+    /** Total energy of state y = (x,y,vx,vy).
+     */
+    double Energy( const double *y ) const;
+
+    /** Lowest saddle potential; bobs with less energy are trapped.
+     *    -DBL_MAX if the equilibria are incomplete.
+     */
+    double TrapEnergy() const;
+
+    /** Minimum whose trapping region contains (x,y).
+     *    Only meaningful if V(x,y) < TrapEnergy().
+     * @return index into Minima().
+     */
+    int    Classify( double x, double y ) const;
+
+    /** Magnet the bob will end at, or -1 if it is not yet trapped.
+     */
+    int    CapturedBy( const double *y ) const;
+
+    /** Maximum step length of the descent in Classify().
+     */
+    double StepMax() const;
+
+    const std::vector<equilibrium>&  Minima() const;
+    const std::vector<equilibrium>&  Saddles() const;
+    const std::vector<equilibrium>&  Maxima() const;
+
+protected:
+    bool   newton( double &x, double &y, double maxStep, double maxDist = DBL_MAX ) const;
+    void   addEquilibrium( double x, double y, double tol );
+    void   appendMagnetSeeds( std::vector<double> &seeds ) const;
+
+    template <class Law>
+    void   hessian( double x, double y, double &hxx, double &hxy, double &hyy ) const;
+
+private:
+    MagnetTable  m_table;
+
+    double  m_trapEnergy;
+    double  m_stepMax;
+    std::vector<equilibrium>  m_minima;
+    std::vector<equilibrium>  m_saddles;
+    std::vector<equilibrium>  m_maxima;
+};
+
+#endif // MPSIM_EQUILIBRIA_H
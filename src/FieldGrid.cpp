@@ -0,0 +1,174 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file FieldGrid.cpp
+*/
+
+#include "FieldGrid.h"
+#include "MagnetTable.h"
+#include "TileScheduler.h"
+
+#define DEF_MAX(x,y)  ((x)>(y)?(x):(y))
+#define DEF_MIN(x,y)  ((x)<(y)?(x):(y))
+
+#define FIELD_GRID_RANDOM_SAMPLES  4096
+
+
+FieldGrid::FieldGrid() :
+    m_numNodes(0),
+    m_extent(0.0),
+    m_spacing(1.0),
+    m_invSpacing(1.0)
+{
+}
+
+FieldGrid::~FieldGrid() {
+}
+
+void FieldGrid::Build( const MagnetTable &table, double extent, int numNodes, int numThreads ) {
+    m_numNodes = DEF_MAX(numNodes,2);
+    m_extent = extent;
+    m_spacing = 2.0*m_extent/(m_numNodes-1);
+    m_invSpacing = 1.0/m_spacing;
+    m_data.assign(8*m_numNodes*m_numNodes,0.0);
+
+    switch (table.Law()) {
+        default:
+        case FORCE_KAPPA1:
+            buildFor<ForceKappa1>(table,numThreads);
+            break;
+        case FORCE_KAPPA2:
+            buildFor<ForceKappa2>(table,numThreads);
+            break;
+        case FORCE_GENERIC:
+            buildFor<ForceGeneric>(table,numThreads);
+            break;
+    }
+}
+
+void FieldGrid::Clear() {
+    m_numNodes = 0;
+    m_extent = 0.0;
+    m_data.clear();
+}
+
+bool FieldGrid::IsValid() const {
+    return (m_numNodes>1);
+}
+
+int FieldGrid::NumNodes() const {
+    return m_numNodes;
+}
+
+double FieldGrid::Extent() const {
+    return m_extent;
+}
+
+double FieldGrid::Spacing() const {
+    return m_spacing;
+}
+
+void FieldGrid::EstimateError( const MagnetTable &table, double &maxAbs, double &maxRel ) const {
+    maxAbs = maxRel = 0.0;
+    if (!IsValid()) {
+        return;
+    }
+
+    double amax = 0.0;
+    for(int i=0; i<m_numNodes*m_numNodes; i++) {
+        amax = DEF_MAX(amax,sqrt(m_data[8*i+1]*m_data[8*i+1] + m_data[8*i+2]*m_data[8*i+2]));
+    }
+
+    auto compare = [this,&table,&maxAbs](double x, double y) {
+        double ax, ay, ex, ey;
+        Accel(x,y,ax,ay);
+        table.ExactMagnetAccel(x,y,ex,ey);
+        maxAbs = DEF_MAX(maxAbs,sqrt((ax-ex)*(ax-ex) + (ay-ey)*(ay-ey)));
+    };
+
+    // every cell center for small grids, otherwise about 256^2 of them
+    int stride = DEF_MAX(1,(m_numNodes-1)/256);
+    for(int iy=0; iy<m_numNodes-1; iy+=stride) {
+        for(int ix=0; ix<m_numNodes-1; ix+=stride) {
+            compare(-m_extent + (ix+0.5)*m_spacing,-m_extent + (iy+0.5)*m_spacing);
+        }
+    }
+
+    unsigned int seed = 12345u;
+    for(int i=0; i<FIELD_GRID_RANDOM_SAMPLES; i++) {
+        seed = seed*1664525u + 1013904223u;
+        double x = m_extent*((seed>>8)/8388608.0 - 1.0);
+        seed = seed*1664525u + 1013904223u;
+        double y = m_extent*((seed>>8)/8388608.0 - 1.0);
+        compare(x,y);
+    }
+    maxRel = (amax>0.0 ? maxAbs/amax : 0.0);
+}
+
+void FieldGrid::FillGPUBuffer( float *buf ) const {
+    for(unsigned int i=0; i<m_data.size(); i++) {
+        buf[i] = static_cast<float>(m_data[i]);
+    }
+}
+
+// *********************************** protected methods ******************************
+
+template <class Law>
+void FieldGrid::buildFor( const MagnetTable &table, int numThreads ) {
+    TileScheduler scheduler;
+    scheduler.SetImage(m_numNodes,m_numNodes,32);
+    scheduler.Run(numThreads,[this,&table](const basinTile &tile) {
+        for(int iy=tile.y0; iy<tile.y1; iy++) {
+            for(int ix=tile.x0; ix<tile.x1; ix++) {
+                buildNode<Law>(table,ix,iy);
+            }
+        }
+    });
+}
+
+/**
+ *  With f = kam*r2^(-1-kappa/2) and q = (kappa+2)*f/r2, every magnet adds
+ *
+ *     ax   += f*rx,                  ay   += f*ry,
+ *     axx  += f - q*rx^2,            ayy  += f - q*ry^2,     axy += -q*rx*ry,
+ *     axxy += q*ry*((kappa+4)*rx^2/r2 - 1),
+ *     ayxy += q*rx*((kappa+4)*ry^2/r2 - 1),
+ *
+ *  see also Equilibria::Hessian.
+ */
+template <class Law>
+void FieldGrid::buildNode( const MagnetTable &table, int ix, int iy ) {
+    const double* mx  = table.X();
+    const double* my  = table.Y();
+    const double* rz2 = table.RZ2();
+    const double* am  = table.AM();
+    const double* kam = table.KAM();
+    double kappa = table.Kappa();
+    int numMagnets = table.Size();
+
+    double x = -m_extent + ix*m_spacing;
+    double y = -m_extent + iy*m_spacing;
+    double* node = &m_data[8*(iy*m_numNodes + ix)];
+    for(int i=0; i<numMagnets; i++) {
+        double rx = x - mx[i];
+        double ry = y - my[i];
+        double r2 = rx*rx + ry*ry + rz2[i];
+        double inv = Law::Inverse(r2,kappa);
+        double f = kam[i]*inv/r2;
+        double q = (kappa+2.0)*f/r2;
+        double c = (kappa+4.0)/r2;
+        node[0] -= am[i]*inv;
+        node[1] += f*rx;
+        node[2] += f*ry;
+        node[3] -= q*rx*ry;
+        node[4] += f - q*rx*rx;
+        node[5] += f - q*ry*ry;
+        node[6] += q*ry*(c*rx*rx - 1.0);
+        node[7] += q*rx*(c*ry*ry - 1.0);
+    }
+}
@@ -0,0 +1,153 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the tabulated magnet field.
+    @file FieldGrid.h
+*/
+
+#ifndef MPSIM_FIELD_GRID_H
+#define MPSIM_FIELD_GRID_H
+
+#include <cmath>
+#include <vector>
+
+class MagnetTable;
+
+/**
+ * @brief The FieldGrid class
+ *
+ *  In the Cartesian model the vertical distance to every magnet is constant,
+ *  hence the magnetic acceleration is a function of (x,y) only. The grid
+ *  tabulates it on n x n nodes over [-extent,extent]^2 and interpolates with
+ *  bicubic Hermite patches. Every node stores
+ *
+ *     U, ax, ay, axy, axx, ayy, axxy, ayxy
+ *
+ *  where U is the magnet part of the potential, (ax,ay) = grad U is the
+ *  acceleration of MagnetTable::MagnetAccel, and axy = d(ax)/dy etc. are its
+ *  exact derivatives. U, ax and ay therefore each have their value, both first
+ *  derivatives and the mixed derivative at the nodes, which is all a bicubic
+ *  Hermite patch needs. The interpolation error is O(h^4), independent of the
+ *  number of magnets, and so is the cost of an evaluation.
+ */
+class FieldGrid
+{
+public:
+    FieldGrid();
+    ~FieldGrid();
+
+public:
+    /** Tabulate the magnet field of 'table'.
+     * @param table       Exact magnet sum.
+     * @param extent      Half edge of the square grid domain.
+     * @param numNodes    Number of nodes per axis.
+     * @param numThreads  0 uses all cores.
+     */
+    void   Build( const MagnetTable &table, double extent, int numNodes, int numThreads = 0 );
+    void   Clear();
+
+    bool   IsValid() const;
+    int    NumNodes() const;
+    double Extent() const;
+    double Spacing() const;
+
+    /** True if (x,y) lies inside the tabulated domain.
+     */
+    bool   Inside( double x, double y ) const {
+        return (fabs(x)<m_extent && fabs(y)<m_extent);
+    }
+
+    /** Interpolated acceleration; (x,y) has to be Inside().
+     */
+    void   Accel( double x, double y, double &ax, double &ay ) const {
+        int idx;
+        double hu[4], hv[4];
+        weights(x,y,idx,hu,hv);
+        const double* n00 = &m_data[8*idx];
+        const double* n10 = n00 + 8;
+        const double* n01 = n00 + 8*m_numNodes;
+        const double* n11 = n01 + 8;
+        ax = patch(n00,n10,n01,n11,1,4,3,6,hu,hv);
+        ay = patch(n00,n10,n01,n11,2,3,5,7,hu,hv);
+    }
+
+    /** Interpolated magnet part of the potential; (x,y) has to be Inside().
+     */
+    double Potential( double x, double y ) const {
+        int idx;
+        double hu[4], hv[4];
+        weights(x,y,idx,hu,hv);
+        const double* n00 = &m_data[8*idx];
+        const double* n10 = n00 + 8;
+        const double* n01 = n00 + 8*m_numNodes;
+        const double* n11 = n01 + 8;
+        return patch(n00,n10,n01,n11,0,1,2,3,hu,hv);
+    }
+
+    /** Compare the interpolated acceleration with the exact sum at the cell
+     *  centers (where the Hermite error is largest) and at random points.
+     * @param table   Exact magnet sum the grid was built from.
+     * @param maxAbs  Reference to the maximum absolute error of |a|.
+     * @param maxRel  Reference to the maximum error relative to the largest |a| on the grid.
+     */
+    void   EstimateError( const MagnetTable &table, double &maxAbs, double &maxRel ) const;
+
+    /** Fill 'buf' with two vec4 (U,ax,ay,axy),(axx,ayy,axxy,ayxy) per node for the compute shader.
+     */
+    void   FillGPUBuffer( float *buf ) const;
+
+protected:
+    /** Node index of the cell that contains (x,y) and the Hermite weights
+     *  h00,h01,h10*h,h11*h along both axes.
+     */
+    void   weights( double x, double y, int &idx, double *hu, double *hv ) const {
+        double fx = (x + m_extent)*m_invSpacing;
+        double fy = (y + m_extent)*m_invSpacing;
+        int ix = static_cast<int>(fx);
+        int iy = static_cast<int>(fy);
+        ix = (ix<m_numNodes-2 ? ix : m_numNodes-2);
+        iy = (iy<m_numNodes-2 ? iy : m_numNodes-2);
+        idx = iy*m_numNodes + ix;
+        hermite(fx-ix,hu);
+        hermite(fy-iy,hv);
+    }
+
+    void   hermite( double t, double *h ) const {
+        double t2 = t*t;
+        double t3 = t2*t;
+        h[0] = 2.0*t3 - 3.0*t2 + 1.0;
+        h[1] = 3.0*t2 - 2.0*t3;
+        h[2] = (t3 - 2.0*t2 + t)*m_spacing;
+        h[3] = (t3 - t2)*m_spacing;
+    }
+
+    /** Bicubic Hermite patch of the node components f, f_x, f_y, f_xy.
+     */
+    static double patch( const double* n00, const double* n10, const double* n01, const double* n11,
+                         int f, int fx, int fy, int fxy, const double *hu, const double *hv ) {
+        double v0 = hu[0]*n00[f]  + hu[1]*n10[f]  + hu[2]*n00[fx]  + hu[3]*n10[fx];
+        double v1 = hu[0]*n01[f]  + hu[1]*n11[f]  + hu[2]*n01[fx]  + hu[3]*n11[fx];
+        double d0 = hu[0]*n00[fy] + hu[1]*n10[fy] + hu[2]*n00[fxy] + hu[3]*n10[fxy];
+        double d1 = hu[0]*n01[fy] + hu[1]*n11[fy] + hu[2]*n01[fxy] + hu[3]*n11[fxy];
+        return hv[0]*v0 + hv[1]*v1 + hv[2]*d0 + hv[3]*d1;
+    }
+
+    template <class Law>
+    void   buildNode( const MagnetTable &table, int ix, int iy );
+    template <class Law>
+    void   buildFor( const MagnetTable &table, int numThreads );
+
+private:
+    int     m_numNodes;
+    double  m_extent;
+    double  m_spacing;
+    double  m_invSpacing;
+    std::vector<double>  m_data;   //!< 8 doubles per node, row by row
+};
+
+#endif // MPSIM_FIELD_GRID_H
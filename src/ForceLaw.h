@@ -0,0 +1,203 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header-only force-law policies of the magnet interaction.
+    @file ForceLaw.h
+*/
+
+#ifndef MPSIM_FORCE_LAW_H
+#define MPSIM_FORCE_LAW_H
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+enum forceLaw {
+    FORCE_KAPPA1 = 0,
+    FORCE_KAPPA2,
+    FORCE_GENERIC
+};
+
+/**
+ *  Force law that is evaluated for the exponent kappa.
+ */
+inline forceLaw ForceLawFromKappa( double kappa ) {
+    if (kappa==1.0) {
+        return FORCE_KAPPA1;
+    }
+    if (kappa==2.0) {
+        return FORCE_KAPPA2;
+    }
+    return FORCE_GENERIC;
+}
+
+inline const char* ForceLawName( forceLaw law ) {
+    switch (law) {
+        default:
+        case FORCE_KAPPA1:
+            return "kappa1";
+        case FORCE_KAPPA2:
+            return "kappa2";
+        case FORCE_GENERIC:
+            return "generic";
+    }
+}
+
+
+/**
+ *  Base-2 logarithm for positive, normal x without branches and table lookups,
+ *  so that loops over it can be vectorized. The mantissa is reduced to
+ *  [sqrt(1/2),sqrt(2)) and ln(m) = 2*atanh(s), s=(m-1)/(m+1), |s|<0.1716, is
+ *  summed up to s^21. The absolute error is below 2e-16.
+ *
+ *  Only integer operations select the mantissa range: floating-point compares
+ *  may trap and are therefore not if-converted by gcc.
+ */
+inline double FastLog2( double x ) {
+    const uint64_t SQRT2_MANT = 0x0006a09e667f3bcdULL;   // mantissa bits of sqrt(2)
+    const double INV_LN2 = 1.4426950408889634;
+    uint64_t bits;
+    memcpy(&bits,&x,sizeof(double));
+
+    uint64_t mant = bits & 0x000fffffffffffffULL;
+    uint64_t big  = static_cast<uint64_t>(mant>SQRT2_MANT);
+
+    // biased exponent as double: 2^52 + ebits - 2^52
+    uint64_t ebits = ((bits>>52) + big) | 0x4330000000000000ULL;
+    double e;
+    memcpy(&e,&ebits,sizeof(double));
+    e -= 4503599627370496.0 + 1023.0;
+
+    // m in [1,2) or, if above sqrt(2), m/2
+    uint64_t mbits = (mant | 0x3ff0000000000000ULL) - (big<<52);
+    double m;
+    memcpy(&m,&mbits,sizeof(double));
+
+    double s  = (m-1.0)/(m+1.0);
+    double s2 = s*s;
+    double p = 1.0/21.0;
+    p = p*s2 + 1.0/19.0;
+    p = p*s2 + 1.0/17.0;
+    p = p*s2 + 1.0/15.0;
+    p = p*s2 + 1.0/13.0;
+    p = p*s2 + 1.0/11.0;
+    p = p*s2 + 1.0/9.0;
+    p = p*s2 + 1.0/7.0;
+    p = p*s2 + 1.0/5.0;
+    p = p*s2 + 1.0/3.0;
+    p = p*s2 + 1.0;
+    return e + 2.0*INV_LN2*s*p;
+}
+
+/**
+ *  2^y for |y| < 1022, also branch-free. y = n+f with integer n and |f|<=1/2;
+ *  2^f = exp(f*ln2) by its Taylor series up to degree 13 (remainder < 5e-18),
+ *  and 2^n is put directly into the exponent bits.
+ */
+inline double FastExp2( double y ) {
+    const double LN2 = 0.6931471805599453;
+    const double ROUND = 6755399441055744.0;   // 1.5*2^52
+
+    // round to nearest: the integer ends up in the low mantissa bits of t
+    double t = y + ROUND;
+    double n = t - ROUND;
+    double f = (y - n)*LN2;
+
+    double p = 1.0/6227020800.0;
+    p = p*f + 1.0/479001600.0;
+    p = p*f + 1.0/39916800.0;
+    p = p*f + 1.0/3628800.0;
+    p = p*f + 1.0/362880.0;
+    p = p*f + 1.0/40320.0;
+    p = p*f + 1.0/5040.0;
+    p = p*f + 1.0/720.0;
+    p = p*f + 1.0/120.0;
+    p = p*f + 1.0/24.0;
+    p = p*f + 1.0/6.0;
+    p = p*f + 0.5;
+    p = p*f + 1.0;
+    p = p*f + 1.0;
+
+    uint64_t tbits;
+    memcpy(&tbits,&t,sizeof(double));
+    uint64_t sbits = (tbits + 1023) << 52;
+    double scale;
+    memcpy(&scale,&sbits,sizeof(double));
+    return p*scale;
+}
+
+/**
+ *  x^e for positive, normal x. The relative error is below 3e-16*(1+|e*log2(x)|),
+ *  i.e. below 5e-15 for all force evaluations of the pendulum.
+ */
+inline double FastPow( double x, double e ) {
+    return FastExp2(e*FastLog2(x));
+}
+
+/**
+ *  Power used by ForceGeneric. For a single double the table-driven libm pow is
+ *  faster than FastPow; the lane kernels overload ForcePow with a loop over
+ *  FastPow that the compiler vectorizes.
+ */
+inline double ForcePow( double x, double e ) {
+    return pow(x,e);
+}
+
+
+/**
+ *  Force-law policies. For r2 = |r|^2 + rz^2 (+ softening) they provide
+ *
+ *     Numer(r2,kappa)   = r2^(-1-kappa/2)   (force  kappa*am*r*Numer)
+ *     Inverse(r2,kappa) = r2^(-kappa/2)     (potential -am*Inverse)
+ *
+ *  T is double or a lane vector type; the latter needs sqrt, operator/ and an
+ *  overload ForcePow(T,double) that can be found by argument dependent lookup.
+ *  The policy is chosen once per parameter set (see MagnetTable::Build), never
+ *  per evaluation.
+ */
+struct ForceKappa1 {
+    enum { law = FORCE_KAPPA1 };
+
+    template <class T>
+    static T Numer( const T &r2, double ) {
+        T inv = T(1.0)/sqrt(r2);
+        return inv*inv*inv;
+    }
+    template <class T>
+    static T Inverse( const T &r2, double ) {
+        return T(1.0)/sqrt(r2);
+    }
+};
+
+struct ForceKappa2 {
+    enum { law = FORCE_KAPPA2 };
+
+    template <class T>
+    static T Numer( const T &r2, double ) {
+        return T(1.0)/(r2*r2);
+    }
+    template <class T>
+    static T Inverse( const T &r2, double ) {
+        return T(1.0)/r2;
+    }
+};
+
+struct ForceGeneric {
+    enum { law = FORCE_GENERIC };
+
+    template <class T>
+    static T Numer( const T &r2, double kappa ) {
+        return ForcePow(r2,-1.0-0.5*kappa);
+    }
+    template <class T>
+    static T Inverse( const T &r2, double kappa ) {
+        return ForcePow(r2,-0.5*kappa);
+    }
+};
+
+#endif // MPSIM_FORCE_LAW_H
@@ -0,0 +1,336 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file MagnetTable.cpp
+*/
+
+#include "MagnetTable.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#define MAGNET_TABLE_ALIGN   8    // doubles per cache line
+#define MAGNET_TABLE_ARRAYS  5
+
+
+MagnetTable::MagnetTable() :
+    m_num(0),
+    m_stride(0),
+    m_buffer(NULL),
+    m_data(NULL),
+    m_g_l(1.0),
+    m_gamma(0.0),
+    m_kappa(1.0),
+    m_zBob(0.0),
+    m_law(FORCE_KAPPA1),
+    m_accel(&MagnetTable::accelLoop<ForceKappa1>),
+    m_exactAccel(&MagnetTable::accelLoop<ForceKappa1>),
+    m_potential(&MagnetTable::potential<ForceKappa1>),
+    m_exactPotential(&MagnetTable::potential<ForceKappa1>)
+{
+}
+
+MagnetTable::MagnetTable( const MagnetTable &other ) :
+    m_num(0),
+    m_stride(0),
+    m_buffer(NULL),
+    m_data(NULL),
+    m_accel(&MagnetTable::accelLoop<ForceKappa1>),
+    m_exactAccel(&MagnetTable::accelLoop<ForceKappa1>),
+    m_potential(&MagnetTable::potential<ForceKappa1>),
+    m_exactPotential(&MagnetTable::potential<ForceKappa1>)
+{
+    *this = other;
+}
+
+MagnetTable& MagnetTable::operator=( const MagnetTable &other ) {
+    if (this!=&other) {
+        allocate(other.m_num);
+        if (m_data!=NULL) {
+            memcpy(m_data,other.m_data,sizeof(double)*m_stride*MAGNET_TABLE_ARRAYS);
+        }
+        m_g_l = other.m_g_l;
+        m_gamma = other.m_gamma;
+        m_kappa = other.m_kappa;
+        m_zBob = other.m_zBob;
+        m_law = other.m_law;
+        m_grid = other.m_grid;
+        m_tree = other.m_tree;
+        selectAccel();
+    }
+    return *this;
+}
+
+MagnetTable::~MagnetTable() {
+    delete [] m_buffer;
+}
+
+void MagnetTable::Build( const PendulumParams &params ) {
+    double l  = params.m_pendulumLength;
+    double z0 = params.m_pendulumHeight;
+
+    m_g_l = params.m_gravity/l;
+    m_gamma = params.m_damping;
+    m_kappa = params.m_kappa;
+    m_zBob = z0 - l;
+    m_law = ForceLawFromKappa(m_kappa);
+    double a2 = params.m_magnetRadius*params.m_magnetRadius;
+
+    allocate(static_cast<int>(params.m_magnets.size()));
+    double* x   = m_data;
+    double* y   = x + m_stride;
+    double* rz2 = y + m_stride;
+    double* am  = rz2 + m_stride;
+    double* kam = am + m_stride;
+    for(int i=0; i<m_num; i++) {
+        double rz = z0-l - params.m_magnets[i].z;
+        x[i]   = params.m_magnets[i].x;
+        y[i]   = params.m_magnets[i].y;
+        rz2[i] = rz*rz + a2;
+        am[i]  = params.m_magnets[i].alpha*params.m_magFactor;
+        kam[i] = m_kappa*am[i];
+    }
+    m_grid.Clear();
+    if (m_tree.IsValid()) {
+        m_tree.Update(params);
+    }
+    selectAccel();
+}
+
+void MagnetTable::BuildFieldGrid( const PendulumParams &params, int numThreads ) {
+    if (params.m_fieldGrid>1) {
+        m_grid.Build(*this,2.0*params.RMax(),params.m_fieldGrid,numThreads);
+    } else {
+        m_grid.Clear();
+    }
+    selectAccel();
+}
+
+const FieldGrid& MagnetTable::Grid() const {
+    return m_grid;
+}
+
+void MagnetTable::BuildTree( const PendulumParams &params ) {
+    if (params.m_treeTheta>0.0) {
+        m_tree.Update(params);
+        m_tree.SetOpeningAngle(params.m_treeTheta);
+    } else {
+        m_tree.Clear();
+    }
+    selectAccel();
+}
+
+const MagnetTree& MagnetTable::Tree() const {
+    return m_tree;
+}
+
+bool MagnetTable::IsExact() const {
+    return (m_accel==m_exactAccel);
+}
+
+int MagnetTable::Size() const {
+    return m_num;
+}
+
+double MagnetTable::G_L() const {
+    return m_g_l;
+}
+
+double MagnetTable::Gamma() const {
+    return m_gamma;
+}
+
+double MagnetTable::Kappa() const {
+    return m_kappa;
+}
+
+forceLaw MagnetTable::Law() const {
+    return m_law;
+}
+
+const double* MagnetTable::X() const {
+    return m_data;
+}
+
+const double* MagnetTable::Y() const {
+    return m_data + m_stride;
+}
+
+const double* MagnetTable::RZ2() const {
+    return m_data + 2*m_stride;
+}
+
+const double* MagnetTable::AM() const {
+    return m_data + 3*m_stride;
+}
+
+const double* MagnetTable::KAM() const {
+    return m_data + 4*m_stride;
+}
+
+void MagnetTable::FillGPUBuffer( float *buf ) const {
+    for(int i=0; i<m_num; i++) {
+        buf[4*i+0] = static_cast<float>(X()[i]);
+        buf[4*i+1] = static_cast<float>(Y()[i]);
+        buf[4*i+2] = static_cast<float>(RZ2()[i]);
+        buf[4*i+3] = static_cast<float>(KAM()[i]);
+    }
+}
+
+// *********************************** protected methods ******************************
+
+template <int N, class Law>
+void MagnetTable::accelUnrolled( double x, double y, double &ax, double &ay ) const {
+    const double* mx  = m_data;
+    const double* my  = mx + m_stride;
+    const double* rz2 = my + m_stride;
+    const double* kam = rz2 + 2*m_stride;
+
+    double M1 = 0.0;
+    double M2 = 0.0;
+    for(int i=0; i<N; i++) {
+        double rx = x - mx[i];
+        double ry = y - my[i];
+        double numer = Law::Numer(rx*rx + ry*ry + rz2[i],m_kappa);
+        M1 += kam[i]*rx*numer;
+        M2 += kam[i]*ry*numer;
+    }
+    ax = M1;
+    ay = M2;
+}
+
+template <class Law>
+void MagnetTable::accelLoop( double x, double y, double &ax, double &ay ) const {
+    const double* mx  = m_data;
+    const double* my  = mx + m_stride;
+    const double* rz2 = my + m_stride;
+    const double* kam = rz2 + 2*m_stride;
+
+    double M1 = 0.0;
+    double M2 = 0.0;
+    for(int i=0; i<m_num; i++) {
+        double rx = x - mx[i];
+        double ry = y - my[i];
+        double numer = Law::Numer(rx*rx + ry*ry + rz2[i],m_kappa);
+        M1 += kam[i]*rx*numer;
+        M2 += kam[i]*ry*numer;
+    }
+    ax = M1;
+    ay = M2;
+}
+
+template <class Law>
+double MagnetTable::potential( double x, double y ) const {
+    const double* mx  = X();
+    const double* my  = Y();
+    const double* rz2 = RZ2();
+    const double* am  = AM();
+
+    double V = 0.5*m_g_l*(x*x + y*y);
+    for(int i=0; i<m_num; i++) {
+        double rx = x - mx[i];
+        double ry = y - my[i];
+        V -= am[i]*Law::Inverse(rx*rx + ry*ry + rz2[i],m_kappa);
+    }
+    return V;
+}
+
+void MagnetTable::accelGrid( double x, double y, double &ax, double &ay ) const {
+    if (m_grid.Inside(x,y)) {
+        m_grid.Accel(x,y,ax,ay);
+    } else {
+        (this->*m_exactAccel)(x,y,ax,ay);
+    }
+}
+
+double MagnetTable::potentialGrid( double x, double y ) const {
+    if (m_grid.Inside(x,y)) {
+        return 0.5*m_g_l*(x*x + y*y) + m_grid.Potential(x,y);
+    }
+    return (this->*m_exactPotential)(x,y);
+}
+
+void MagnetTable::accelTree( double x, double y, double &ax, double &ay ) const {
+    double P[3] = { x, y, m_zBob };
+    double F[3];
+    m_tree.Field(P,F);
+    ax = F[0];
+    ay = F[1];
+}
+
+double MagnetTable::potentialTree( double x, double y ) const {
+    double P[3] = { x, y, m_zBob };
+    return 0.5*m_g_l*(x*x + y*y) + m_tree.Potential(P);
+}
+
+void MagnetTable::allocate( int num ) {
+    int stride = (num + MAGNET_TABLE_ALIGN-1)/MAGNET_TABLE_ALIGN*MAGNET_TABLE_ALIGN;
+    if (stride!=m_stride || m_buffer==NULL) {
+        delete [] m_buffer;
+        m_buffer = new double[stride*MAGNET_TABLE_ARRAYS + MAGNET_TABLE_ALIGN];
+        uintptr_t addr = reinterpret_cast<uintptr_t>(m_buffer);
+        uintptr_t mask = sizeof(double)*MAGNET_TABLE_ALIGN - 1;
+        m_data = reinterpret_cast<double*>((addr + mask) & ~mask);
+        m_stride = stride;
+    }
+    m_num = num;
+    memset(m_data,0,sizeof(double)*m_stride*MAGNET_TABLE_ARRAYS);
+}
+
+void MagnetTable::selectAccel() {
+    switch (m_law) {
+        default:
+        case FORCE_KAPPA1:
+            selectAccelFor<ForceKappa1>();
+            break;
+        case FORCE_KAPPA2:
+            selectAccelFor<ForceKappa2>();
+            break;
+        case FORCE_GENERIC:
+            selectAccelFor<ForceGeneric>();
+            break;
+    }
+    m_accel = m_exactAccel;
+    m_potential = m_exactPotential;
+    if (m_grid.IsValid()) {
+        m_accel = &MagnetTable::accelGrid;
+        m_potential = &MagnetTable::potentialGrid;
+    } else if (m_tree.IsValid()) {
+        m_accel = &MagnetTable::accelTree;
+        m_potential = &MagnetTable::potentialTree;
+    }
+}
+
+template <class Law>
+void MagnetTable::selectAccelFor() {
+    m_exactPotential = &MagnetTable::potential<Law>;
+    switch (m_num) {
+        default:
+            m_exactAccel = &MagnetTable::accelLoop<Law>;
+            break;
+        case 3:
+            m_exactAccel = &MagnetTable::accelUnrolled<3,Law>;
+            break;
+        case 4:
+            m_exactAccel = &MagnetTable::accelUnrolled<4,Law>;
+            break;
+        case 5:
+            m_exactAccel = &MagnetTable::accelUnrolled<5,Law>;
+            break;
+        case 6:
+            m_exactAccel = &MagnetTable::accelUnrolled<6,Law>;
+            break;
+        case 7:
+            m_exactAccel = &MagnetTable::accelUnrolled<7,Law>;
+            break;
+        case 8:
+            m_exactAccel = &MagnetTable::accelUnrolled<8,Law>;
+            break;
+    }
+}
@@ -0,0 +1,155 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the structure-of-arrays magnet table.
+    @file MagnetTable.h
+*/
+
+#ifndef MPSIM_MAGNET_TABLE_H
+#define MPSIM_MAGNET_TABLE_H
+
+#include "FieldGrid.h"
+#include "ForceLaw.h"
+#include "MagnetTree.h"
+#include "PendulumParams.h"
+
+/**
+ * @brief The MagnetTable class
+ *
+ *  Everything the Cartesian right-hand side needs, precomputed once per
+ *  parameter set: the magnets as 64-byte aligned arrays
+ *
+ *     x[], y[], rz2[] = (z0-l-z)^2 + a^2, am[] = alpha*magFactor, kam[] = kappa*am[],
+ *
+ *  and the scalar constants g/l, damping and kappa. 'a' is the magnet radius;
+ *  a>0 replaces the point magnets by finite-size (Plummer) magnets whose force
+ *  stays bounded even directly above the magnet.
+ *
+ *  The table is rebuilt by Build() only; all other methods are const. Build()
+ *  selects the force law from kappa (see ForceLaw.h) and, for 3 to 8 magnets, a
+ *  magnet loop that is unrolled at compile time.
+ *
+ *  Optionally, BuildFieldGrid() tabulates the magnet field (see FieldGrid);
+ *  MagnetAccel and Potential then interpolate inside the grid and fall back to
+ *  the exact sum outside of it. Build() removes the grid. For large magnet
+ *  arrays, BuildTree() replaces the exact sum by the Barnes-Hut approximation
+ *  of MagnetTree; the tree survives Build() and is only rebuilt if the magnets
+ *  changed.
+ */
+class MagnetTable
+{
+public:
+    MagnetTable();
+    MagnetTable( const MagnetTable &other );
+    MagnetTable& operator=( const MagnetTable &other );
+    ~MagnetTable();
+
+public:
+    void   Build( const PendulumParams &params );
+
+    /** Tabulate the field with params.m_fieldGrid nodes per axis over
+     *  [-2*rmax,2*rmax]^2, or remove the grid if m_fieldGrid is below 2.
+     */
+    void   BuildFieldGrid( const PendulumParams &params, int numThreads = 0 );
+    const FieldGrid& Grid() const;
+
+    /** Use the Barnes-Hut tree with opening angle params.m_treeTheta, or the
+     *  exact sum if m_treeTheta is not positive.
+     */
+    void   BuildTree( const PendulumParams &params );
+    const MagnetTree& Tree() const;
+
+    /** True if MagnetAccel and Potential evaluate the exact magnet sum.
+     */
+    bool   IsExact() const;
+
+    int    Size() const;
+    double G_L() const;       //!< gravity/pendulumLength
+    double Gamma() const;     //!< damping
+    double Kappa() const;
+    forceLaw Law() const;
+
+    const double* X() const;
+    const double* Y() const;
+    const double* RZ2() const;
+    const double* AM() const;
+    const double* KAM() const;
+
+    /** Magnetic part of the acceleration, sum_i kam_i*r_i^(-2-kappa)*(x-x_i,y-y_i).
+     */
+    void   MagnetAccel( double x, double y, double &ax, double &ay ) const {
+        (this->*m_accel)(x,y,ax,ay);
+    }
+
+    /** Magnetic part of the acceleration without the field grid.
+     */
+    void   ExactMagnetAccel( double x, double y, double &ax, double &ay ) const {
+        (this->*m_exactAccel)(x,y,ax,ay);
+    }
+
+    /** Cartesian equations of motion.
+     */
+    void   CalcRHS( const double *y, double *dydx ) const {
+        double ax, ay;
+        MagnetAccel(y[0],y[1],ax,ay);
+        dydx[0] = y[2];
+        dydx[1] = y[3];
+        dydx[2] = -m_gamma*y[2] - m_g_l*y[0] - ax;
+        dydx[3] = -m_gamma*y[3] - m_g_l*y[1] - ay;
+    }
+
+    /** Potential V(x,y), see Equilibria.
+     */
+    double Potential( double x, double y ) const {
+        return (this->*m_potential)(x,y);
+    }
+
+    /** Fill 'buf' with one vec4 (x,y,rz2,kam) per magnet for the compute shader.
+     */
+    void   FillGPUBuffer( float *buf ) const;
+
+protected:
+    typedef void (MagnetTable::*accelFunc)( double x, double y, double &ax, double &ay ) const;
+    typedef double (MagnetTable::*potentialFunc)( double x, double y ) const;
+
+    template <int N, class Law>
+    void   accelUnrolled( double x, double y, double &ax, double &ay ) const;
+    template <class Law>
+    void   accelLoop( double x, double y, double &ax, double &ay ) const;
+    template <class Law>
+    double potential( double x, double y ) const;
+    void   accelGrid( double x, double y, double &ax, double &ay ) const;
+    double potentialGrid( double x, double y ) const;
+    void   accelTree( double x, double y, double &ax, double &ay ) const;
+    double potentialTree( double x, double y ) const;
+
+    void   allocate( int num );
+    void   selectAccel();
+    template <class Law>
+    void   selectAccelFor();
+
+private:
+    int     m_num;
+    int     m_stride;      //!< array length rounded up to a cache line
+    double* m_buffer;      //!< raw allocation
+    double* m_data;        //!< aligned start of x[]
+
+    double  m_g_l;
+    double  m_gamma;
+    double  m_kappa;
+    double  m_zBob;        //!< height z0-l of the bob plane
+    forceLaw   m_law;
+    accelFunc  m_accel;
+    accelFunc  m_exactAccel;
+    potentialFunc  m_potential;
+    potentialFunc  m_exactPotential;
+    FieldGrid  m_grid;
+    MagnetTree m_tree;
+};
+
+#endif // MPSIM_MAGNET_TABLE_H
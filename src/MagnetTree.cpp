@@ -0,0 +1,376 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file MagnetTree.cpp
+*/
+
+#include "MagnetTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define DEF_MAX(x,y)  ((x)>(y)?(x):(y))
+#define DEF_MIN(x,y)  ((x)<(y)?(x):(y))
+
+#define MAGNET_TREE_MAX_DEPTH  32
+
+
+MagnetTree::MagnetTree() :
+    m_leafSize(8),
+    m_theta2(0.25),
+    m_kappa(1.0),
+    m_a2(0.0),
+    m_law(FORCE_KAPPA1),
+    m_field(&MagnetTree::field<ForceKappa1>),
+    m_potential(&MagnetTree::potential<ForceKappa1>)
+{
+}
+
+MagnetTree::~MagnetTree() {
+}
+
+bool MagnetTree::Update( const PendulumParams &params, int leafSize ) {
+    m_kappa = params.m_kappa;
+    m_a2 = params.m_magnetRadius*params.m_magnetRadius;
+    m_law = ForceLawFromKappa(m_kappa);
+    selectLaw();
+
+    leafSize = DEF_MAX(leafSize,1);
+    if (leafSize==m_leafSize && Matches(params)) {
+        return false;
+    }
+    m_leafSize = leafSize;
+
+    int num = static_cast<int>(params.m_magnets.size());
+    m_source.resize(1 + 4*num);
+    m_source[0] = params.m_magFactor;
+    m_mx.resize(num);
+    m_my.resize(num);
+    m_mz.resize(num);
+    m_am.resize(num);
+    m_order.resize(num);
+    for(int i=0; i<num; i++) {
+        const magnetParams &mp = params.m_magnets[i];
+        m_source[1+4*i+0] = mp.x;
+        m_source[1+4*i+1] = mp.y;
+        m_source[1+4*i+2] = mp.z;
+        m_source[1+4*i+3] = mp.alpha;
+        m_mx[i] = mp.x;
+        m_my[i] = mp.y;
+        m_mz[i] = mp.z;
+        m_am[i] = mp.alpha*params.m_magFactor;
+        m_order[i] = i;
+    }
+
+    m_nodes.clear();
+    if (num>0) {
+        double xmin = *std::min_element(m_mx.begin(),m_mx.end());
+        double xmax = *std::max_element(m_mx.begin(),m_mx.end());
+        double ymin = *std::min_element(m_my.begin(),m_my.end());
+        double ymax = *std::max_element(m_my.begin(),m_my.end());
+        build(0,num,xmin,ymin,DEF_MAX(xmax-xmin,ymax-ymin),0);
+    }
+
+    // magnets in tree order
+    std::vector<double> tmp(num);
+    std::vector<double>* arrays[4] = { &m_mx, &m_my, &m_mz, &m_am };
+    for(int k=0; k<4; k++) {
+        for(int i=0; i<num; i++) {
+            tmp[i] = (*arrays[k])[m_order[i]];
+        }
+        arrays[k]->swap(tmp);
+    }
+    return true;
+}
+
+bool MagnetTree::Matches( const PendulumParams &params ) const {
+    unsigned int num = params.m_magnets.size();
+    if (m_source.size()!=1+4*num || m_source[0]!=params.m_magFactor) {
+        return false;
+    }
+    for(unsigned int i=0; i<num; i++) {
+        const magnetParams &mp = params.m_magnets[i];
+        if (m_source[1+4*i+0]!=mp.x || m_source[1+4*i+1]!=mp.y ||
+            m_source[1+4*i+2]!=mp.z || m_source[1+4*i+3]!=mp.alpha) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MagnetTree::Clear() {
+    m_source.clear();
+    m_mx.clear();
+    m_my.clear();
+    m_mz.clear();
+    m_am.clear();
+    m_order.clear();
+    m_nodes.clear();
+}
+
+bool MagnetTree::IsValid() const {
+    return !m_nodes.empty();
+}
+
+void MagnetTree::SetOpeningAngle( double theta ) {
+    m_theta2 = theta*theta;
+}
+
+double MagnetTree::OpeningAngle() const {
+    return sqrt(m_theta2);
+}
+
+int MagnetTree::NumNodes() const {
+    return static_cast<int>(m_nodes.size());
+}
+
+int MagnetTree::Size() const {
+    return static_cast<int>(m_am.size());
+}
+
+void MagnetTree::FillGPUBuffers( float *nodes, float *magnets ) const {
+    for(unsigned int i=0; i<m_nodes.size(); i++) {
+        const magnetNode &node = m_nodes[i];
+        float* n = nodes + 20*i;
+        n[0]  = static_cast<float>(node.cx);
+        n[1]  = static_cast<float>(node.cy);
+        n[2]  = static_cast<float>(node.cz);
+        n[3]  = static_cast<float>(node.radius2);
+        n[4]  = static_cast<float>(node.am);
+        n[5]  = static_cast<float>(node.dx);
+        n[6]  = static_cast<float>(node.dy);
+        n[7]  = static_cast<float>(node.dz);
+        n[8]  = static_cast<float>(node.qxx);
+        n[9]  = static_cast<float>(node.qyy);
+        n[10] = static_cast<float>(node.qzz);
+        n[11] = static_cast<float>(node.qxy);
+        n[12] = static_cast<float>(node.qxz);
+        n[13] = static_cast<float>(node.qyz);
+        n[14] = 0.0f;
+        n[15] = 0.0f;
+        n[16] = static_cast<float>(node.skip);
+        n[17] = static_cast<float>(node.first);
+        n[18] = static_cast<float>(node.num);
+        n[19] = static_cast<float>(node.depth);
+    }
+    for(unsigned int i=0; i<m_am.size(); i++) {
+        magnets[4*i+0] = static_cast<float>(m_mx[i]);
+        magnets[4*i+1] = static_cast<float>(m_my[i]);
+        magnets[4*i+2] = static_cast<float>(m_mz[i]);
+        magnets[4*i+3] = static_cast<float>(m_am[i]);
+    }
+}
+
+// *********************************** protected methods ******************************
+
+/**
+ *  Stackless traversal along the depth-first order. A node adds its expansion
+ *  with weight b (see blend) and passes the weight 1-b on to its children or,
+ *  for a leaf, to its magnets; weight[k] is the weight of the current node at
+ *  depth k. Nodes with b=1 are skipped with all their descendants.
+ */
+template <class Law>
+void MagnetTree::field( const double *P, double *F ) const {
+    double weight[MAGNET_TREE_MAX_DEPTH+2];
+    weight[0] = 1.0;
+
+    double Fx = 0.0, Fy = 0.0, Fz = 0.0;
+    int numNodes = static_cast<int>(m_nodes.size());
+    int i = 0;
+    while (i<numNodes) {
+        const magnetNode &node = m_nodes[i];
+        double W = weight[node.depth];
+        double dx = P[0] - node.cx;
+        double dy = P[1] - node.cy;
+        double dz = P[2] - node.cz;
+        double d2 = dx*dx + dy*dy + dz*dz;
+        double b = blend(node.radius2,d2);
+        if (b>0.0) {
+            double u = d2 + m_a2;
+            double numer = W*b*Law::Numer(u,m_kappa);
+            double Qx = node.qxx*dx + node.qxy*dy + node.qxz*dz;
+            double Qy = node.qxy*dx + node.qyy*dy + node.qyz*dz;
+            double Qz = node.qxz*dx + node.qyz*dy + node.qzz*dz;
+            double dQd = dx*Qx + dy*Qy + dz*Qz;
+            double trQ = node.qxx + node.qyy + node.qzz;
+            double s = (m_kappa+2.0)/u;
+            double t = s*((dx*node.dx + dy*node.dy + dz*node.dz) + 0.5*(m_kappa+4.0)*dQd/u - 0.5*trQ);
+            Fx += numer*((node.am + t)*dx - node.dx - s*Qx);
+            Fy += numer*((node.am + t)*dy - node.dy - s*Qy);
+            Fz += numer*((node.am + t)*dz - node.dz - s*Qz);
+        }
+        if (b>=1.0) {
+            i = node.skip;
+        }
+        else if (node.num>0) {
+            W *= 1.0-b;
+            for(int j=node.first; j<node.first+node.num; j++) {
+                double rx = P[0] - m_mx[j];
+                double ry = P[1] - m_my[j];
+                double rz = P[2] - m_mz[j];
+                double f = W*m_am[j]*Law::Numer(rx*rx + ry*ry + rz*rz + m_a2,m_kappa);
+                Fx += f*rx;
+                Fy += f*ry;
+                Fz += f*rz;
+            }
+            i = node.skip;
+        }
+        else {
+            weight[node.depth+1] = W*(1.0-b);
+            i++;
+        }
+    }
+    F[0] = m_kappa*Fx;
+    F[1] = m_kappa*Fy;
+    F[2] = m_kappa*Fz;
+}
+
+template <class Law>
+double MagnetTree::potential( const double *P ) const {
+    double weight[MAGNET_TREE_MAX_DEPTH+2];
+    weight[0] = 1.0;
+
+    double U = 0.0;
+    int numNodes = static_cast<int>(m_nodes.size());
+    int i = 0;
+    while (i<numNodes) {
+        const magnetNode &node = m_nodes[i];
+        double W = weight[node.depth];
+        double dx = P[0] - node.cx;
+        double dy = P[1] - node.cy;
+        double dz = P[2] - node.cz;
+        double d2 = dx*dx + dy*dy + dz*dz;
+        double b = blend(node.radius2,d2);
+        if (b>0.0) {
+            double u = d2 + m_a2;
+            double dQd = dx*(node.qxx*dx + node.qxy*dy + node.qxz*dz)
+                       + dy*(node.qxy*dx + node.qyy*dy + node.qyz*dz)
+                       + dz*(node.qxz*dx + node.qyz*dy + node.qzz*dz);
+            double trQ = node.qxx + node.qyy + node.qzz;
+            double dD = dx*node.dx + dy*node.dy + dz*node.dz;
+            U -= W*b*Law::Inverse(u,m_kappa)*(node.am + m_kappa/u*(dD - 0.5*trQ + 0.5*(m_kappa+2.0)*dQd/u));
+        }
+        if (b>=1.0) {
+            i = node.skip;
+        }
+        else if (node.num>0) {
+            W *= 1.0-b;
+            for(int j=node.first; j<node.first+node.num; j++) {
+                double rx = P[0] - m_mx[j];
+                double ry = P[1] - m_my[j];
+                double rz = P[2] - m_mz[j];
+                U -= W*m_am[j]*Law::Inverse(rx*rx + ry*ry + rz*rz + m_a2,m_kappa);
+            }
+            i = node.skip;
+        }
+        else {
+            weight[node.depth+1] = W*(1.0-b);
+            i++;
+        }
+    }
+    return U;
+}
+
+void MagnetTree::selectLaw() {
+    switch (m_law) {
+        default:
+        case FORCE_KAPPA1:
+            m_field = &MagnetTree::field<ForceKappa1>;
+            m_potential = &MagnetTree::potential<ForceKappa1>;
+            break;
+        case FORCE_KAPPA2:
+            m_field = &MagnetTree::field<ForceKappa2>;
+            m_potential = &MagnetTree::potential<ForceKappa2>;
+            break;
+        case FORCE_GENERIC:
+            m_field = &MagnetTree::field<ForceGeneric>;
+            m_potential = &MagnetTree::potential<ForceGeneric>;
+            break;
+    }
+}
+
+/**
+ *  Node for the magnets m_order[first..first+num-1] inside the square with lower
+ *  left corner (x0,y0). Inner nodes split the square into quadrants; magnets at
+ *  the same position end up in a leaf at the maximum depth.
+ */
+void MagnetTree::build( int first, int num, double x0, double y0, double size, int depth ) {
+    int idx = static_cast<int>(m_nodes.size());
+    m_nodes.push_back(magnetNode());
+    setMoments(m_nodes[idx],first,num);
+    m_nodes[idx].first = first;
+    m_nodes[idx].num = num;
+    m_nodes[idx].depth = depth;
+
+    if (num>m_leafSize && depth<MAGNET_TREE_MAX_DEPTH) {
+        m_nodes[idx].num = 0;
+
+        double half = 0.5*size;
+        std::vector<int>::iterator begin = m_order.begin() + first;
+        std::vector<int>::iterator end = begin + num;
+        std::vector<int>::iterator ymid = std::partition(begin,end,[this,y0,half](int m) { return m_my[m] < y0+half; });
+        std::vector<int>::iterator xmid0 = std::partition(begin,ymid,[this,x0,half](int m) { return m_mx[m] < x0+half; });
+        std::vector<int>::iterator xmid1 = std::partition(ymid,end,[this,x0,half](int m) { return m_mx[m] < x0+half; });
+
+        std::vector<int>::iterator bounds[5] = { begin, xmid0, ymid, xmid1, end };
+        for(int q=0; q<4; q++) {
+            int cfirst = static_cast<int>(bounds[q] - m_order.begin());
+            int cnum = static_cast<int>(bounds[q+1] - bounds[q]);
+            if (cnum>0) {
+                build(cfirst,cnum,x0 + (q&1)*half,y0 + (q>>1)*half,half,depth+1);
+            }
+        }
+    }
+    m_nodes[idx].skip = static_cast<int>(m_nodes.size());
+}
+
+void MagnetTree::setMoments( magnetNode &node, int first, int num ) const {
+    double w = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+    for(int k=first; k<first+num; k++) {
+        int m = m_order[k];
+        double wm = fabs(m_am[m]);
+        w  += wm;
+        cx += wm*m_mx[m];
+        cy += wm*m_my[m];
+        cz += wm*m_mz[m];
+    }
+    if (w>0.0) {
+        cx /= w;
+        cy /= w;
+        cz /= w;
+    } else {
+        int m = m_order[first];
+        cx = m_mx[m];
+        cy = m_my[m];
+        cz = m_mz[m];
+    }
+
+    node.cx = cx;
+    node.cy = cy;
+    node.cz = cz;
+    node.radius2 = 0.0;
+    node.am = node.dx = node.dy = node.dz = 0.0;
+    node.qxx = node.qyy = node.qzz = node.qxy = node.qxz = node.qyz = 0.0;
+    for(int k=first; k<first+num; k++) {
+        int m = m_order[k];
+        double sx = m_mx[m] - cx;
+        double sy = m_my[m] - cy;
+        double sz = m_mz[m] - cz;
+        node.radius2 = DEF_MAX(node.radius2,sx*sx + sy*sy + sz*sz);
+        node.am += m_am[m];
+        node.dx += m_am[m]*sx;
+        node.dy += m_am[m]*sy;
+        node.dz += m_am[m]*sz;
+        node.qxx += m_am[m]*sx*sx;
+        node.qyy += m_am[m]*sy*sy;
+        node.qzz += m_am[m]*sz*sz;
+        node.qxy += m_am[m]*sx*sy;
+        node.qxz += m_am[m]*sx*sz;
+        node.qyz += m_am[m]*sy*sz;
+    }
+}
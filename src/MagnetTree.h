@@ -0,0 +1,157 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the Barnes-Hut tree of the magnets.
+    @file MagnetTree.h
+*/
+
+#ifndef MPSIM_MAGNET_TREE_H
+#define MPSIM_MAGNET_TREE_H
+
+#include <vector>
+
+#include "ForceLaw.h"
+#include "PendulumParams.h"
+
+/**
+ *  Node of the magnet tree. Nodes are stored in depth-first order: the first
+ *  child of a node follows it directly, and 'skip' is the index of the next
+ *  node that is not a descendant. Leaves hold the magnets first..first+num-1
+ *  of the reordered magnet arrays.
+ */
+typedef struct magnetNode_t {
+    double  cx, cy, cz;    //!< center: |am|-weighted centroid of the magnets
+    double  radius2;       //!< squared distance of the farthest magnet from the center
+    double  am;            //!< monopole, sum am_i
+    double  dx, dy, dz;    //!< dipole, sum am_i*(m_i - c)
+    double  qxx, qyy, qzz, qxy, qxz, qyz;   //!< second moments, sum am_i*(m_i - c)(m_i - c)^T
+    int     skip;
+    int     first;
+    int     num;           //!< number of magnets of a leaf, 0 for inner nodes
+    int     depth;
+} magnetNode;
+
+
+/**
+ * @brief The MagnetTree class
+ *
+ *  Barnes-Hut quadtree over the magnet positions (x,y). The field of a magnet
+ *  at m_i on the bob at P is
+ *
+ *     F_i = kappa*am_i*(P - m_i)*(|P - m_i|^2 + a^2)^(-1-kappa/2),
+ *
+ *  with the magnet radius a (see MagnetTable). For a node that is seen under an
+ *  angle below theta/2, i.e. radius < theta/2*|P - c|, the field of all its
+ *  magnets is replaced by the expansion around c up to the quadrupole. With
+ *  d = P - c, u = |d|^2 + a^2, the moments A, D, Q of magnetNode, and
+ *  t = (kappa+2)/u*( d.D + (kappa+4)/2*(d.Qd)/u - tr(Q)/2 ),
+ *
+ *     F = kappa*u^(-1-kappa/2) * ( (A + t)*d - D - (kappa+2)/u*Qd ),
+ *     U = -u^(-kappa/2) * ( A + kappa/u*( d.D - tr(Q)/2 + (kappa+2)/2*(d.Qd)/u ) ).
+ *
+ *  The monopole alone is not good enough: in a dense magnet array the far field
+ *  sums up to a large, almost constant potential, and the shallow minima between
+ *  the magnets are only a small ripple on top of it.
+ *
+ *  Between theta/2 and theta the expansion is blended smoothly with the sum
+ *  over the children. A hard switch would make the field discontinuous, and the
+ *  adaptive integrators would crawl along every switching surface.
+ *
+ *  The error is of third order in theta. P is three-dimensional, so the tree
+ *  serves the Cartesian model (P = (x,y,z0-l)) as well as the spherical one.
+ *
+ *  Update() rebuilds the tree only if the magnets changed; all other parameters
+ *  only enter the evaluation.
+ */
+class MagnetTree
+{
+public:
+    MagnetTree();
+    ~MagnetTree();
+
+public:
+    /** Rebuild the tree if the magnets of 'params' differ from the current ones.
+     * @param params    Pendulum parameters.
+     * @param leafSize  Maximum number of magnets per leaf.
+     * @return true if the tree was rebuilt.
+     */
+    bool   Update( const PendulumParams &params, int leafSize = 8 );
+
+    /** True if the tree was built from the magnets of 'params'.
+     */
+    bool   Matches( const PendulumParams &params ) const;
+
+    void   Clear();
+    bool   IsValid() const;
+
+    void   SetOpeningAngle( double theta );
+    double OpeningAngle() const;
+
+    int    NumNodes() const;
+    int    Size() const;
+
+    /** Field sum_i F_i on the bob at P=(x,y,z).
+     */
+    void   Field( const double *P, double *F ) const {
+        (this->*m_field)(P,F);
+    }
+
+    /** Magnet part of the potential, -sum_i am_i*(|P - m_i|^2 + a^2)^(-kappa/2).
+     */
+    double Potential( const double *P ) const {
+        return (this->*m_potential)(P);
+    }
+
+    /** Fill 'nodes' with five vec4 per node (cx,cy,cz,radius2), (am,dx,dy,dz),
+     *  (qxx,qyy,qzz,qxy), (qxz,qyz,0,0), (skip,first,num,depth) and 'magnets' with
+     *  one vec4 (x,y,z,am) per magnet in tree order for the compute shader.
+     */
+    void   FillGPUBuffers( float *nodes, float *magnets ) const;
+
+protected:
+    typedef void (MagnetTree::*fieldFunc)( const double *P, double *F ) const;
+    typedef double (MagnetTree::*potentialFunc)( const double *P ) const;
+
+    template <class Law>
+    void   field( const double *P, double *F ) const;
+    template <class Law>
+    double potential( const double *P ) const;
+
+    /** Weight of the expansion of a node: 1 below theta/2, 0 above theta.
+     */
+    double blend( double radius2, double d2 ) const {
+        if (radius2 <= 0.25*m_theta2*d2) {
+            return 1.0;
+        }
+        if (radius2 >= m_theta2*d2) {
+            return 0.0;
+        }
+        double t = (m_theta2*d2 - radius2)/(0.75*m_theta2*d2);
+        return t*t*t*(t*(6.0*t - 15.0) + 10.0);
+    }
+
+    void   selectLaw();
+    void   build( int first, int num, double x0, double y0, double size, int depth );
+    void   setMoments( magnetNode &node, int first, int num ) const;
+
+private:
+    int     m_leafSize;
+    double  m_theta2;      //!< squared opening angle
+    double  m_kappa;
+    double  m_a2;          //!< squared magnet radius
+    forceLaw  m_law;
+    fieldFunc      m_field;
+    potentialFunc  m_potential;
+
+    std::vector<double>  m_source;   //!< magFactor, then x,y,z,alpha per magnet of the last Update()
+    std::vector<double>  m_mx, m_my, m_mz, m_am;   //!< magnets in tree order
+    std::vector<int>     m_order;    //!< tree order -> original index
+    std::vector<magnetNode>  m_nodes;
+};
+
+#endif // MPSIM_MAGNET_TREE_H
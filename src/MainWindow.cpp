@@ -81,14 +81,20 @@ void MainWindow::saveParams() {
 }
 
 void MainWindow::particleStep() {
-    mOpenGL2d->particleStep();
-    lcd_numSteps->display( mSysData->m_numSteps );
+    // the particle thread integrates; the timer only presents its progress
+    lcd_numSteps->display( mOpenGL2d->NumSteps() );
+    lcd_numActive->display( mOpenGL2d->NumActiveParticles() );
+    displayTimeLeft();
+    if (mOpenGL2d->NumActiveParticles()==0) {
+        mSysView->SetTimer(false);
+    }
 }
 
 void MainWindow::particleReset() {
     mOpenGL2d->ResetParticleSimulation();
-    mSysData->m_numSteps = 0;
-    lcd_numSteps->display( mSysData->m_numSteps );
+    lcd_numSteps->display( mOpenGL2d->NumSteps() );
+    lcd_numActive->display( mOpenGL2d->NumActiveParticles() );
+    displayTimeLeft();
 }
 
 void MainWindow::selectTab() {
@@ -188,7 +194,7 @@ void MainWindow::initElements() {
     mOpenGL3d = new OpenGL3d(format,mSysData,this);
 
     mSysData->m_timer = new QTimer();
-    mSysData->m_timer->setInterval(1);
+    mSysData->m_timer->setInterval(16);
     connect( mSysData->m_timer, SIGNAL(timeout()), this, SLOT(particleStep()) );
 
     mSysData->m_animateTimer = new QTimer();
@@ -203,9 +209,27 @@ void MainWindow::initElements() {
     lcd_numSteps->display(0);
     lcd_numSteps->setSegmentStyle(QLCDNumber::Flat);
 
+    lab_numActive = new QLabel("# active:");
+    lcd_numActive = new QLCDNumber();
+    lcd_numActive->setEnabled(false);
+    lcd_numActive->setDigitCount(8);
+    lcd_numActive->display(0);
+    lcd_numActive->setSegmentStyle(QLCDNumber::Flat);
+
+    lab_timeLeft = new QLabel("time left [s]:");
+    lcd_timeLeft = new QLCDNumber();
+    lcd_timeLeft->setEnabled(false);
+    lcd_timeLeft->setDigitCount(6);
+    lcd_timeLeft->display("-");
+    lcd_timeLeft->setSegmentStyle(QLCDNumber::Flat);
+
     mStatusBar = new QStatusBar(this);
     mStatusBar->addPermanentWidget(lab_numSteps);
     mStatusBar->addPermanentWidget(lcd_numSteps);
+    mStatusBar->addPermanentWidget(lab_numActive);
+    mStatusBar->addPermanentWidget(lcd_numActive);
+    mStatusBar->addPermanentWidget(lab_timeLeft);
+    mStatusBar->addPermanentWidget(lcd_timeLeft);
 }
 
 
@@ -215,7 +239,8 @@ void MainWindow::initConnects() {
     connect( mOpenGL2d, SIGNAL(magnetMoved(int)), mSysView, SLOT(UpdateMagnet(int)) );
     connect( mOpenGL3d, SIGNAL(magnetMoved(int)), mSysView, SLOT(UpdateMagnet(int)) );
     connect( mSysData,  SIGNAL(dataRead()), mSysView, SLOT(SetAllParams()) );    
-    connect( mOpenGL3d, SIGNAL(updateTraj()), mOpenGL2d, SLOT(UpdateTraj()) );
+    connect( mSysData,  SIGNAL(trajectoryChanged()), mOpenGL2d, SLOT(UpdateTraj()) );
+    connect( mSysData,  SIGNAL(trajectoryChanged()), mOpenGL3d, SLOT(updateGL()) );
 }
 
 
@@ -256,7 +281,6 @@ void MainWindow :: initActions() {
     mActionPlay = new QAction("Play",this);
     mActionReset = new QAction("Reset",this);
 
-#ifdef HAVE_COMP_SHADER
     mActionPlay->setShortcut(Qt::CTRL|Qt::Key_P);
     addAction( mActionPlay );
     connect  ( mActionPlay, SIGNAL(triggered()), this, SLOT(play()) );    
@@ -264,19 +288,14 @@ void MainWindow :: initActions() {
     mActionReset->setShortcut(Qt::CTRL|Qt::Key_R);
     addAction( mActionReset );
     connect  ( mActionReset, SIGNAL(triggered()), this, SLOT(particleReset()) );
-#endif // HAVE_COMP_SHADER
 
     mActionAnimate = new QAction("Animate",this);
     mActionAnimate->setShortcut(Qt::CTRL|Qt::Key_A);
     addAction( mActionAnimate );
     connect  ( mActionAnimate, SIGNAL(triggered()), this, SLOT(animate()) );
 
-#ifdef HAVE_COMP_SHADER
     mActionPlay->setEnabled(true);
     mActionAnimate->setEnabled(false);
-#else
-    mActionAnimate->setEnabled(true);
-#endif
 
     mActionShowParamsWin = new QAction("Show Param Win",this);
     mActionShowParamsWin->setShortcut(Qt::CTRL|Qt::Key_W);
@@ -309,6 +328,18 @@ void MainWindow::initScripting() {
 
 
 
+/**
+ *  Seconds until the basin map is finished, or a dash if there is no estimate.
+ */
+void MainWindow::displayTimeLeft() {
+    double left = mOpenGL2d->TimeLeft();
+    if (left<0.0) {
+        lcd_timeLeft->display("-");
+    } else {
+        lcd_timeLeft->display( QString::number(left,'f',0) );
+    }
+}
+
 void MainWindow::closeEvent( QCloseEvent * event ) {
     //fprintf(stderr,"CloseAll\n");
     QApplication::closeAllWindows();
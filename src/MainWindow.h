@@ -59,6 +59,7 @@ protected:
     void  initConnects();   //!< Connect signals and slots.
     void  initMenus();      //!< Initialize menu bars.
     void  initScripting();  //!< Initialize scripting.
+    void  displayTimeLeft();  //!< Show the estimated time of the basin map.
 
     virtual void closeEvent(QCloseEvent *event);
 
@@ -90,6 +91,10 @@ private:
     QLCDNumber*   lcd_status_numParticles;
     QLabel*       lab_numSteps;
     QLCDNumber*   lcd_numSteps;
+    QLabel*       lab_numActive;
+    QLCDNumber*   lcd_numActive;
+    QLabel*       lab_timeLeft;
+    QLCDNumber*   lcd_timeLeft;
 
 
     // ---- File Menu ----
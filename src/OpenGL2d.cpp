@@ -10,14 +10,41 @@
 */
 
 #include "OpenGL2d.h"
+#include "ParticleThread.h"
 #include "glutils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
 #include <QCoreApplication>
 #include <QDir>
 #include <QKeyEvent>
 #include <QMouseEvent>
+#include <QWheelEvent>
 #include <QMessageBox>
 
+#define PARTICLE_RECORD_SIZE  32   //!< bytes per particle, see pendulum.comp
+
+#define STEPS_PER_DISPATCH_MAX  16
+#define STEPS_PER_FRAME_MAX     512
+
+#define PROGRESSIVE_STAGES  5   //!< see OpenGL2d::activateStage
+
+#define PREVIEW_PIXELS_MIN  768       //!< 32 x 24
+#define PREVIEW_PIXELS_MAX  196608    //!< 512 x 384
+#define PREVIEW_BUDGET      40.0      //!< time of a drag preview in ms
+#define PREVIEW_MAX_TIME    25.0      //!< integration time of a preview pixel
+#define PREVIEW_TOLERANCE   1e-6
+
+#define ZOOM_LEVEL_MIN  -2
+#define ZOOM_LEVEL_MAX  12      //!< the samples are placed in single precision
+
+#define DEF_MAX(x,y)  ((x)>(y)?(x):(y))
+#define DEF_MIN(x,y)  ((x)<(y)?(x):(y))
+
 /**
  * @brief DebugCallback
  * @param source
@@ -140,32 +167,85 @@ OpenGL2d :: OpenGL2d( QGLFormat format, SystemData* sd, QWidget* parent )
     mMagnetGeomShaderName = pathNameShaders + "magnet.geom";
     mMagnetFragShaderName = pathNameShaders + "magnet.frag";
 
-    mPendVertShaderName = pathNameShaders + "pendulum.vert";
-    mPendFragShaderName = pathNameShaders + "pendulum.frag";
     mPendCompShaderName = pathNameShaders + "pendulum.comp";
+    mPendIntLaw = -1;
+    mActiveListShaderName = pathNameShaders + "activelist.comp";
 
     vboLine = vaLine = 0;
-    posInit = posSSbo[0] = posSSbo[1] = 0;
-    rkStep = timeID = posMag = colMag = 0;
+    lineMap = NULL;
+    lineSlotSize = lineSlot = 0;
+    lineNumPoints = 0;
+    for(int i=0; i<LINE_NUM_SLOTS; i++) {
+        lineFence[i] = 0;
+    }
+    haveBufferStorage = false;
+    particles = posMag = palette = paletteTex = 0;
+    numParticles = particleWidth = particleHeight = 0;
+    supersample = 1;
+    simRmaxX = simRmaxY = 1.0;
+    zoomLevel = 0;
+    viewX = viewY = 0.0;
+    sampleSpacing = 1.0;
+    gridLattice = 0;
+    gridTileX = gridTileY = 0;
+    gridTilesX = gridTilesY = 0;
+    tileSamples = BASIN_TILE_PIXELS;
+    gridStored = false;
+    panning = false;
+    panViewX = panViewY = 0.0;
+    activeList[0] = activeList[1] = 0;
+    currActive = numActive = numSteps = 0;
+    nextStage = PROGRESSIVE_STAGES;
+    numPending = 0;
+    eqMinima = fieldGrid = 0;
+    treeNodes = treeMagnets = 0;
+    basinTex[0] = basinTex[1] = 0;
+    previewGrid.width = previewGrid.height = 0;
+    previewGrid.xmin = previewGrid.ymin = previewGrid.xmax = previewGrid.ymax = 0.0;
+    previewGrid.tileSize = BASIN_TILE_PIXELS;
+    previewTex[0] = previewTex[1] = 0;
+    previewPixels = 96*72;
+    draggingMagnet = previewShown = false;
 
     initColor = glm::vec3(0.2,0.2,0.2);
     hInit = 0.001f;
+    maxTime = 100.0f;
+    stepsPerDispatch = dispatchesPerFrame = 1;
+    frameBudget = 25.0;
     activeMagnet = -1;
+
+    mParticleThread = NULL;
+    haveCompute = false;
+    displayTex[0][0] = displayTex[0][1] = 0;
+    displayTex[1][0] = displayTex[1][1] = 0;
+    displayFence[0] = displayFence[1] = 0;
+    drawFence[0] = drawFence[1] = 0;
+    displayFront = displayDrawing = -1;
 }
 
 /**
  * @brief OpenGL2d::~OpenGL2d
  */
 OpenGL2d::~OpenGL2d() {
+    // the thread uses the shared objects below
+    if (mParticleThread!=NULL) {
+        delete mParticleThread;
+    }
+    mBasinService.Stop();
+    mPreviewService.Stop();
+
     mQuadShader.RemoveAllShaders();
     mLineShader.RemoveAllShaders();
     mMagnetShader.RemoveAllShaders();
-    mPendShader.RemoveAllShaders();
-#ifdef HAVE_COMP_SHADER    
     mPendIntShader.RemoveAllShaders();
-#endif // HAVE_COMP_SHADER
+    mActiveListShader.RemoveAllShaders();
 
     if (vaLine>0) {
+        for(int i=0; i<LINE_NUM_SLOTS; i++) {
+            if (lineFence[i]!=0) {
+                glDeleteSync(lineFence[i]);
+            }
+        }
         glDeleteBuffers(1,&vboLine);
         glDeleteVertexArrays(1,&vaLine);
     }
@@ -173,10 +253,6 @@ OpenGL2d::~OpenGL2d() {
         glDeleteBuffers(1,&vboQuad);
         glDeleteVertexArrays(1,&vaQuad);
     }
-    if (vaPoints>0) {
-        glDeleteBuffers(1,&vboPoints);
-        glDeleteVertexArrays(1,&vaPoints);
-    }
 }
 
 /**
@@ -214,26 +290,8 @@ void OpenGL2d::SetMaxNumPoints( int maxNumPoints ) {
     makeCurrent();
     if (maxNumPoints > 1) {
         mSysData->m_maxNumPoints = maxNumPoints;
+        reserveLine(maxNumPoints);
 
-        if (vaLine>0) {
-            glDeleteBuffers(1,&vboLine);
-            glDeleteVertexArrays(1,&vaLine);
-        }
-        glGenVertexArrays(1,&vaLine);
-        glGenBuffers(1,&vboLine);
-
-        glBindVertexArray(vaLine);
-        glBindBuffer(GL_ARRAY_BUFFER,vboLine);
-        glEnableVertexAttribArray(0);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float)*maxNumPoints*4,NULL,GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(0,4,GL_FLOAT,GL_FALSE,0,NULL);
-        glBindVertexArray(0);
-
-        if (mSysData->m_trajectory != NULL) {
-            delete [] mSysData->m_trajectory;
-            mSysData->m_trajTime.clear();
-        }
-        mSysData->m_trajectory = new float[4*maxNumPoints];
         mSysData->m_currIndex = 0;
         mSysData->m_currAnimPos = glm::vec2(0);
         mSysData->m_numPoints = 0;
@@ -241,16 +299,107 @@ void OpenGL2d::SetMaxNumPoints( int maxNumPoints ) {
 }
 
 void OpenGL2d::UpdateTraj() {
-    makeCurrent();
-    mSysData->UpdateTrajectory(&vboLine);
+    uploadLine();
     updateGL();
 }
 
+/**
+ *  Called in the GUI thread when the BasinService has finished tiles. Tiles
+ *  of superseded requests never get here, so they fit the display textures.
+ */
+void OpenGL2d::fetchTiles() {
+    std::vector<basinTileData> tiles;
+    if (!mBasinService.Fetch(tiles)) {
+        return;
+    }
+    makeCurrent();
+    for(unsigned int i=0; i<tiles.size(); i++) {
+        const basinTile &tile = tiles[i].tile;
+        uploadTile(displayTex[0],tiles[i]);
+
+        basinTileKey key = { gridLattice, zoomLevel, gridTileX + tile.x0/tileSamples, gridTileY + tile.y0/tileSamples };
+        mTileCache.Insert(key,tileSamples,&tiles[i].cls[0],&tiles[i].time[0],tile.x1 - tile.x0);
+    }
+    update();
+}
+
+/**
+ *  Called in the GUI thread when the preview service has finished tiles.
+ *  Once a preview is complete, the size of the next one is adapted to the
+ *  time it took, as the steps per frame of the compute shader.
+ */
+void OpenGL2d::fetchPreview() {
+    std::vector<basinTileData> tiles;
+    if (!mPreviewService.Fetch(tiles)) {
+        return;
+    }
+    makeCurrent();
+    for(unsigned int i=0; i<tiles.size(); i++) {
+        uploadTile(previewTex,tiles[i]);
+    }
+    if (mPreviewService.NumPixelsLeft()==0) {
+        double elapsed = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - previewStart).count();
+        double ratio = PREVIEW_BUDGET/DEF_MAX(elapsed,0.01);
+        ratio = DEF_MAX(0.5,DEF_MIN(ratio,2.0));
+        previewPixels = DEF_MAX(PREVIEW_PIXELS_MIN,DEF_MIN(previewPixels*ratio,PREVIEW_PIXELS_MAX));
+    }
+    update();
+}
+
 void  OpenGL2d::ResetParticleSimulation() {
     resetParticleStorage();
     updateGL();
 }
 
+bool OpenGL2d::HasComputeShader() const {
+    return haveCompute;
+}
+
+int OpenGL2d::NumActiveParticles() const {
+    if (!haveCompute) {
+        return static_cast<int>(mBasinService.NumPixelsLeft());
+    }
+    return numActive;
+}
+
+int OpenGL2d::NumSteps() const {
+    return numSteps;
+}
+
+/**
+ *  Only the CPU service has a cost model; the compute shader integrates all
+ *  samples in parallel and its end cannot be predicted from finished tiles.
+ */
+double OpenGL2d::TimeLeft() const {
+    if (!haveCompute) {
+        return mBasinService.TimeLeft();
+    }
+    return -1.0;
+}
+
+double OpenGL2d::MaxTime() const {
+    return maxTime;
+}
+
+void OpenGL2d::SetSimulationPlaying( bool play ) {
+    if (mParticleThread!=NULL) {
+        mParticleThread->SetPlaying(play);
+    }
+}
+
+bool OpenGL2d::IsSimulationPlaying() {
+    if (mParticleThread!=NULL) {
+        return mParticleThread->IsPlaying();
+    }
+    return false;
+}
+
+void OpenGL2d::StepSimulation() {
+    if (mParticleThread!=NULL) {
+        mParticleThread->RequestFrame();
+    }
+}
+
 /**
  * Create framebuffer object
  * @param width      Width of FBO.
@@ -316,44 +465,207 @@ void OpenGL2d::DeleteFBO() {
     }
 }
 
-void OpenGL2d::particleStep() {    
-    makeCurrent();
-#ifdef HAVE_COMP_SHADER    
-    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 0, posSSbo[currSbo] );
-    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 1, posSSbo[nextSbo] );
+bool OpenGL2d::IntegrateFrame() {
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 0, particles );
     glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 2, posMag );
-    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 3, colMag );
-    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 4, rkStep );
-    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 5, timeID );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 6, eqMinima );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 7, fieldGrid );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 8, treeNodes );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 9, treeMagnets );
+    glBindImageTexture( 0, basinTex[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16UI );
+    glBindImageTexture( 1, basinTex[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F );
 
     mPendIntShader.Bind();
+    glUniform1i( mPendIntShader.GetUniformLocation("stepsPerDispatch"), stepsPerDispatch );
+    mPendIntShader.Release();
+
+    // Chain the dispatches of one frame; the lists are compacted in between.
+    // Only the pixels of the active list are integrated, the work group count
+    // was set by the previous dispatch.
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int d=0; d<dispatchesPerFrame; d++) {
+        glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 10, activeList[currActive] );
+        glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 11, activeList[1-currActive] );
+
+        mPendIntShader.Bind();
+        glBindBuffer( GL_DISPATCH_INDIRECT_BUFFER, activeList[currActive] );
+        glDispatchComputeIndirect(0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        mActiveListShader.Bind();
+        glDispatchCompute(1,1,1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        currActive = 1 - currActive;
+    }
+    mActiveListShader.Release();
+    glBindBuffer( GL_DISPATCH_INDIRECT_BUFFER, 0 );
+
+    GLuint count = 0;
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, activeList[currActive] );
+    glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 3*sizeof(GLuint), sizeof(GLuint), &count );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+    // the next stages start while the last samples of the current one run
+    GLuint refill = static_cast<GLuint>(DEF_MAX(numParticles/128,256));
+    while (count<=refill && nextStage<PROGRESSIVE_STAGES) {
+        count = activateStage(count);
+    }
+    numActive = static_cast<int>(count + numPending);
+
+    // Reading the count waits for the GPU, so this is the cost of the frame's
+    // integration. A GL_TIME_ELAPSED query would not do: llvmpipe reports zero.
+    double elapsed = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count();
+    numSteps += stepsPerDispatch*dispatchesPerFrame;
+    adaptStepsPerFrame(elapsed);
+
+    publishFrame();
+    if (count==0) {
+        storeTiles();
+    }
+    return (count>0);
+}
+
+// *********************************** protected methods ******************************
+
+/**
+ *  Upload the simplified trajectory line into the next slot of the line ring.
+ *  The slot was drawn from two uploads ago, so its fence has normally passed
+ *  long since.
+ */
+void OpenGL2d::uploadLine() {
+    makeCurrent();
+    int num = mSysData->m_trajLine.NumPoints();
+    if (mSysData->m_numPoints==0) {
+        num = 0;
+    }
+    reserveLine(num);
+
+    int slot = (lineSlot + 1) % LINE_NUM_SLOTS;
+    if (lineFence[slot]!=0) {
+        while (glClientWaitSync(lineFence[slot],GL_SYNC_FLUSH_COMMANDS_BIT,1000000000)==GL_TIMEOUT_EXPIRED) {
+        }
+        glDeleteSync(lineFence[slot]);
+        lineFence[slot] = 0;
+    }
+
+    // only the vertices of the simplified line are uploaded
+    if (num>0) {
+        const PolylineSimplifier &line = mSysData->m_trajLine;
+        if (lineMap!=NULL) {
+            line.CopyPoints(lineMap + 2*slot*lineSlotSize);
+        } else {
+            GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+            glBindBuffer( GL_ARRAY_BUFFER, vboLine );
+            float* xy = static_cast<float*>(glMapBufferRange( GL_ARRAY_BUFFER, sizeof(float)*2*slot*lineSlotSize, sizeof(float)*2*num, access ));
+            line.CopyPoints(xy);
+            glUnmapBuffer( GL_ARRAY_BUFFER );
+            glBindBuffer( GL_ARRAY_BUFFER, 0 );
+        }
+    }
+    lineSlot = slot;
+    lineNumPoints = num;
+}
+
+/**
+ *  The uniforms are part of the shared program object, so the particle thread
+ *  sees them without access to SystemData, which the GUI may change meanwhile.
+ */
+void OpenGL2d::setIntegrationUniforms() {
+    mPendIntShader.Bind();
 
 #ifdef USE_SPHERICAL
     glUniform1i( mPendIntShader.GetUniformLocation("useSpherical"),1);
 #else
     glUniform1i( mPendIntShader.GetUniformLocation("useSpherical"),0);
 #endif
-    glUniform1i( mPendIntShader.GetUniformLocation("numParticles"), numParticles );
-    glUniform1i( mPendIntShader.GetUniformLocation("numMagnets"), mSysData->m_magnets.size() );
+    glUniform1i( mPendIntShader.GetUniformLocation("numMagnets"), mSysData->m_magnetTable.Size() );
+    glUniform1i( mPendIntShader.GetUniformLocation("imageWidth"), particleWidth );
+    glUniform1i( mPendIntShader.GetUniformLocation("imageHeight"), particleHeight );
+    glUniform2f( mPendIntShader.GetUniformLocation("origin"), static_cast<float>(gridTileX*tileSamples*sampleSpacing),
+                 static_cast<float>(gridTileY*tileSamples*sampleSpacing) );
+    glUniform1f( mPendIntShader.GetUniformLocation("spacing"), static_cast<float>(sampleSpacing) );
+    glUniform1f( mPendIntShader.GetUniformLocation("hInit"), hInit );
+    glUniform1f( mPendIntShader.GetUniformLocation("maxTime"), maxTime );
     glUniform1f( mPendIntShader.GetUniformLocation("pendulumLength"), static_cast<float>(mSysData->m_pendulumLength) );
     glUniform1f( mPendIntShader.GetUniformLocation("pendulumHeight"), static_cast<float>(mSysData->m_pendulumHeight) );
     glUniform1f( mPendIntShader.GetUniformLocation("gravity"), static_cast<float>(mSysData->m_gravity) );
     glUniform1f( mPendIntShader.GetUniformLocation("kappa"), static_cast<float>(mSysData->m_kappa) );
     glUniform1f( mPendIntShader.GetUniformLocation("gamma"), static_cast<float>(mSysData->m_damping) );
-    glUniform1f( mPendIntShader.GetUniformLocation("magFactor"), static_cast<float>(mSysData->m_magFactor) );
-    glDispatchCompute(numParticles/128 + 1,1,1);
 
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    const Equilibria &eq = mSysData->m_equilibria;
+    glUniform1i( mPendIntShader.GetUniformLocation("numMinima"), static_cast<int>(eq.Minima().size()) );
+    glUniform1f( mPendIntShader.GetUniformLocation("trapEnergy"), static_cast<float>(std::max(std::min(eq.TrapEnergy(),1e30),-1e30)) );
+    glUniform1f( mPendIntShader.GetUniformLocation("eqStepMax"), static_cast<float>(eq.StepMax()) );
+
+    const FieldGrid &grid = mSysData->m_magnetTable.Grid();
+    glUniform1i( mPendIntShader.GetUniformLocation("gridNodes"), grid.NumNodes() );
+    glUniform1f( mPendIntShader.GetUniformLocation("gridExtent"), static_cast<float>(grid.Extent()) );
+    glUniform1f( mPendIntShader.GetUniformLocation("gridSpacing"), static_cast<float>(grid.Spacing()) );
+
+    const MagnetTree &tree = mSysData->m_magnetTable.Tree();
+    double theta = tree.OpeningAngle();
+    glUniform1i( mPendIntShader.GetUniformLocation("treeNodes"), tree.NumNodes() );
+    glUniform1f( mPendIntShader.GetUniformLocation("treeTheta2"), static_cast<float>(theta*theta) );
+    glUniform1f( mPendIntShader.GetUniformLocation("magnetRadius2"), static_cast<float>(mSysData->m_magnetRadius*mSysData->m_magnetRadius) );
     mPendIntShader.Release();
-    std::swap(currSbo,nextSbo);
+}
 
-    mSysData->m_numSteps++;
-#endif // HAVE_COMP_SHADER    
-    updateGL();
+/**
+ *  Copy the basin map into the display textures that paintGL is not using.
+ *  The previous draw from them has to be finished on the GPU, and the copy
+ *  is fenced for the next draw. Only the GPU waits for the
+ *  fences; the CPU only waits if paintGL is issuing a draw from the buffer.
+ */
+void OpenGL2d::publishFrame() {
+    displayMutex.lock();
+    int back = (displayFront==0 ? 1 : 0);
+    while (displayDrawing==back) {
+        displayDone.wait(&displayMutex);
+    }
+    GLsync drawn = drawFence[back];
+    drawFence[back] = 0;
+    displayMutex.unlock();
+
+    if (drawn!=0) {
+        glWaitSync(drawn,0,GL_TIMEOUT_IGNORED);
+        glDeleteSync(drawn);
+    }
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    for(int k=0; k<2; k++) {
+        glCopyImageSubData( basinTex[k], GL_TEXTURE_2D, 0, 0, 0, 0,
+                            displayTex[back][k], GL_TEXTURE_2D, 0, 0, 0, 0,
+                            particleWidth, particleHeight, 1 );
+    }
+    GLsync copied = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+    glFlush();
+
+    displayMutex.lock();
+    if (displayFence[back]!=0) {
+        glDeleteSync(displayFence[back]);
+    }
+    displayFence[back] = copied;
+    displayFront = back;
+    displayMutex.unlock();
 }
 
+/**
+ *  Steps per frame such that the integration takes about 'frameBudget' ms. The
+ *  change per frame is limited, as the cost per step varies with the number of
+ *  active pixels. Up to STEPS_PER_DISPATCH_MAX steps are done in
+ *  one dispatch; more are split into chained dispatches, so that the lists are
+ *  compacted in between and no single dispatch runs into the driver's timeout.
+ */
+void OpenGL2d::adaptStepsPerFrame( double elapsed ) {
+    int steps = stepsPerDispatch*dispatchesPerFrame;
+    double ratio = frameBudget/DEF_MAX(elapsed,0.01);
+    ratio = DEF_MAX(0.5,DEF_MIN(ratio,2.0));
+    steps = static_cast<int>(steps*ratio + 0.5);
+    steps = DEF_MAX(1,DEF_MIN(steps,STEPS_PER_FRAME_MAX));
+
+    stepsPerDispatch = DEF_MIN(steps,STEPS_PER_DISPATCH_MAX);
+    dispatchesPerFrame = (steps + stepsPerDispatch - 1)/stepsPerDispatch;
+}
 
-// *********************************** protected methods ******************************
 void OpenGL2d::initializeGL() {
     fprintf(stderr,"Initialize OpenGL...\n");
     if (gl3wInit()) {
@@ -371,12 +683,14 @@ void OpenGL2d::initializeGL() {
         exit(1);
     }
 
-#ifdef HAVE_COMP_SHADER
-    if (!isExtensionAvailable("GL_ARB_compute_shader")) {
-        fprintf(stderr,"Error: Compute shader not available!\n");
-        exit(1);
+    // without compute shaders, the basin map is rendered on the CPU
+    haveCompute = (gl3wIsSupported(4,3) || (isExtensionAvailable("GL_ARB_compute_shader") &&
+                                            isExtensionAvailable("GL_ARB_shader_storage_buffer_object") &&
+                                            isExtensionAvailable("GL_ARB_shader_image_load_store") &&
+                                            isExtensionAvailable("GL_ARB_copy_image")));
+    if (!haveCompute) {
+        fprintf(stderr,"Compute shaders are not available; the basin map is rendered on the CPU.\n");
     }
-#endif    
 
     if (!setSyncToVBlank(0)) {
         //QMessageBox::warning(this,"Performance warning","SyncToVBlank could not be disabled. This might lead to high performance lost!");
@@ -400,6 +714,8 @@ void OpenGL2d::initializeGL() {
     */
 #endif
 
+    haveBufferStorage = (gl3wIsSupported(4,4) || isExtensionAvailable("GL_ARB_buffer_storage"));
+
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -422,8 +738,31 @@ void OpenGL2d::initializeGL() {
     //  set ...
     // ------------------------------------------
     createShaders();
+    if (haveCompute && (!createPendIntShader() || !createActiveListShader())) {
+        fprintf(stderr,"Compute shaders cannot be built; the basin map is rendered on the CPU.\n");
+        haveCompute = false;
+    }
     //resetParticleStorage();
     SetMaxNumPoints(1500);
+
+    if (haveCompute) {
+        mParticleThread = new ParticleThread(this);
+        connect(mParticleThread, SIGNAL(frameReady()), this, SLOT(update()));
+        mParticleThread->start();
+    } else {
+        mBasinService.SetNotify([this]() {
+            QMetaObject::invokeMethod(this,"fetchTiles",Qt::QueuedConnection);
+        });
+        mBasinService.Start();
+    }
+
+    // the drag preview always runs on the CPU
+    mPreviewService.SetMode(BASIN_MARIANI_SILVER);
+    mPreviewService.SetTolerance(PREVIEW_TOLERANCE);
+    mPreviewService.SetNotify([this]() {
+        QMetaObject::invokeMethod(this,"fetchPreview",Qt::QueuedConnection);
+    });
+    mPreviewService.Start();
 }
 
 /**
@@ -452,56 +791,62 @@ void OpenGL2d::paintGL() {
     glClearColor(0.0f,0.0f,0.0f,0.0f);
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
-    glm::mat4 mvp = glm::ortho(0.0f,1.0f,0.0f,1.0f);
-
     glDisable( GL_DEPTH_TEST);
 
-    mQuadShader.Bind();
-    glUniformMatrix4fv( mQuadShader.GetUniformLocation("mvp"), 1, GL_FALSE, glm::value_ptr(mvp) );
-    glBindVertexArray(vaQuad);
-    // glDrawArrays( GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-    mQuadShader.Release();
-
     float rx = static_cast<float>(mSysData->m_rmaxX);
     float ry = static_cast<float>(mSysData->m_rmaxY);
-    mvp = glm::ortho( -rx, rx, -ry, ry );
+    float cx = static_cast<float>(viewX);
+    float cy = static_cast<float>(viewY);
+    glm::mat4 mvp = glm::ortho( cx - rx, cx + rx, cy - ry, cy + ry );
     //fprintf(stderr,"rs: %f %f\n",rx,ry);
 
-#ifdef HAVE_COMP_SHADER
-    if (posSSbo[0]>0) {
-        mPendShader.Bind();
-        glUniformMatrix4fv( mPendShader.GetUniformLocation("mvp"), 1, GL_FALSE, glm::value_ptr(mvp) );
-        glUniform1f( mPendShader.GetUniformLocation("tScale"), static_cast<float>(mSysData->m_tScale) );
-        glUniform1f( mPendShader.GetUniformLocation("pendulumLength"), static_cast<float>(mSysData->m_pendulumLength) );
-#ifdef USE_SPHERICAL
-        glUniform1i( mPendShader.GetUniformLocation("useSpherical"), 1 );
-#else
-        glUniform1i( mPendShader.GetUniformLocation("useSpherical"), 0 );
-#endif
-        glPointSize(2);        
-        // initial position
-        // glBindBuffer(GL_ARRAY_BUFFER,posSSbo[currSbo]);
-        glBindBuffer(GL_ARRAY_BUFFER,posInit);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer( 0, 4, GL_FLOAT, GL_FALSE, 0, NULL );
-
-        // color
-        glBindBuffer(GL_ARRAY_BUFFER,rkStep); // maps to color
-
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer( 1, 4, GL_FLOAT, GL_FALSE, 0, NULL );
-
-        glBindBuffer(GL_ARRAY_BUFFER,timeID);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer( 2, 1, GL_FLOAT, GL_FALSE, 0, NULL );
-
-        glDrawArrays(GL_POINTS,0,numParticles);
+    // latest frame of the particle thread, or the map of the CPU; the GPU
+    // waits for the copy of the particle thread
+    displayMutex.lock();
+    int front = displayFront;
+    GLsync copied = 0;
+    if (front>=0) {
+        displayDrawing = front;
+        copied = displayFence[front];
+        displayFence[front] = 0;
+    }
+    displayMutex.unlock();
+
+    // the drag preview shows through where the basin map is not finished
+    if (previewShown && previewGrid.width>0) {
+        float px = static_cast<float>(previewGrid.xmin);
+        float py = static_cast<float>(previewGrid.ymin);
+        float pw = static_cast<float>(previewGrid.xmax - previewGrid.xmin);
+        float ph = static_cast<float>(previewGrid.ymax - previewGrid.ymin);
+        glm::mat4 quadMvp = glm::scale( glm::translate(mvp,glm::vec3(px,py,0.0f)), glm::vec3(pw,ph,1.0f) );
+        drawBasin(quadMvp,previewTex,1,false);
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER,0);
-        mPendShader.Release();
+    if (front>=0) {
+        if (copied!=0) {
+            glWaitSync(copied,0,GL_TIMEOUT_IGNORED);
+            glDeleteSync(copied);
+        }
+        // one quad over the grid, the texel centers are the samples; the
+        // palette lookup and the averaging of the samples are done per fragment
+        float gx = static_cast<float>((gridTileX*tileSamples - 0.5)*sampleSpacing);
+        float gy = static_cast<float>((gridTileY*tileSamples - 0.5)*sampleSpacing);
+        float gw = static_cast<float>(particleWidth*sampleSpacing);
+        float gh = static_cast<float>(particleHeight*sampleSpacing);
+        glm::mat4 quadMvp = glm::scale( glm::translate(mvp,glm::vec3(gx,gy,0.0f)), glm::vec3(gw,gh,1.0f) );
+        drawBasin(quadMvp,displayTex[front],supersample,previewShown);
+
+        GLsync drawn = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+        glFlush();
+        displayMutex.lock();
+        if (drawFence[front]!=0) {
+            glDeleteSync(drawFence[front]);
+        }
+        drawFence[front] = drawn;
+        displayDrawing = -1;
+        displayDone.wakeAll();
+        displayMutex.unlock();
     }
-#endif // HAVE_COMP_SHADER    
 
     mMagnetShader.Bind();
     glUniformMatrix4fv( mMagnetShader.GetUniformLocation("mvp"),1,GL_FALSE,glm::value_ptr(mvp));
@@ -516,7 +861,7 @@ void OpenGL2d::paintGL() {
     }
     mMagnetShader.Release();
 
-    if (vaLine>0 && mSysData->m_numPoints>0) {
+    if (vaLine>0 && mSysData->m_numPoints>0 && lineNumPoints>0) {
         QColor lc = mSysData->m_lineColor;
 
         glLineWidth( mSysData->m_lineWidth );
@@ -524,10 +869,15 @@ void OpenGL2d::paintGL() {
         glUniformMatrix4fv( mLineShader.GetUniformLocation("mvp"), 1, GL_FALSE, glm::value_ptr(mvp) );
         glUniform3f( mLineShader.GetUniformLocation("lineColor"), lc.redF(), lc.greenF(), lc.blueF() );
         glBindVertexArray(vaLine);
-        glDrawArrays(GL_LINE_STRIP, 0, mSysData->m_numPoints );
+        glDrawArrays(GL_LINE_STRIP, lineSlot*lineSlotSize, lineNumPoints );
         glBindVertexArray(0);
         mLineShader.Release();
         glLineWidth(1);
+
+        if (lineFence[lineSlot]!=0) {
+            glDeleteSync(lineFence[lineSlot]);
+        }
+        lineFence[lineSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
     }
 }
 
@@ -538,9 +888,8 @@ void OpenGL2d::paintGL() {
  */
 void OpenGL2d::resizeGL( int w, int h ) {
     glViewport(0,0,w,h);
-#ifndef HAVE_COMP_SHADER  
-    resetParticleStorage();
-#endif
+    // the basin map has its own resolution and is only scaled
+    updateViewRegion();
 }
 
 /**
@@ -552,15 +901,31 @@ void OpenGL2d::keyPressEvent( QKeyEvent* event ) {
     mKeyModifier = event->modifiers();
     switch (mKeyPressed)
     {
+        case Qt::Key_I: {
+            zoomLevel = 0;
+            viewX = viewY = 0.0;
+            ResetParticleSimulation();
+            break;
+        }
         case Qt::Key_S: {
+            if (mParticleThread!=NULL) {
+                mParticleThread->Pause();
+            }
             makeCurrent();
             mQuadShader.RemoveAllShaders();
             mLineShader.RemoveAllShaders();
-            mPendShader.RemoveAllShaders();
-#ifdef HAVE_COMP_SHADER
-            mPendIntShader.RemoveAllShaders();
-#endif // HAVE_COMP_SHADER            
             createShaders();
+            if (haveCompute) {
+                mPendIntShader.RemoveAllShaders();
+                mActiveListShader.RemoveAllShaders();
+                createPendIntShader();
+                createActiveListShader();
+                setIntegrationUniforms();
+                glFinish();
+            }
+            if (mParticleThread!=NULL) {
+                mParticleThread->Resume();
+            }
             updateGL();
             break;
         }
@@ -591,10 +956,15 @@ void OpenGL2d::mousePressEvent( QMouseEvent * event ) {
         mSysData->m_currAnimTime = 0.0;
         mSysData->m_currIndex = 0;
         mSysData->CalcTrajectory(mx,my);
-        mSysData->UpdateTrajectory(&vboLine);
     }
     else if (mButtonPressed == Qt::MidButton) {
-        mSysData->m_numPoints = 0;
+        mSysData->CancelTrajectory();
+    }
+    else if (mButtonPressed == Qt::RightButton && activeMagnet<0) {
+        panning = true;
+        panStart = event->pos();
+        panViewX = viewX;
+        panViewY = viewY;
     }
     event->accept();
     updateGL();
@@ -606,10 +976,38 @@ void OpenGL2d::mousePressEvent( QMouseEvent * event ) {
  */
 void OpenGL2d::mouseReleaseEvent( QMouseEvent * event ) {
     mButtonPressed = Qt::NoButton;
+    if (panning) {
+        // only the newly exposed tiles are integrated
+        panning = false;
+        if (event->pos()!=panStart) {
+            resetParticleStorage();
+        }
+    }
+    if (draggingMagnet) {
+        // the full map replaces the preview, which stays below until then
+        draggingMagnet = false;
+        mPreviewService.Cancel();
+        resetParticleStorage();
+        previewShown = true;
+        if (mParticleThread!=NULL) {
+            mParticleThread->Resume();
+        }
+    }
     event->accept();
     updateGL();
 }
 
+/**
+ * @brief OpenGL2d::wheelEvent
+ * @param event
+ */
+void OpenGL2d::wheelEvent( QWheelEvent * event ) {
+    if (event->delta()!=0) {
+        zoomView(event->pos().x(),event->pos().y(),(event->delta()>0 ? 1 : -1));
+    }
+    event->accept();
+}
+
 /**
  * @brief OpenGL2d::mouseMoveEvent
  * @param event
@@ -623,7 +1021,6 @@ void OpenGL2d::mouseMoveEvent( QMouseEvent * event ) {
             break;
         case Qt::LeftButton: {
             mSysData->CalcTrajectory(mx,my);
-            mSysData->UpdateTrajectory(&vboLine);
             mSysData->m_currAnimPos = glm::vec2(mx,my);
             mSysData->m_currAnimTime = 0.0;
             mSysData->m_currIndex = 0;
@@ -634,9 +1031,18 @@ void OpenGL2d::mouseMoveEvent( QMouseEvent * event ) {
             break;
         }
         case Qt::RightButton: {
+            if (panning) {
+                // the map moves along; it is completed on release
+                viewX = panViewX - (event->pos().x() - panStart.x())*2.0*mSysData->m_rmaxX/DEF_MAX(width(),1);
+                viewY = panViewY + (event->pos().y() - panStart.y())*2.0*mSysData->m_rmaxY/DEF_MAX(height(),1);
+                updateGL();
+                event->accept();
+                return;
+            }
             if (activeMagnet>=0 && activeMagnet<mSysData->m_magnets.size()) {
                 mSysData->m_magnets[activeMagnet].pos = glm::vec3( static_cast<float>(mx), static_cast<float>(my), mSysData->m_magnets[activeMagnet].pos.z );
                 emit magnetMoved(activeMagnet);
+                requestPreview();
             }
             break;
         }
@@ -680,194 +1086,721 @@ void OpenGL2d::createShaders() {
     mMagnetShader.CreateProgramFromFile(mMagnetVertShaderName.toStdString().c_str(),
                                         mMagnetGeomShaderName.toStdString().c_str(),
                                         mMagnetFragShaderName.toStdString().c_str());
+}
 
-    fprintf(stderr,"Create pendulum shader with ...\n\t%s\n\t%s\n",
-            mPendVertShaderName.toStdString().c_str(),
-            mPendFragShaderName.toStdString().c_str());
-    mPendShader.CreateProgramFromFile(mPendVertShaderName.toStdString().c_str(),
-                                      mPendFragShaderName.toStdString().c_str());
-
-#ifdef HAVE_COMP_SHADER
-    fprintf(stderr,"Create pendulum integration shader with ...\n\t%s\n",mPendCompShaderName.toStdString().c_str());
+/**
+ * @brief OpenGL2d::createPendIntShader
+ *   The force law is fixed when the shader is compiled, not tested per evaluation.
+ */
+bool OpenGL2d::createPendIntShader() {
+    forceLaw law = ForceLawFromKappa(mSysData->m_kappa);
+    fprintf(stderr,"Create pendulum integration shader (force: %s) with ...\n\t%s\n",ForceLawName(law),
+            mPendCompShaderName.toStdString().c_str());
+    std::string lawDefine = std::string("#define FORCE_LAW_") + (law==FORCE_KAPPA1 ? "KAPPA1" : (law==FORCE_KAPPA2 ? "KAPPA2" : "GENERIC"));
+    mPendIntShader.ClearSubsStrings();
+    mPendIntShader.AddSubsStrings("#define FORCE_LAW_GENERIC",lawDefine.c_str());
     mPendIntShader.CreateEmptyProgram();
-    mPendIntShader.AttachShaderFromFile(mPendCompShaderName.toStdString().c_str(), GL_COMPUTE_SHADER, true);
+    bool ok = mPendIntShader.AttachShaderFromFile(mPendCompShaderName.toStdString().c_str(), GL_COMPUTE_SHADER, true);
     mPendIntShader.Release();
-#endif
+    mPendIntLaw = static_cast<int>(law);
+    return ok;
 }
 
 /**
- * @brief OpenGL2d::resetParticleStorage
+ * @brief OpenGL2d::createActiveListShader
  */
-void  OpenGL2d::resetParticleStorage() {
-    makeCurrent();
-    
-    mSysData->m_rmax = mSysData->m_pendulumLength*sin(glm::radians(mSysData->m_maxTheta));
+bool OpenGL2d::createActiveListShader() {
+    fprintf(stderr,"Create active list shader with ...\n\t%s\n",mActiveListShaderName.toStdString().c_str());
+    mActiveListShader.CreateEmptyProgram();
+    bool ok = mActiveListShader.AttachShaderFromFile(mActiveListShaderName.toStdString().c_str(), GL_COMPUTE_SHADER, true);
+    mActiveListShader.Release();
+    return ok;
+}
 
-    double fw = static_cast<double>(width());
-    double fh = static_cast<double>(height());
-    double aspect = fw/fh;
-    mSysData->m_rmaxX = mSysData->m_rmax * aspect;
-    mSysData->m_rmaxY = mSysData->m_rmax;
-    
-#ifdef HAVE_COMP_SHADER    
-    if (posSSbo[0]>0) {
-        glDeleteBuffers(2,posSSbo);
-        posSSbo[0] = posSSbo[1] = 0;
+/**
+ *  Create the class and time textures of the basin map, one texel per pixel
+ *  and cleared to zero. Class and time have two bytes each.
+ */
+void OpenGL2d::newBasinTextures( GLuint *tex, int w, int h ) {
+    if (tex[0]>0) {
+        glDeleteTextures(2,tex);
     }
-    if (posInit>0) {
-        glDeleteBuffers(1,&posInit);
-        posInit = 0;
+    glGenTextures(2,tex);
+
+    const GLenum format[2]    = { GL_R16UI, GL_R16F };
+    const GLenum pixFormat[2] = { GL_RED_INTEGER, GL_RED };
+    const GLenum type[2]      = { GL_UNSIGNED_SHORT, GL_HALF_FLOAT };
+    std::vector<GLushort> zeros(w*h,0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT,2);
+    for(int k=0; k<2; k++) {
+        glBindTexture( GL_TEXTURE_2D, tex[k] );
+        glTexImage2D( GL_TEXTURE_2D, 0, format[k], w, h, 0, pixFormat[k], type[k], &zeros[0] );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
     }
+    glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+    glBindTexture( GL_TEXTURE_2D, 0 );
+}
 
-    currSbo = 0;
-    nextSbo = 1;
+/**
+ *  Upload a tile of the BasinService into a pair of basin textures.
+ */
+void OpenGL2d::uploadTile( const GLuint *tex, const basinTileData &data ) {
+    const basinTile &tile = data.tile;
+    int w = tile.x1 - tile.x0;
+    int h = tile.y1 - tile.y0;
+    glPixelStorei(GL_UNPACK_ALIGNMENT,2);
+    glBindTexture( GL_TEXTURE_2D, tex[0] );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, tile.x0, tile.y0, w, h, GL_RED_INTEGER, GL_UNSIGNED_SHORT, &data.cls[0] );
+    glBindTexture( GL_TEXTURE_2D, tex[1] );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, tile.x0, tile.y0, w, h, GL_RED, GL_FLOAT, &data.time[0] );
+    glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+    glBindTexture( GL_TEXTURE_2D, 0 );
+}
 
-    std::vector<glm::vec2> initPos;
+/**
+ *  Draw a pair of basin textures with quad.frag.
+ * @param mvp      Maps the unit square onto the region of the textures.
+ * @param tex      Class and time texture.
+ * @param samples  Samples per pixel and direction.
+ * @param overlay  Leave out the pixels without a finished sample.
+ */
+void OpenGL2d::drawBasin( const glm::mat4 &mvp, const GLuint *tex, int samples, bool overlay ) {
+    mQuadShader.Bind();
+    glUniformMatrix4fv( mQuadShader.GetUniformLocation("mvp"), 1, GL_FALSE, glm::value_ptr(mvp) );
+    glUniform1f( mQuadShader.GetUniformLocation("tScale"), static_cast<float>(mSysData->m_tScale) );
+    glUniform3f( mQuadShader.GetUniformLocation("initColor"), initColor.x, initColor.y, initColor.z );
+    glUniform1i( mQuadShader.GetUniformLocation("palette"), 0 );
+    glUniform1i( mQuadShader.GetUniformLocation("basinClass"), 1 );
+    glUniform1i( mQuadShader.GetUniformLocation("basinTime"), 2 );
+    glUniform1i( mQuadShader.GetUniformLocation("supersample"), samples );
+    glUniform1i( mQuadShader.GetUniformLocation("overlay"), (overlay ? 1 : 0) );
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER,paletteTex);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D,tex[0]);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D,tex[1]);
 
-#ifdef USE_SPHERICAL
-    //float rstep = 2.0f*rmax/static_cast<float>(width);
-    float xstep = 2.0f*rmaxx/fw;
-    float ystep = 2.0f*rmaxy/fh;
-    for(unsigned int y=0; y<height; y++) {
-        for(unsigned int x=0; x<width; x++) {
-            float xx = -rmaxx + (x+0.5)*xstep;
-            float yy = -rmaxy + (y+0.5)*ystep;
-            float r = sqrtf(xx*xx + yy*yy);
-            glm::vec2 pos = glm::vec2( asin(r/pendulumLength), atan2(yy,xx) );   // theta,phi
-            initPos.push_back(pos);
+    glBindVertexArray(vaQuad);
+    glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+    glBindVertexArray(0);
+
+    glBindTexture(GL_TEXTURE_2D,0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D,0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER,0);
+    mQuadShader.Release();
+}
+
+/**
+ *  Render the view with the dragged magnet at a reduced resolution and with
+ *  a looser tolerance and a shorter maximum time. The first preview of a
+ *  drag stops the basin map of the old positions; every new position gives
+ *  up the preview that is running. A preview that is given up after more
+ *  than twice the budget makes the next one smaller.
+ */
+void OpenGL2d::requestPreview() {
+    double elapsed = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - previewStart).count();
+    if (!draggingMagnet) {
+        draggingMagnet = true;
+        if (mParticleThread!=NULL) {
+            mParticleThread->Pause();
+        } else {
+            mBasinService.Cancel();
         }
     }
-#else
-    double xstep = 2.0*mSysData->m_rmaxX/fw;
-    double ystep = 2.0*mSysData->m_rmaxY/fh;
-    for(int y=0; y<height(); y++) {
-        for(int x=0; x<width(); x++) {
-            float xx = static_cast<float>(-mSysData->m_rmaxX + x*xstep);
-            float yy = static_cast<float>(-mSysData->m_rmaxY + y*ystep);
-
-            glm::vec2 pos = glm::vec2(xx,yy) + 0.5f*glm::vec2(xstep,ystep);
-            initPos.push_back(pos);
+    else if (mPreviewService.NumPixelsLeft()>0 && elapsed>2.0*PREVIEW_BUDGET) {
+        previewPixels = DEF_MAX(PREVIEW_PIXELS_MIN,0.5*previewPixels);
+    }
+
+    double fw = static_cast<double>(DEF_MAX(width(),1));
+    double fh = static_cast<double>(DEF_MAX(height(),1));
+    double scale = DEF_MIN(sqrt(previewPixels/(fw*fh)),1.0);
+    int w = DEF_MAX(static_cast<int>(fw*scale + 0.5),1);
+    int h = DEF_MAX(static_cast<int>(fh*scale + 0.5),1);
+    makeCurrent();
+    if (w!=previewGrid.width || h!=previewGrid.height) {
+        newBasinTextures(previewTex,w,h);
+    }
+    previewGrid.width = w;
+    previewGrid.height = h;
+    previewGrid.xmin = viewX - mSysData->m_rmaxX;
+    previewGrid.ymin = viewY - mSysData->m_rmaxY;
+    previewGrid.xmax = viewX + mSysData->m_rmaxX;
+    previewGrid.ymax = viewY + mSysData->m_rmaxY;
+
+    PendulumParams params;
+    mSysData->GetParams(params);
+    previewStart = std::chrono::steady_clock::now();
+    mPreviewService.Request(params,previewGrid,DEF_MIN(maxTime,PREVIEW_MAX_TIME));
+    previewShown = true;
+}
+
+/**
+ *  Grow the line ring to at least 'numPoints' points per slot. A persistently
+ *  mapped buffer has immutable storage, so growing means a new buffer; the
+ *  slot size is at least doubled to keep that rare. The ring never shrinks.
+ */
+void OpenGL2d::reserveLine( int numPoints ) {
+    if (vaLine>0 && numPoints<=lineSlotSize) {
+        return;
+    }
+    if (vaLine>0) {
+        for(int i=0; i<LINE_NUM_SLOTS; i++) {
+            if (lineFence[i]!=0) {
+                glDeleteSync(lineFence[i]);
+                lineFence[i] = 0;
+            }
         }
+        glDeleteBuffers(1,&vboLine);
+        glDeleteVertexArrays(1,&vaLine);
     }
-#endif
+    lineMap = NULL;
+    lineSlotSize = DEF_MAX(numPoints,DEF_MAX(2*lineSlotSize,1));
+    lineSlot = 0;
+
+    GLsizeiptr size = sizeof(float)*2*LINE_NUM_SLOTS*lineSlotSize;
+    glGenVertexArrays(1,&vaLine);
+    glGenBuffers(1,&vboLine);
+
+    glBindVertexArray(vaLine);
+    glBindBuffer(GL_ARRAY_BUFFER,vboLine);
+    glEnableVertexAttribArray(0);
+    if (haveBufferStorage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER,size,NULL,flags);
+        lineMap = static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER,0,size,flags));
+    } else {
+        glBufferData(GL_ARRAY_BUFFER,size,NULL,GL_DYNAMIC_DRAW);
+    }
+    glVertexAttribPointer(0,2,GL_FLOAT,GL_FALSE,0,NULL);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+}
 
-    numParticles = static_cast<int>(initPos.size());
+/**
+ * @brief OpenGL2d::resetParticleStorage
+ */
+void  OpenGL2d::resetParticleStorage() {
+    // the buffers are shared with the particle thread
+    if (mParticleThread!=NULL) {
+        mParticleThread->Pause();
+    }
+    makeCurrent();
+    // finished tiles of the previous grid are kept, whatever changed
+    storeTiles();
+    previewShown = false;
+
+    mSysData->m_rmax = mSysData->m_pendulumLength*sin(glm::radians(mSysData->m_maxTheta));
+    mSysData->SyncParams();
+
+    // pixels of the simulated region; at zoom level 0 they span the whole elongation in y
+    int w = (mSysData->m_simWidth>0 ? mSysData->m_simWidth : DEF_MAX(width(),1));
+    int h = (mSysData->m_simHeight>0 ? mSysData->m_simHeight : DEF_MAX(height(),1));
+
+    // one particle per sample; the grid, which has up to one more tile on
+    // every side, is limited by the texture size and, with compute shaders,
+    // by the number of work groups of a dispatch
+    GLint maxTexSize = 0;
+    GLint maxGroups = 65535;
+    glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxTexSize );
+    if (haveCompute) {
+        glGetIntegeri_v( GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxGroups );
+    }
+    int gw = w + 2*BASIN_TILE_PIXELS;
+    int gh = h + 2*BASIN_TILE_PIXELS;
+    supersample = DEF_MAX(mSysData->m_supersample,1);
+    while (supersample>1 && (DEF_MAX(gw,gh)*supersample>maxTexSize || (static_cast<double>(gw)*gh*supersample*supersample + 127)/128>maxGroups)) {
+        supersample--;
+    }
+    if (supersample!=mSysData->m_supersample) {
+        fprintf(stderr,"Supersampling of %dx%d pixels reduced to %dx%d\n",w,h,supersample,supersample);
+    }
+    setupGrid(w,h);
+    updateViewRegion();
     fprintf(stderr,"Reset particle storage with %d particles\n",numParticles);
 
     // ------------------------------------------
-    //  buffer storage for ping-pong simulation
+    //  display textures handed over by the particle thread or filled tile
+    //  by tile by the CPU, zero until the pixel has started; the tiles in
+    //  the cache are there at once
     // ------------------------------------------
-    glGenBuffers(2,posSSbo);
-    GLint bufMask = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
-
-    glBindBuffer( GL_SHADER_STORAGE_BUFFER, posSSbo[0] );
-    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*numParticles*4, NULL, GL_STREAM_DRAW );
-    float *points = static_cast<float*>(glMapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*numParticles*4, bufMask));
-    for(int i=0; i<numParticles; i++) {
-        points[4*i+0] = initPos[i].x;
-        points[4*i+1] = initPos[i].y;
-        points[4*i+2] = 0.0f;
-        points[4*i+3] = 0.0f;
+    for(int l=0; l<2; l++) {
+        newBasinTextures(displayTex[l],particleWidth,particleHeight);
+        if (displayFence[l]!=0) {
+            glDeleteSync(displayFence[l]);
+        }
+        if (drawFence[l]!=0) {
+            glDeleteSync(drawFence[l]);
+        }
+        displayFence[l] = drawFence[l] = 0;
     }
-    glUnmapBuffer( GL_SHADER_STORAGE_BUFFER );
+    displayFront = 0;
 
-    glBindBuffer( GL_SHADER_STORAGE_BUFFER, posSSbo[1] );
-    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*numParticles*4, NULL, GL_STREAM_DRAW );
-    float *zero = static_cast<float*>(glMapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*numParticles*4, bufMask));
-    for(int i=0; i<numParticles; i++) {
-        zero[4*i+0] = 0.0f;
-        zero[4*i+1] = 0.0f;
-        zero[4*i+2] = 0.0f;
-        zero[4*i+3] = 0.0f;
-    }
-    glUnmapBuffer( GL_SHADER_STORAGE_BUFFER );
+    std::vector<char> known;
+    loadTiles(known);
 
+    GLint bufMask = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
 
     // ------------------------------------------
-    //  initial position
+    //  palette: magnet colors, looked up by quad.frag
     // ------------------------------------------
+    if (palette>0) {
+        glDeleteBuffers(1,&palette);
+    }
+    if (paletteTex==0) {
+        glGenTextures(1,&paletteTex);
+    }
+    int numColors = std::max(mSysData->m_magnets.size(),1);
+    glGenBuffers(1,&palette);
+    glBindBuffer( GL_TEXTURE_BUFFER, palette );
+    glBufferData( GL_TEXTURE_BUFFER, sizeof(float)*numColors*4, NULL, GL_STATIC_DRAW );
+    float *mcol = static_cast<float*>(glMapBufferRange( GL_TEXTURE_BUFFER, 0, sizeof(float)*numColors*4, bufMask));
+    for(int i=0; i<numColors; i++) {
+        glm::vec4 col = (i<mSysData->m_magnets.size() ? mSysData->m_magnets[i].color : glm::vec4(initColor,1.0f));
+        mcol[4*i+0] = col.x;
+        mcol[4*i+1] = col.y;
+        mcol[4*i+2] = col.z;
+        mcol[4*i+3] = col.w;
+    }
+    glUnmapBuffer( GL_TEXTURE_BUFFER );
+    glBindTexture( GL_TEXTURE_BUFFER, paletteTex );
+    glTexBuffer( GL_TEXTURE_BUFFER, GL_RGBA32F, palette );
+    glBindTexture( GL_TEXTURE_BUFFER, 0 );
+    glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+
+    if (haveCompute) {
+        resetComputeStorage(known);
+    } else {
+        // the CPU renders the other tiles into the first display textures;
+        // a new request gives up the tiles of the previous one
+        basinGrid grid;
+        grid.width = particleWidth;
+        grid.height = particleHeight;
+        grid.xmin = (gridTileX*tileSamples - 0.5)*sampleSpacing;
+        grid.ymin = (gridTileY*tileSamples - 0.5)*sampleSpacing;
+        grid.xmax = grid.xmin + particleWidth*sampleSpacing;
+        grid.ymax = grid.ymin + particleHeight*sampleSpacing;
+        grid.tileSize = tileSamples;
+        grid.skip = known;
+        mBasinService.Request(mSysData->m_syncedParams,grid,maxTime);
+        numActive = static_cast<int>(mBasinService.NumPixelsLeft());
+    }
+    numSteps = 0;
 
-    glGenBuffers(1,&posInit);
-    glBindBuffer( GL_COPY_WRITE_BUFFER, posInit );
-    glBufferData( GL_COPY_WRITE_BUFFER, sizeof(float)*numParticles*4, NULL, GL_STREAM_COPY );
-    glBindBuffer( GL_COPY_READ_BUFFER, posSSbo[0] );
-    glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(float)*numParticles*4 );
-    glBindBuffer( GL_COPY_READ_BUFFER, 0 );
-    glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
-
-    initPos.clear();
+    if (mParticleThread!=NULL) {
+        mParticleThread->Resume();
+    }
+}
 
+/**
+ *  Buffers and textures of the compute shaders. Called by resetParticleStorage()
+ *  with the context current.
+ * @param known  Tiles that are taken from the cache, row by row.
+ */
+void  OpenGL2d::resetComputeStorage( const std::vector<char> &known ) {
     // ------------------------------------------
-    //  buffer storage for stepsize
+    //  particle records: (y), h, t, status, reserved
+    //  A zero status makes the compute shader start the pixel from scratch,
+    //  so the start positions need not be uploaded.
     // ------------------------------------------
-    if (rkStep>0) {
-        glDeleteBuffers(1,&rkStep);
-    }
-    glGenBuffers(1,&rkStep);
-    glBindBuffer( GL_SHADER_STORAGE_BUFFER, rkStep );
-    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*numParticles*4, NULL, GL_STREAM_DRAW );
-    float *rs = static_cast<float*>(glMapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*numParticles*4, bufMask));
-    for(int i=0; i<numParticles; i++) {
-        rs[4*i+0] = initColor.x;
-        rs[4*i+1] = initColor.y;
-        rs[4*i+2] = initColor.z;
-        rs[4*i+3] = hInit;
+    if (particles>0) {
+        glDeleteBuffers(1,&particles);
     }
-    glUnmapBuffer( GL_SHADER_STORAGE_BUFFER );
+    glGenBuffers(1,&particles);
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, particles );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, PARTICLE_RECORD_SIZE*numParticles, NULL, GL_STREAM_DRAW );
+    glClearBufferData( GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL );
+    GLint bufMask = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
 
     // ------------------------------------------
-    //  buffer storage for time id
+    //  active lists: (numGroupsX, numGroupsY, numGroupsZ, count), indices
+    //  The coarsest samples of the tiles that are not in the cache are
+    //  active at first, activateStage() adds the others; the step shader
+    //  appends the pixels that are still running to the other list.
     // ------------------------------------------
-    if (timeID>0) {
-        glDeleteBuffers(1,&timeID);
+    if (activeList[0]>0) {
+        glDeleteBuffers(2,activeList);
+    }
+    glGenBuffers(2,activeList);
+    GLuint count = 0;
+    for(int l=0; l<2; l++) {
+        glBindBuffer( GL_SHADER_STORAGE_BUFFER, activeList[l] );
+        glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(GLuint)*(4+numParticles), NULL, GL_DYNAMIC_DRAW );
+        GLuint *alist = static_cast<GLuint*>(glMapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint)*(4+numParticles), bufMask));
+        if (l==0) {
+            for(int py=0; py<particleHeight; py++) {
+                const char *row = &known[(py/tileSamples)*gridTilesX];
+                for(int px=0; px<particleWidth; px++) {
+                    if (!row[px/tileSamples] && sampleLevel(px,py)==0) {
+                        alist[4+count] = py*particleWidth + px;
+                        count++;
+                    }
+                }
+            }
+        }
+        alist[0] = (l==0 ? (count + 127)/128 : 0);
+        alist[1] = alist[2] = 1;
+        alist[3] = (l==0 ? count : 0);
+        glUnmapBuffer( GL_SHADER_STORAGE_BUFFER );
     }
-    glGenBuffers(1,&timeID);
-    glBindBuffer( GL_SHADER_STORAGE_BUFFER, timeID );
-    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*numParticles*4, NULL, GL_STREAM_DRAW );
-    float *tt = static_cast<float*>(glMapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*numParticles, bufMask));
-    for(int i=0; i<numParticles; i++) {
-        tt[i] = 0;
+    currActive = 0;
+    tileKnown = known;
+    deferred.clear();
+    nextStage = (count>0 ? 1 : PROGRESSIVE_STAGES);
+    numPending = static_cast<long>(std::count(known.begin(),known.end(),0))*tileSamples*tileSamples - count;
+    numActive = static_cast<int>(count + numPending);
+    gridStored = (count==0);
+    stepsPerDispatch = dispatchesPerFrame = 1;
+
+    // ------------------------------------------
+    //  basin map written by the compute shader, starting with the tiles of
+    //  the cache
+    // ------------------------------------------
+    newBasinTextures(basinTex,particleWidth,particleHeight);
+    if (count<static_cast<GLuint>(numParticles)) {
+        for(int k=0; k<2; k++) {
+            glCopyImageSubData( displayTex[0][k], GL_TEXTURE_2D, 0, 0, 0, 0,
+                                basinTex[k], GL_TEXTURE_2D, 0, 0, 0, 0, particleWidth, particleHeight, 1 );
+        }
     }
-    glUnmapBuffer( GL_SHADER_STORAGE_BUFFER );
 
     // ------------------------------------------
-    //  buffer storage for magnets
+    //  buffer storage for magnets: x, y, rz^2, kappa*alpha*magFactor
     // ------------------------------------------
+    const MagnetTable &table = mSysData->m_magnetTable;
+    if (static_cast<int>(table.Law())!=mPendIntLaw) {
+        createPendIntShader();
+    }
     if (posMag>0) {
         glDeleteBuffers(1,&posMag);
     }
     glGenBuffers(1,&posMag);
     glBindBuffer( GL_SHADER_STORAGE_BUFFER, posMag );
-    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*mSysData->m_magnets.size()*4, NULL, GL_STREAM_DRAW );
-    float *mpos = static_cast<float*>(glMapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*mSysData->m_magnets.size()*4, bufMask));
-    for(int i=0; i<mSysData->m_magnets.size(); i++) {
-        mpos[4*i+0] = mSysData->m_magnets[i].pos.x;
-        mpos[4*i+1] = mSysData->m_magnets[i].pos.y;
-        mpos[4*i+2] = mSysData->m_magnets[i].pos.z;
-        mpos[4*i+3] = mSysData->m_magnets[i].alpha;
-    }
+    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*table.Size()*4, NULL, GL_STREAM_DRAW );
+    float *mpos = static_cast<float*>(glMapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*table.Size()*4, bufMask));
+    table.FillGPUBuffer(mpos);
     glUnmapBuffer( GL_SHADER_STORAGE_BUFFER );
 
     // ------------------------------------------
-    //  buffer storage for colors
+    //  buffer storage for equilibria
     // ------------------------------------------
-    if (colMag>0) {
-        glDeleteBuffers(1,&colMag);
-    }
-    glGenBuffers(1,&colMag);
-    glBindBuffer( GL_SHADER_STORAGE_BUFFER, colMag );
-    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*mSysData->m_magnets.size()*4, NULL, GL_STREAM_DRAW );
-    float *mcol = static_cast<float*>(glMapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*mSysData->m_magnets.size()*4, bufMask));
-    for(int i=0; i<mSysData->m_magnets.size(); i++) {
-        mcol[4*i+0] = mSysData->m_magnets[i].color.x;
-        mcol[4*i+1] = mSysData->m_magnets[i].color.y;
-        mcol[4*i+2] = mSysData->m_magnets[i].color.z;
-        mcol[4*i+3] = mSysData->m_magnets[i].color.w;
+    const std::vector<equilibrium> &minima = mSysData->m_equilibria.Minima();
+    if (eqMinima>0) {
+        glDeleteBuffers(1,&eqMinima);
+    }
+    glGenBuffers(1,&eqMinima);
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, eqMinima );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*std::max(minima.size(),size_t(1))*4, NULL, GL_STREAM_DRAW );
+    if (!minima.empty()) {
+        float *emin = static_cast<float*>(glMapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*minima.size()*4, bufMask));
+        for(unsigned int i=0; i<minima.size(); i++) {
+            emin[4*i+0] = static_cast<float>(minima[i].x);
+            emin[4*i+1] = static_cast<float>(minima[i].y);
+            emin[4*i+2] = static_cast<float>(minima[i].radius);
+            emin[4*i+3] = static_cast<float>(minima[i].magnet);
+        }
+        glUnmapBuffer( GL_SHADER_STORAGE_BUFFER );
+    }
+
+    // ------------------------------------------
+    //  buffer storage for the tabulated field: (U,ax,ay,axy), (axx,ayy,axxy,ayxy)
+    // ------------------------------------------
+    const FieldGrid &grid = table.Grid();
+    int numGridFloats = 8*grid.NumNodes()*grid.NumNodes();
+    if (fieldGrid>0) {
+        glDeleteBuffers(1,&fieldGrid);
+    }
+    glGenBuffers(1,&fieldGrid);
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, fieldGrid );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*std::max(numGridFloats,8), NULL, GL_STREAM_DRAW );
+    if (grid.IsValid()) {
+        float *gdata = static_cast<float*>(glMapBufferRange( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*numGridFloats, bufMask));
+        grid.FillGPUBuffer(gdata);
+        glUnmapBuffer( GL_SHADER_STORAGE_BUFFER );
+    }
+
+    // ------------------------------------------
+    //  buffer storage for the magnet tree: five vec4 per node, magnets in tree order
+    // ------------------------------------------
+    const MagnetTree &tree = table.Tree();
+    int numNodeFloats = 20*tree.NumNodes();
+    int numTreeMagFloats = 4*tree.Size();
+    if (treeNodes>0) {
+        glDeleteBuffers(1,&treeNodes);
+    }
+    if (treeMagnets>0) {
+        glDeleteBuffers(1,&treeMagnets);
+    }
+    glGenBuffers(1,&treeNodes);
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, treeNodes );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*std::max(numNodeFloats,20), NULL, GL_STREAM_DRAW );
+    glGenBuffers(1,&treeMagnets);
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, treeMagnets );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof(float)*std::max(numTreeMagFloats,4), NULL, GL_STREAM_DRAW );
+    if (tree.IsValid()) {
+        std::vector<float> tnodes(numNodeFloats), tmags(numTreeMagFloats);
+        tree.FillGPUBuffers(tnodes.data(),tmags.data());
+        glBindBuffer( GL_SHADER_STORAGE_BUFFER, treeNodes );
+        glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*numNodeFloats, tnodes.data() );
+        glBindBuffer( GL_SHADER_STORAGE_BUFFER, treeMagnets );
+        glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof(float)*numTreeMagFloats, tmags.data() );
+    }
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+    setIntegrationUniforms();
+    glFinish();
+}
+
+/**
+ *  The view shows the whole simulated region, widened in x or y to the
+ *  aspect of the widget.
+ */
+void OpenGL2d::updateViewRegion() {
+    double fw = static_cast<double>(DEF_MAX(width(),1));
+    double fh = static_cast<double>(DEF_MAX(height(),1));
+    double aspect = fw/fh;
+    if (aspect*simRmaxY>=simRmaxX) {
+        mSysData->m_rmaxY = simRmaxY;
+        mSysData->m_rmaxX = simRmaxY * aspect;
+    } else {
+        mSysData->m_rmaxX = simRmaxX;
+        mSysData->m_rmaxY = simRmaxX / aspect;
+    }
+
+    // the line may deviate by half a pixel from the trajectory
+    if (mSysData->SetLineTolerance(mSysData->m_rmaxY/fh)) {
+        uploadLine();
+    }
+}
+
+/**
+ *  The basin map is the block of whole tiles that covers the w x h pixels
+ *  around the view center, which is moved onto the sample lattice. At level
+ *  0 the pixels span the whole elongation in y.
+ */
+void OpenGL2d::setupGrid( int w, int h ) {
+    tileSamples = BASIN_TILE_PIXELS*supersample;
+    double spacing0 = 2.0*mSysData->m_rmax/(h*supersample);
+    gridLattice = BasinTileCache::LatticeHash(mSysData->m_syncedParams,maxTime,spacing0,tileSamples);
+    sampleSpacing = ldexp(spacing0,-zoomLevel);
+
+    double gx = floor(viewX/sampleSpacing + 0.5);
+    double gy = floor(viewY/sampleSpacing + 0.5);
+    viewX = gx*sampleSpacing;
+    viewY = gy*sampleSpacing;
+    simRmaxX = 0.5*w*supersample*sampleSpacing;
+    simRmaxY = 0.5*h*supersample*sampleSpacing;
+
+    gridTileX = static_cast<int>(floor((gx - 0.5*w*supersample)/tileSamples));
+    gridTileY = static_cast<int>(floor((gy - 0.5*h*supersample)/tileSamples));
+    gridTilesX = static_cast<int>(ceil((gx + 0.5*w*supersample)/tileSamples)) - gridTileX;
+    gridTilesY = static_cast<int>(ceil((gy + 0.5*h*supersample)/tileSamples)) - gridTileY;
+    particleWidth  = gridTilesX*tileSamples;
+    particleHeight = gridTilesY*tileSamples;
+    numParticles = particleWidth*particleHeight;
+    gridStored = false;
+}
+
+/**
+ *  Copy the tiles of the grid that the cache knows into the first display
+ *  textures.
+ * @param known  Set for every tile that was found, row by row.
+ */
+void OpenGL2d::loadTiles( std::vector<char> &known ) {
+    known.assign(gridTilesX*gridTilesY,0);
+    std::vector<unsigned short> cls(numParticles,0);
+    std::vector<float> time(numParticles,0.0f);
+    int numKnown = 0;
+    for(int ty=0; ty<gridTilesY; ty++) {
+        for(int tx=0; tx<gridTilesX; tx++) {
+            basinTileKey key = { gridLattice, zoomLevel, gridTileX + tx, gridTileY + ty };
+            int offset = ty*tileSamples*particleWidth + tx*tileSamples;
+            if (mTileCache.Find(key,tileSamples,&cls[offset],&time[offset],particleWidth)) {
+                known[ty*gridTilesX + tx] = 1;
+                numKnown++;
+            }
+        }
+    }
+    if (numKnown==0) {
+        return;
+    }
+    fprintf(stderr,"%d of %d tiles taken from the cache\n",numKnown,gridTilesX*gridTilesY);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT,2);
+    glBindTexture( GL_TEXTURE_2D, displayTex[0][0] );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, particleWidth, particleHeight, GL_RED_INTEGER, GL_UNSIGNED_SHORT, &cls[0] );
+    glBindTexture( GL_TEXTURE_2D, displayTex[0][1] );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, particleWidth, particleHeight, GL_RED, GL_FLOAT, &time[0] );
+    glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+    glBindTexture( GL_TEXTURE_2D, 0 );
+}
+
+/**
+ *  Put the finished tiles of the compute shader into the cache; a tile is
+ *  finished if all stages were activated and none of its pixels is in the
+ *  active list. Called with the particle thread paused or by the particle
+ *  thread itself. Without compute shaders, fetchTiles() stores the tiles of
+ *  the CPU.
+ */
+void OpenGL2d::storeTiles() {
+    if (!haveCompute || particles==0 || gridStored || nextStage<PROGRESSIVE_STAGES) {
+        return;
+    }
+    GLuint count = 0;
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, activeList[currActive] );
+    glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 3*sizeof(GLuint), sizeof(GLuint), &count );
+    std::vector<GLuint> active(count+1);
+    if (count>0) {
+        glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 4*sizeof(GLuint), sizeof(GLuint)*count, &active[0] );
     }
-    glUnmapBuffer( GL_SHADER_STORAGE_BUFFER );
     glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
-#endif // HAVE_COMP_SHADER
-    mSysData->m_numSteps = 0;
+
+    std::vector<char> open(gridTilesX*gridTilesY,0);
+    for(GLuint i=0; i<count; i++) {
+        int px = active[i] % particleWidth;
+        int py = active[i] / particleWidth;
+        open[(py/tileSamples)*gridTilesX + px/tileSamples] = 1;
+    }
+    if (std::find(open.begin(),open.end(),0)==open.end()) {
+        return;
+    }
+
+    std::vector<unsigned short> cls(numParticles);
+    std::vector<float> time(numParticles);
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    glPixelStorei(GL_PACK_ALIGNMENT,2);
+    glBindTexture( GL_TEXTURE_2D, basinTex[0] );
+    glGetTexImage( GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, &cls[0] );
+    glBindTexture( GL_TEXTURE_2D, basinTex[1] );
+    glGetTexImage( GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, &time[0] );
+    glPixelStorei(GL_PACK_ALIGNMENT,4);
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    for(int ty=0; ty<gridTilesY; ty++) {
+        for(int tx=0; tx<gridTilesX; tx++) {
+            if (!open[ty*gridTilesX + tx]) {
+                basinTileKey key = { gridLattice, zoomLevel, gridTileX + tx, gridTileY + ty };
+                int offset = ty*tileSamples*particleWidth + tx*tileSamples;
+                mTileCache.Insert(key,tileSamples,&cls[offset],&time[offset],particleWidth);
+            }
+        }
+    }
+    gridStored = (count==0);
+}
+
+/**
+ *  Progressive schedule: the samples of the tiles that are not in the cache
+ *  are integrated coarse to fine, so a preview of the whole map, upscaled by
+ *  quad.frag, is there after a sixteenth of the work.
+ *    stage 0:    level 0, every fourth sample in x and y
+ *    stage 1,2:  level 1, the other samples with even x and y
+ *    stage 3,4:  level 2, the samples with an odd x or y
+ *  A sample of level 1 or 2 lies in a cell of the coarser lattice. If the
+ *  corners of the cell are finished and captured by the same magnet, the
+ *  cell is taken as uniform and its samples wait for the second stage of
+ *  the level; the others come first, they hold the basin boundaries.
+ *  Called by IntegrateFrame() when few samples are left in the active list.
+ * @param count  Samples in the active list.
+ * @return samples in the active list with those of the stage.
+ */
+GLuint OpenGL2d::activateStage( GLuint count ) {
+    int stage = nextStage++;
+    std::vector<GLuint> pixels;
+    if (stage%2==0) {
+        pixels.swap(deferred);
+    } else {
+        int level = (stage+1)/2;
+        std::vector<unsigned short> cls(numParticles);
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+        glPixelStorei(GL_PACK_ALIGNMENT,2);
+        glBindTexture( GL_TEXTURE_2D, basinTex[0] );
+        glGetTexImage( GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, &cls[0] );
+        glPixelStorei(GL_PACK_ALIGNMENT,4);
+        glBindTexture( GL_TEXTURE_2D, 0 );
+
+        for(int py=0; py<particleHeight; py++) {
+            const char *row = &tileKnown[(py/tileSamples)*gridTilesX];
+            for(int px=0; px<particleWidth; px++) {
+                if (row[px/tileSamples] || sampleLevel(px,py)!=level) {
+                    continue;
+                }
+                if (uniformCell(px,py,level,&cls[0])) {
+                    deferred.push_back(py*particleWidth + px);
+                } else {
+                    pixels.push_back(py*particleWidth + px);
+                }
+            }
+        }
+    }
+    if (pixels.empty()) {
+        return count;
+    }
+
+    // the shader appends behind 'count', the header is for the next dispatch
+    GLuint header[4] = { 0, 1, 1, count + static_cast<GLuint>(pixels.size()) };
+    header[0] = (header[3] + 127)/128;
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, activeList[currActive] );
+    glBufferSubData( GL_SHADER_STORAGE_BUFFER, sizeof(GLuint)*(4+count), sizeof(GLuint)*pixels.size(), &pixels[0] );
+    glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), header );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+    numPending -= static_cast<long>(pixels.size());
+    return header[3];
+}
+
+/**
+ *  Level of a sample in the progressive schedule, see activateStage().
+ */
+int OpenGL2d::sampleLevel( int px, int py ) const {
+    if (((px | py) & 3)==0) {
+        return 0;
+    }
+    return (((px | py) & 1)==0 ? 1 : 2);
+}
+
+/**
+ *  Whether the corners of the cell of the coarser lattice around a sample
+ *  of 'level' are finished and of the same class. Corners beyond the grid
+ *  are left out; tiles are whole multiples of the cell.
+ */
+bool OpenGL2d::uniformCell( int px, int py, int level, const unsigned short *cls ) const {
+    int step = (level==1 ? 4 : 2);
+    int x0 = px & ~(step-1);
+    int y0 = py & ~(step-1);
+    unsigned short first = cls[y0*particleWidth + x0];
+    if ((first & BASIN_CLASS_DECIDED)==0) {
+        return false;
+    }
+    for(int y=y0; y<=DEF_MIN(y0+step,particleHeight-1); y+=step) {
+        for(int x=x0; x<=DEF_MIN(x0+step,particleWidth-1); x+=step) {
+            if (cls[y*particleWidth + x]!=first) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ *  Zoom by a factor of two per level; the position under the mouse stays.
+ */
+void OpenGL2d::zoomView( int px, int py, int levels ) {
+    int level = DEF_MAX(ZOOM_LEVEL_MIN,DEF_MIN(zoomLevel + levels,ZOOM_LEVEL_MAX));
+    if (level==zoomLevel) {
+        return;
+    }
+    double mx,my;
+    pixelToPos(px,py,mx,my);
+    double f = ldexp(1.0,zoomLevel - level);
+    viewX = mx + (viewX - mx)*f;
+    viewY = my + (viewY - my)*f;
+    zoomLevel = level;
+    resetParticleStorage();
+    updateGL();
 }
 
 /**
@@ -878,6 +1811,6 @@ void  OpenGL2d::resetParticleStorage() {
  * @param y
  */
 void OpenGL2d::pixelToPos( int px, int py, double &x, double &y ) {
-    x = (px - width()/2)/static_cast<double>(width()) * mSysData->m_rmaxX * 2.0;
-    y = (height()/2 - py)/static_cast<double>(height()) * mSysData->m_rmaxY * 2.0;
+    x = viewX + (px - width()/2)/static_cast<double>(width()) * mSysData->m_rmaxX * 2.0;
+    y = viewY + (height()/2 - py)/static_cast<double>(height()) * mSysData->m_rmaxY * 2.0;
 }
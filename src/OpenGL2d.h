@@ -13,6 +13,8 @@
 #ifndef MPSIM_OPENGL_2D_H
 #define MPSIM_OPENGL_2D_H
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <vector>
 
@@ -21,13 +23,21 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "BasinService.h"
+#include "BasinTileCache.h"
 #include "GLShader.h"
 #include <SystemData.h>
 
 #include <QGLWidget>
 #include <QGLFormat>
 #include <QMap>
+#include <QMutex>
 #include <QScriptEngine>
+#include <QWaitCondition>
+
+class ParticleThread;
+
+#define LINE_NUM_SLOTS  3
 
 /**
   *  @brief OpenGL render engine.
@@ -51,19 +61,37 @@ public:
     void  AddObjectsToScriptEngine ( QScriptEngine* engine );   //!< Add this object to the script engine.
     void  GrabWindow( QString filename );
     void  ResetParticleSimulation();
+    bool  HasComputeShader() const;     //!< false if the CPU renders the basin map
+    int   NumActiveParticles() const;   //!< pixels that are not trapped yet
+    int   NumSteps() const;             //!< integration steps since the last reset
+    double TimeLeft() const;            //!< estimated seconds until the CPU basin map is finished, negative if unknown
+    double MaxTime() const;             //!< maximum integration time of a pixel and of a trajectory
+
+    void  SetSimulationPlaying( bool play );   //!< Integrate on the particle thread or stop.
+    bool  IsSimulationPlaying();
+    void  StepSimulation();                    //!< Integrate a single frame.
+
+    /** Integrate one frame and hand it over to paintGL(). Called by the
+     *  ParticleThread with its shared context current.
+     * @return true if there are pixels left to integrate.
+     */
+    bool  IntegrateFrame();
 
     bool CreateFBO( int width, int height );  //!< Create framebuffer object.
     void DeleteFBO();                         //!< Delete framebuffer object.
 
 
 public slots:
-    void  particleStep();
     void  SetMaxNumPoints( int maxNumPoints );
     void  UpdateTraj();
 
 signals:
     void magnetMoved(int);
 
+private slots:
+    void  fetchTiles();   //!< Upload the tiles the CPU has finished.
+    void  fetchPreview(); //!< Upload the tiles of the preview while a magnet is dragged.
+
 protected:   
     virtual void initializeGL();             //!< Initialize OpenGL rendering.
     virtual void paintGL();                  //!< Main rendering method.
@@ -74,11 +102,32 @@ protected:
     virtual void mouseMoveEvent( QMouseEvent* event );     //!< Evaluate mouse move event.
     virtual void mousePressEvent( QMouseEvent* event );    //!< Evaluate mouse press event.
     virtual void mouseReleaseEvent( QMouseEvent* event );  //!< Evaluate mouse release event.
+    virtual void wheelEvent( QWheelEvent* event );         //!< Zoom in or out around the mouse position.
 
     bool  isExtensionAvailable( const char* extName );
     void  createShaders();   //!< Create basic shaders for grid, axis, and objects rendering.
-
+    bool  createPendIntShader();   //!< Create integration shader for the current force law.
+    bool  createActiveListShader();
+
+    void  reserveLine( int numPoints );
+    void  newBasinTextures( GLuint *tex, int w, int h );
+    void  uploadTile( const GLuint *tex, const basinTileData &data );
+    void  drawBasin( const glm::mat4 &mvp, const GLuint *tex, int samples, bool overlay );
+    void  requestPreview();
+    void  uploadLine();
+    void  updateViewRegion();
     void  resetParticleStorage();
+    void  resetComputeStorage( const std::vector<char> &known );
+    void  setupGrid( int w, int h );
+    void  loadTiles( std::vector<char> &known );
+    void  storeTiles();
+    GLuint activateStage( GLuint count );
+    int   sampleLevel( int px, int py ) const;
+    bool  uniformCell( int px, int py, int level, const unsigned short *cls ) const;
+    void  zoomView( int px, int py, int levels );
+    void  setIntegrationUniforms();
+    void  publishFrame();
+    void  adaptStepsPerFrame( double elapsed );   //!< integration time of the last frame in ms
     void  pixelToPos( int px, int py, double &x, double &y );
 
 private:
@@ -92,11 +141,12 @@ private:
     QString   mQuadVertShaderName;
     QString   mQuadFragShaderName;
 
-    GLShader  mPendShader;
     GLShader  mPendIntShader;
-    QString   mPendVertShaderName;
-    QString   mPendFragShaderName;
     QString   mPendCompShaderName;
+    int       mPendIntLaw;       //!< force law the integration shader was built for
+
+    GLShader  mActiveListShader;
+    QString   mActiveListShaderName;
 
     GLShader  mMagnetShader;
     QString   mMagnetVertShaderName;
@@ -110,15 +160,84 @@ private:
     // Framebuffer for 'periodic boundary rendering'
     GLuint m_fbo,m_rbo,m_fboTexture;
     GLuint vaQuad, vboQuad;
+    // Trajectory line: a ring of LINE_NUM_SLOTS slots of lineSlotSize (x,y) points.
+    // Every upload goes into the next slot, whose last draw is fenced.
     GLuint vaLine, vboLine;
-    GLuint posSSbo[2], posInit;
-    GLuint rkStep,timeID, posMag, colMag;
-    int    currSbo,nextSbo,numParticles;
-
-    GLuint vaPoints,vboPoints;
+    float* lineMap;            //!< persistent mapping of vboLine, NULL without buffer storage
+    int    lineSlotSize;
+    int    lineSlot;           //!< slot of the current trajectory
+    int    lineNumPoints;      //!< vertices of the simplified line in that slot
+    GLsync lineFence[LINE_NUM_SLOTS];
+    bool   haveBufferStorage;
+    GLuint particles;          //!< one packed record per pixel, see pendulum.comp
+    GLuint posMag, palette, paletteTex;
+    GLuint eqMinima, fieldGrid;
+    GLuint treeNodes, treeMagnets;
+    int    numParticles, particleWidth, particleHeight;
+    int    supersample;        //!< samples per pixel and direction in effect
+    double simRmaxX, simRmaxY; //!< half size of the simulated region, the view shows it scaled
+
+    // Pan and zoom: the basin map is a block of gridTilesX x gridTilesY tiles
+    // of the sample lattice of 'zoomLevel', see BasinTileCache, that covers
+    // the simulated region around (viewX,viewY).
+    BasinTileCache  mTileCache;
+    int    zoomLevel;
+    double viewX, viewY;       //!< center of the view, a sample of the lattice
+    double sampleSpacing;
+    unsigned long long  gridLattice;
+    int    gridTileX, gridTileY;   //!< lower left tile
+    int    gridTilesX, gridTilesY;
+    int    tileSamples;        //!< edge length of a tile in samples
+    bool   gridStored;         //!< all tiles of the grid are in the cache
+    bool   panning;
+    QPoint panStart;
+    double panViewX, panViewY;
+    GLuint activeList[2];      //!< dispatch header and pixel indices, see activelist.comp
+    int    currActive;
+    std::atomic<int>  numActive, numSteps;   //!< numActive includes the samples of later stages
+
+    // Progressive schedule of the compute shader, see activateStage()
+    std::vector<char>    tileKnown;   //!< tiles taken from the cache, row by row
+    std::vector<GLuint>  deferred;    //!< samples in uniform cells, activated by the next stage
+    int    nextStage;
+    long   numPending;         //!< samples that are not activated yet
+
+    GLuint basinTex[2];        //!< class (R16UI) and time (R16F) per pixel, written by pendulum.comp
+
+    // Hand-over of the basin map from the particle thread to paintGL: the
+    // thread copies basinTex into the pair that is not 'displayFront' and
+    // fences the copy; paintGL fences its draw, which the next copy waits for.
+    // Without compute shaders, the BasinService renders the map tile by tile
+    // into displayTex[0] and there is no particle thread.
+    bool             haveCompute;
+    BasinService     mBasinService;
+    ParticleThread*  mParticleThread;
+    GLuint  displayTex[2][2];
+    GLsync  displayFence[2];
+    GLsync  drawFence[2];
+    int     displayFront;       //!< last published buffer, -1 if none
+    int     displayDrawing;     //!< buffer paintGL is reading from, -1 if none
+    QMutex          displayMutex;
+    QWaitCondition  displayDone;
+
+    // Preview while a magnet is dragged: a second BasinService renders the
+    // view at about 'previewPixels' pixels, which follow the time a preview
+    // takes. The basin map of the old positions is stopped meanwhile.
+    BasinService  mPreviewService;
+    basinGrid     previewGrid;      //!< pixels and region of previewTex
+    GLuint  previewTex[2];
+    double  previewPixels;
+    std::chrono::steady_clock::time_point  previewStart;
+    bool    draggingMagnet;
+    bool    previewShown;       //!< the preview is drawn below the basin map
 
     glm::vec3 initColor;
     float     hInit;
+    float     maxTime;
+
+    int       stepsPerDispatch;
+    int       dispatchesPerFrame;
+    double    frameBudget;          //!< time per frame for the integration in ms
     int  activeMagnet;
 };
 
@@ -328,7 +328,6 @@ void OpenGL3d::mouseMoveEvent( QMouseEvent * event ) {
         }
         mSysData->m_currAnimTime = 0.0;
         mSysData->m_currIndex = 0;
-        emit updateTraj();
         updateGL();
     } else {
         switch (mButtonPressed)
@@ -57,7 +57,6 @@ public slots:
 
 signals:
     void  magnetMoved(int);
-    void  updateTraj();
 
 protected:   
     virtual void initializeGL();             //!< Initialize OpenGL rendering.
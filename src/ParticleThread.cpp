@@ -0,0 +1,122 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file ParticleThread.cpp
+*/
+
+#include "OpenGL2d.h"
+#include "ParticleThread.h"
+
+#include <QMutexLocker>
+
+
+ParticleThread::ParticleThread( OpenGL2d* view ) :
+    m_view(view),
+    m_glWidget(NULL),
+    m_play(false),
+    m_busy(false),
+    m_quit(false),
+    m_numPaused(0),
+    m_numRequested(0)
+{
+    m_glWidget = new QGLWidget(view->format(),NULL,view);
+    if (!m_glWidget->isSharing()) {
+        fprintf(stderr,"ParticleThread: cannot share the OpenGL context.\n");
+    }
+    m_glWidget->doneCurrent();
+#if QT_VERSION >= 0x050000
+    m_glWidget->context()->moveToThread(this);
+#endif
+    view->makeCurrent();
+}
+
+ParticleThread::~ParticleThread() {
+    Quit();
+    delete m_glWidget;
+}
+
+void ParticleThread::SetPlaying( bool play ) {
+    QMutexLocker locker(&m_mutex);
+    m_play = play;
+    m_wake.wakeAll();
+}
+
+bool ParticleThread::IsPlaying() {
+    QMutexLocker locker(&m_mutex);
+    return m_play;
+}
+
+void ParticleThread::RequestFrame() {
+    QMutexLocker locker(&m_mutex);
+    m_numRequested++;
+    m_wake.wakeAll();
+}
+
+void ParticleThread::Pause() {
+    QMutexLocker locker(&m_mutex);
+    m_numPaused++;
+    while (m_busy) {
+        m_idle.wait(&m_mutex);
+    }
+}
+
+void ParticleThread::Resume() {
+    QMutexLocker locker(&m_mutex);
+    if (m_numPaused>0) {
+        m_numPaused--;
+    }
+    m_wake.wakeAll();
+}
+
+void ParticleThread::Quit() {
+    if (!isRunning()) {
+        return;
+    }
+    m_mutex.lock();
+    m_quit = true;
+    m_wake.wakeAll();
+    m_mutex.unlock();
+    wait();
+}
+
+// *********************************** protected methods ******************************
+
+/**
+ *  The lock is released while a frame is integrated; Pause() waits for the
+ *  frame to finish. A frame that leaves no active pixel stops the thread.
+ */
+void ParticleThread::run() {
+    m_glWidget->makeCurrent();
+
+    m_mutex.lock();
+    while (!m_quit) {
+        if (m_numPaused>0 || (!m_play && m_numRequested==0)) {
+            m_wake.wait(&m_mutex);
+            continue;
+        }
+        if (m_numRequested>0) {
+            m_numRequested--;
+        }
+        m_busy = true;
+        m_mutex.unlock();
+
+        bool active = m_view->IntegrateFrame();
+
+        m_mutex.lock();
+        m_busy = false;
+        if (!active) {
+            m_play = false;
+            m_numRequested = 0;
+        }
+        m_idle.wakeAll();
+        emit frameReady();
+    }
+    m_mutex.unlock();
+
+    m_glWidget->doneCurrent();
+}
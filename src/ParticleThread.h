@@ -0,0 +1,81 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the particle simulation thread.
+    @file ParticleThread.h
+*/
+
+#ifndef MPSIM_PARTICLE_THREAD_H
+#define MPSIM_PARTICLE_THREAD_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+class OpenGL2d;
+class QGLWidget;   // QGLWidget pulls in gl.h, which must come after gl3w
+
+/**
+ * @brief The ParticleThread class
+ *
+ *  Runs the GPU integration of the basin map off the GUI thread. The thread
+ *  owns a hidden QGLWidget whose context shares all buffers and programs with
+ *  the OpenGL2d view, and calls OpenGL2d::IntegrateFrame() as long as it is
+ *  running. Every frame ends with a fenced copy of the class and time
+ *  textures of the basin map (basinTex) into the pair of displayTex that the
+ *  view does not draw from (see OpenGL2d::paintGL), so the GUI never waits
+ *  for the integration.
+ *
+ *  The GUI thread has to Pause() the thread before it creates or deletes any
+ *  of the shared objects, and Resume() it afterwards.
+ */
+class ParticleThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    /** The shared context is created here, so this has to be called from the
+     *  GUI thread once the context of 'view' exists.
+     */
+    ParticleThread( OpenGL2d* view );
+    ~ParticleThread();
+
+public:
+    void  SetPlaying( bool play );   //!< Integrate frames continuously or stop.
+    bool  IsPlaying();
+    void  RequestFrame();               //!< Integrate a single frame.
+
+    /** Block until the current frame is done and keep the thread idle until
+     *  Resume(). Calls may be nested.
+     */
+    void  Pause();
+    void  Resume();
+
+    void  Quit();   //!< Stop the thread and wait for it.
+
+signals:
+    void  frameReady();   //!< A new frame was handed over to the view.
+
+protected:
+    virtual void run();
+
+private:
+    OpenGL2d*   m_view;
+    QGLWidget*  m_glWidget;   //!< never shown, provides the shared context
+
+    QMutex          m_mutex;
+    QWaitCondition  m_wake;   //!< work or quit requested
+    QWaitCondition  m_idle;   //!< frame finished
+    bool  m_play;
+    bool  m_busy;
+    bool  m_quit;
+    int   m_numPaused;
+    int   m_numRequested;
+};
+
+#endif // MPSIM_PARTICLE_THREAD_H
@@ -0,0 +1,197 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file PendulumParams.cpp
+*/
+
+#include "PendulumParams.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifndef DEG_TO_RAD
+#define DEG_TO_RAD  0.017453292519943295770
+#endif
+
+
+PendulumParams::PendulumParams() {
+    ResetParams();
+    SetDefaultMagnets();
+}
+
+/**
+ *  Same default values as SystemData::ResetParams.
+ */
+void PendulumParams::ResetParams() {
+    m_pendulumHeight = 2.02;
+    m_pendulumLength = 2.0;
+    m_gravity = 9.81;
+    m_damping = 1.0;
+    m_kappa = 1.0;
+    m_magFactor = 0.01;
+    m_magnetRadius = 0.0;
+    m_maxTheta = 5.0;
+    m_fieldGrid = 0;
+    m_treeTheta = 0.0;
+    m_integrator = RK_CASH_KARP;
+}
+
+void PendulumParams::SetDefaultMagnets() {
+    magnetParams mp1 = { -0.03, -0.03, 0.0, 1.0, {1.0f,0.0f,0.0f,1.0f} };
+    magnetParams mp2 = {  0.03, -0.03, 0.0, 1.0, {0.0f,1.0f,0.0f,1.0f} };
+    magnetParams mp3 = {  0.0, 0.03*sqrt(2.0), 0.0, 1.0, {0.0f,0.0f,1.0f,1.0f} };
+    m_magnets.clear();
+    m_magnets.push_back(mp1);
+    m_magnets.push_back(mp2);
+    m_magnets.push_back(mp3);
+}
+
+/**
+ *  The keys are evaluated exactly like in SystemData::LoadParams. In particular,
+ *  'damping' is stored in kappa because SystemData::SaveParams writes kappa under
+ *  that key; otherwise the headless renderer would not reproduce the GUI maps.
+ */
+bool PendulumParams::LoadParams( const char* filename ) {
+    std::ifstream fin(filename);
+    if (!fin.is_open()) {
+        fprintf(stderr,"Cannot read parameter file %s\n",filename);
+        return false;
+    }
+
+    m_magnets.clear();
+
+    std::string line;
+    while (std::getline(fin,line)) {
+        if (line.empty() || line[0]=='#') {
+            continue;
+        }
+        std::istringstream iss(line);
+        std::vector<std::string> sepLine;
+        std::string item;
+        while (iss >> item) {
+            sepLine.push_back(item);
+        }
+        if (sepLine.size()<2) {
+            continue;
+        }
+
+        if (sepLine[0].compare("pendulumHeight")==0) {
+            m_pendulumHeight = atof(sepLine[1].c_str());
+        }
+        else if (sepLine[0].compare("pendulumLength")==0) {
+            m_pendulumLength = atof(sepLine[1].c_str());
+        }
+        else if (sepLine[0].compare("gravity")==0) {
+            m_gravity = atof(sepLine[1].c_str());
+        }
+        else if (sepLine[0].compare("damping")==0) {
+            m_kappa = atof(sepLine[1].c_str());
+        }
+        else if (sepLine[0].compare("magFactor")==0) {
+            m_magFactor = atof(sepLine[1].c_str());
+        }
+        else if (sepLine[0].compare("maxTheta")==0) {
+            m_maxTheta = atof(sepLine[1].c_str());
+        }
+        else if (sepLine[0].compare("magnetRadius")==0) {
+            m_magnetRadius = atof(sepLine[1].c_str());
+        }
+        else if (sepLine[0].compare("fieldGrid")==0) {
+            m_fieldGrid = atoi(sepLine[1].c_str());
+        }
+        else if (sepLine[0].compare("treeTheta")==0) {
+            m_treeTheta = atof(sepLine[1].c_str());
+        }
+        else if (sepLine[0].compare("integrator")==0) {
+            if (!RKMethodFromName(sepLine[1].c_str(),m_integrator)) {
+                fprintf(stderr,"Unknown integrator %s\n",sepLine[1].c_str());
+            }
+        }
+        else if (sepLine[0].compare("magnet")==0 && sepLine.size()>6) {
+            magnetParams mp;
+            // SystemData keeps magnet data in single precision
+            mp.x = static_cast<float>(atof(sepLine[1].c_str()));
+            mp.y = static_cast<float>(atof(sepLine[2].c_str()));
+            mp.z = 0.0;
+            mp.alpha = static_cast<float>(atof(sepLine[6].c_str()));
+            mp.color[0] = static_cast<float>(atof(sepLine[3].c_str()));
+            mp.color[1] = static_cast<float>(atof(sepLine[4].c_str()));
+            mp.color[2] = static_cast<float>(atof(sepLine[5].c_str()));
+            mp.color[3] = 1.0f;
+            m_magnets.push_back(mp);
+        }
+    }
+    fin.close();
+
+    if (m_magnets.size()<1) {
+        SetDefaultMagnets();
+    }
+    return true;
+}
+
+double PendulumParams::RMax() const {
+    return m_pendulumLength*sin(m_maxTheta*DEG_TO_RAD);
+}
+
+/**
+ *  FNV-1a over the bytes of the parameters.
+ */
+unsigned long long PendulumParams::Hash() const {
+    std::vector<double> values;
+    values.push_back(m_pendulumLength);
+    values.push_back(m_pendulumHeight);
+    values.push_back(m_gravity);
+    values.push_back(m_damping);
+    values.push_back(m_kappa);
+    values.push_back(m_magFactor);
+    values.push_back(m_magnetRadius);
+    values.push_back(m_maxTheta);
+    values.push_back(m_fieldGrid);
+    values.push_back(m_treeTheta);
+    values.push_back(static_cast<double>(m_integrator));
+    for(unsigned int i=0; i<m_magnets.size(); i++) {
+        values.push_back(m_magnets[i].x);
+        values.push_back(m_magnets[i].y);
+        values.push_back(m_magnets[i].z);
+        values.push_back(m_magnets[i].alpha);
+    }
+
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&values[0]);
+    for(size_t i=0; i<values.size()*sizeof(double); i++) {
+        hash = (hash ^ bytes[i])*1099511628211ULL;
+    }
+    return hash;
+}
+
+bool PendulumParams::operator==( const PendulumParams &other ) const {
+    if (m_pendulumLength!=other.m_pendulumLength || m_pendulumHeight!=other.m_pendulumHeight ||
+        m_gravity!=other.m_gravity || m_damping!=other.m_damping || m_kappa!=other.m_kappa ||
+        m_magFactor!=other.m_magFactor || m_magnetRadius!=other.m_magnetRadius || m_maxTheta!=other.m_maxTheta ||
+        m_fieldGrid!=other.m_fieldGrid || m_treeTheta!=other.m_treeTheta ||
+        m_integrator!=other.m_integrator || m_magnets.size()!=other.m_magnets.size()) {
+        return false;
+    }
+    for(unsigned int i=0; i<m_magnets.size(); i++) {
+        const magnetParams &a = m_magnets[i];
+        const magnetParams &b = other.m_magnets[i];
+        if (a.x!=b.x || a.y!=b.y || a.z!=b.z || a.alpha!=b.alpha ||
+            memcmp(a.color,b.color,sizeof(a.color))!=0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PendulumParams::operator!=( const PendulumParams &other ) const {
+    return !(*this==other);
+}
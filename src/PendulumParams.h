@@ -0,0 +1,78 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the Qt-free pendulum parameter set.
+    @file PendulumParams.h
+*/
+
+#ifndef MPSIM_PENDULUM_PARAMS_H
+#define MPSIM_PENDULUM_PARAMS_H
+
+#include <cstdio>
+#include <vector>
+
+#include "RKStepper.h"
+
+typedef struct magnetParams_t {
+    double x, y, z;
+    double alpha;
+    float  color[4];
+} magnetParams;
+
+
+/**
+ * @brief The PendulumParams class
+ *
+ *  Plain copy of the physical parameters held by SystemData. It does not depend
+ *  on Qt and can therefore be used by the headless basin renderer. The parameter
+ *  file format is the same as for SystemData::LoadParams.
+ */
+class PendulumParams
+{
+public:
+    PendulumParams();
+
+public:
+    void   ResetParams();
+    void   SetDefaultMagnets();
+
+    /** Load parameters from file.
+     * @param filename  Name of parameter file (*.par).
+     * @return true if file could be read.
+     */
+    bool   LoadParams( const char* filename );
+
+    /** Maximum elongation of the bob in the x-y plane.
+     */
+    double RMax() const;
+
+    /** Hash of the parameters that change the motion of the bob; the
+     *  colors of the magnets do not count.
+     */
+    unsigned long long  Hash() const;
+
+    bool   operator==( const PendulumParams &other ) const;
+    bool   operator!=( const PendulumParams &other ) const;
+
+public:
+    double  m_pendulumLength;
+    double  m_pendulumHeight;
+    double  m_gravity;
+    double  m_damping;
+    double  m_kappa;
+    double  m_magFactor;
+    double  m_magnetRadius;   //!< finite-size magnets, see MagnetTable
+    double  m_maxTheta;
+    int     m_fieldGrid;      //!< nodes per axis of the tabulated field, 0 = exact sum
+    double  m_treeTheta;      //!< opening angle of the magnet tree, 0 = exact sum
+    rkMethod  m_integrator;
+
+    std::vector<magnetParams>  m_magnets;
+};
+
+#endif // MPSIM_PENDULUM_PARAMS_H
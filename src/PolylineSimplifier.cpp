@@ -0,0 +1,139 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file PolylineSimplifier.cpp
+*/
+
+#include "PolylineSimplifier.h"
+
+#include <cmath>
+
+#define DEF_MAX(x,y)  ((x)>(y)?(x):(y))
+#define DEF_MIN(x,y)  ((x)<(y)?(x):(y))
+
+
+PolylineSimplifier::PolylineSimplifier() :
+    m_eps(0.0)
+{
+    Clear();
+}
+
+PolylineSimplifier::~PolylineSimplifier() {
+}
+
+void PolylineSimplifier::SetTolerance( double eps ) {
+    m_eps = DEF_MAX(eps,0.0);
+}
+
+double PolylineSimplifier::Tolerance() const {
+    return m_eps;
+}
+
+void PolylineSimplifier::Clear() {
+    m_points.clear();
+    m_ax = m_ay = m_lx = m_ly = 0.0;
+    m_open = m_haveDir = false;
+    m_dx = 1.0;
+    m_dy = 0.0;
+    m_lo = m_hi = 0.0;
+    m_maxDist = 0.0;
+    m_numInput = 0;
+}
+
+void PolylineSimplifier::Add( double x, double y ) {
+    m_numInput++;
+    if (m_points.empty()) {
+        keep(x,y);
+        return;
+    }
+
+    double px = x - m_ax;
+    double py = y - m_ay;
+    double d = sqrt(px*px + py*py);
+    if (d<=m_eps) {
+        // inside the disk around A: close to every segment that starts at A
+        if (!m_haveDir || m_maxDist-d<=m_eps) {
+            m_lx = x;
+            m_ly = y;
+            m_open = true;
+            return;
+        }
+    }
+    else if (!m_haveDir) {
+        double half = asin(m_eps/d);
+        m_dx = px/d;
+        m_dy = py/d;
+        m_lo = -half;
+        m_hi = half;
+        m_maxDist = d;
+        m_haveDir = true;
+        m_lx = x;
+        m_ly = y;
+        m_open = true;
+        return;
+    }
+    else {
+        double ang = atan2(m_dx*py - m_dy*px, m_dx*px + m_dy*py);
+        if (ang>=m_lo && ang<=m_hi && d>=m_maxDist-m_eps) {
+            double half = asin(m_eps/d);
+            m_lo = DEF_MAX(m_lo,ang-half);
+            m_hi = DEF_MIN(m_hi,ang+half);
+            m_maxDist = DEF_MAX(m_maxDist,d);
+            m_lx = x;
+            m_ly = y;
+            return;
+        }
+    }
+
+    // (x,y) does not fit: the open segment ends at the previous point
+    keep(m_lx,m_ly);
+    m_numInput--;
+    Add(x,y);
+}
+
+void PolylineSimplifier::Simplify( const TrajectoryStore &store, int num ) {
+    Clear();
+    double y[4];
+    for(int i=0; i<num && i<store.NumNodes(); i++) {
+        store.State(i,y);
+        Add(y[0],y[1]);
+    }
+}
+
+int PolylineSimplifier::NumInput() const {
+    return m_numInput;
+}
+
+int PolylineSimplifier::NumPoints() const {
+    return static_cast<int>(m_points.size()/2) + (m_open ? 1 : 0);
+}
+
+void PolylineSimplifier::CopyPoints( float *xy ) const {
+    for(unsigned int i=0; i<m_points.size(); i++) {
+        *(xy++) = m_points[i];
+    }
+    if (m_open) {
+        *(xy++) = static_cast<float>(m_lx);
+        *(xy++) = static_cast<float>(m_ly);
+    }
+}
+
+// *********************************** protected methods ******************************
+
+/**
+ *  Keep (x,y) as vertex and start a new segment there.
+ */
+void PolylineSimplifier::keep( double x, double y ) {
+    m_points.push_back(static_cast<float>(x));
+    m_points.push_back(static_cast<float>(y));
+    m_ax = x;
+    m_ay = y;
+    m_open = false;
+    m_haveDir = false;
+    m_maxDist = 0.0;
+}
@@ -0,0 +1,77 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the incremental polyline simplification.
+    @file PolylineSimplifier.h
+*/
+
+#ifndef MPSIM_POLYLINE_SIMPLIFIER_H
+#define MPSIM_POLYLINE_SIMPLIFIER_H
+
+#include <vector>
+
+#include "TrajectoryStore.h"
+
+/**
+ * @brief The PolylineSimplifier class
+ *
+ *  Streaming simplification of a polyline with the sector bound of Zhao and
+ *  Saalfeld. Starting from the last kept vertex A, every further point P at
+ *  distance d restricts the directions of the next segment to the cone of
+ *  half-angle asin(eps/d) around A->P. As long as the direction of a new
+ *  point lies inside the intersection of all cones, the point may end the
+ *  segment; otherwise the previous point is kept and becomes the new A.
+ *  A point that falls back behind the farthest one starts a new segment too.
+ *
+ *  Every dropped point thus stays within about eps of the line, and each
+ *  point is looked at once, so the line can be extended while the
+ *  trajectory is integrated. With eps at half a pixel, the number of kept
+ *  vertices depends on the screen resolution, not on the number of steps.
+ */
+class PolylineSimplifier
+{
+public:
+    PolylineSimplifier();
+    ~PolylineSimplifier();
+
+public:
+    void   SetTolerance( double eps );
+    double Tolerance() const;
+
+    void   Clear();
+    void   Add( double x, double y );
+
+    /** Simplify the first 'num' nodes of a trajectory from scratch.
+     */
+    void   Simplify( const TrajectoryStore &store, int num );
+
+    int    NumInput() const;    //!< points added since Clear()
+    int    NumPoints() const;   //!< vertices of the simplified line
+
+    /** Write the vertices as (x,y) float pairs.
+     */
+    void   CopyPoints( float *xy ) const;
+
+protected:
+    void   keep( double x, double y );
+
+private:
+    double  m_eps;
+    std::vector<float>  m_points;   //!< kept vertices
+
+    double  m_ax, m_ay;         //!< last kept vertex
+    double  m_lx, m_ly;         //!< last point, ends the open segment
+    bool    m_open;             //!< there is a point after the last kept vertex
+    bool    m_haveDir;          //!< a point outside the eps-disk around A was seen
+    double  m_dx, m_dy;         //!< reference direction of the sector
+    double  m_lo, m_hi;         //!< admissible angles relative to (m_dx,m_dy)
+    double  m_maxDist;
+    int     m_numInput;
+};
+
+#endif // MPSIM_POLYLINE_SIMPLIFIER_H
@@ -0,0 +1,328 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header-only embedded Runge-Kutta steppers.
+    @file RKStepper.h
+*/
+
+#ifndef MPSIM_RK_STEPPER_H
+#define MPSIM_RK_STEPPER_H
+
+#include <cmath>
+#include <cstring>
+
+enum rkMethod {
+    RK_CASH_KARP = 0,
+    RK_DOPRI5,
+    RK_BS23
+};
+
+/**
+ *  Butcher tableaus of the embedded pairs. a(i,j) with j<i are the stage
+ *  coefficients, b(i) the weights of the propagated solution, and
+ *  e(i) = b(i) - bhat(i) the weights of the error estimate.
+ *  'errOrder' is the order of the local error estimate, which fixes the
+ *  exponents of the step size control. With 'fsal' set, the last stage is
+ *  evaluated at the new position and can be reused as first stage of the
+ *  next step.
+ *
+ *  d(i) are the weights of the dense output (see Stepper::Dense). They are
+ *  zero for the pairs without a continuous extension of their own, which
+ *  leaves the cubic Hermite interpolant of the step.
+ */
+constexpr double cashKarpA[6][5] = {
+    { 0.0, 0.0, 0.0, 0.0, 0.0 },
+    { 0.2, 0.0, 0.0, 0.0, 0.0 },
+    { 3.0/40.0, 9.0/40.0, 0.0, 0.0, 0.0 },
+    { 0.3, -0.9, 1.2, 0.0, 0.0 },
+    { -11.0/54.0, 2.5, -70.0/27.0, 35.0/27.0, 0.0 },
+    { 1631.0/55296.0, 175.0/512.0, 575.0/13824.0, 44275.0/110592.0, 253.0/4096.0 }
+};
+constexpr double cashKarpB[6] = { 37.0/378.0, 0.0, 250.0/621.0, 125.0/594.0, 0.0, 512.0/1771.0 };
+constexpr double cashKarpE[6] = {
+    37.0/378.0 - 2825.0/27648.0, 0.0, 250.0/621.0 - 18575.0/48384.0,
+    125.0/594.0 - 13525.0/55296.0, -277.0/14336.0, 512.0/1771.0 - 0.25
+};
+constexpr double cashKarpD[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+struct CashKarp {
+    enum { numStages = 6, errOrder = 5, fsal = 0, denseOrder = 3 };
+
+    static constexpr double a( int i, int j ) {
+        return cashKarpA[i][j];
+    }
+    static constexpr double b( int i ) {
+        return cashKarpB[i];
+    }
+    static constexpr double e( int i ) {
+        return cashKarpE[i];
+    }
+    static constexpr double d( int i ) {
+        return cashKarpD[i];
+    }
+};
+
+/**
+ *  Dormand-Prince 5(4); seven stages, but only six new evaluations per step.
+ *  The dense output of fourth order is that of Hairer's DOPRI5.
+ */
+constexpr double dormandPrince5A[7][6] = {
+    { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 },
+    { 1.0/5.0, 0.0, 0.0, 0.0, 0.0, 0.0 },
+    { 3.0/40.0, 9.0/40.0, 0.0, 0.0, 0.0, 0.0 },
+    { 44.0/45.0, -56.0/15.0, 32.0/9.0, 0.0, 0.0, 0.0 },
+    { 19372.0/6561.0, -25360.0/2187.0, 64448.0/6561.0, -212.0/729.0, 0.0, 0.0 },
+    { 9017.0/3168.0, -355.0/33.0, 46732.0/5247.0, 49.0/176.0, -5103.0/18656.0, 0.0 },
+    { 35.0/384.0, 0.0, 500.0/1113.0, 125.0/192.0, -2187.0/6784.0, 11.0/84.0 }
+};
+constexpr double dormandPrince5B[7] = { 35.0/384.0, 0.0, 500.0/1113.0, 125.0/192.0, -2187.0/6784.0, 11.0/84.0, 0.0 };
+constexpr double dormandPrince5E[7] = {
+    71.0/57600.0, 0.0, -71.0/16695.0, 71.0/1920.0, -17253.0/339200.0, 22.0/525.0, -1.0/40.0
+};
+constexpr double dormandPrince5D[7] = {
+    -12715105075.0/11282082432.0, 0.0, 87487479700.0/32700410799.0, -10690763975.0/1880347072.0,
+    701980252875.0/199316789632.0, -1453857185.0/822651844.0, 69997945.0/29380423.0
+};
+
+struct DormandPrince5 {
+    enum { numStages = 7, errOrder = 5, fsal = 1, denseOrder = 4 };
+
+    static constexpr double a( int i, int j ) {
+        return dormandPrince5A[i][j];
+    }
+    static constexpr double b( int i ) {
+        return dormandPrince5B[i];
+    }
+    static constexpr double e( int i ) {
+        return dormandPrince5E[i];
+    }
+    static constexpr double d( int i ) {
+        return dormandPrince5D[i];
+    }
+};
+
+/**
+ *  Bogacki-Shampine 3(2); cheap for coarse tolerances. Its cubic Hermite
+ *  interpolant is of the order of the method.
+ */
+constexpr double bogackiShampine3A[4][3] = {
+    { 0.0, 0.0, 0.0 },
+    { 0.5, 0.0, 0.0 },
+    { 0.0, 0.75, 0.0 },
+    { 2.0/9.0, 1.0/3.0, 4.0/9.0 }
+};
+constexpr double bogackiShampine3B[4] = { 2.0/9.0, 1.0/3.0, 4.0/9.0, 0.0 };
+constexpr double bogackiShampine3E[4] = { -5.0/72.0, 1.0/12.0, 1.0/9.0, -1.0/8.0 };
+constexpr double bogackiShampine3D[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+struct BogackiShampine3 {
+    enum { numStages = 4, errOrder = 3, fsal = 1, denseOrder = 3 };
+
+    static constexpr double a( int i, int j ) {
+        return bogackiShampine3A[i][j];
+    }
+    static constexpr double b( int i ) {
+        return bogackiShampine3B[i];
+    }
+    static constexpr double e( int i ) {
+        return bogackiShampine3E[i];
+    }
+    static constexpr double d( int i ) {
+        return bogackiShampine3D[i];
+    }
+};
+
+
+/**
+ * @brief The Stepper class
+ *
+ *  Adaptive embedded Runge-Kutta step with the step size control of rkqs
+ *  (Numerical Recipes). All stages live inside the object, so a Stepper on the
+ *  stack does not touch the heap.
+ *
+ *  'System' has to provide   void calcRHS( const double *y, double *dydx ) const;
+ *
+ *  Usage:
+ *     Stepper<DormandPrince5,4> stepper(1e-8);
+ *     stepper.Init(sys,y);
+ *     for(...) { stepper.Step(sys,y,h,hdid,hnext); t += hdid; h = hnext; }
+ */
+template <class Tableau, int N>
+class Stepper
+{
+public:
+    Stepper( double eps = 1e-8, double hmin = 1e-12 ) :
+        m_eps(eps),
+        m_hmin(hmin)
+    {
+        memset(m_k,0,sizeof(m_k));
+        memset(m_dense,0,sizeof(m_dense));
+    }
+
+    /** Evaluate the derivative at the initial state.
+     */
+    template <class System>
+    void Init( const System &sys, const double *y ) {
+        sys.calcRHS(y,m_k[0]);
+    }
+
+    /** Do one adaptive step.
+     *    Steps are retried with smaller size until the error is below the
+     *    tolerance or the step size falls below hmin.
+     * @param sys    System that provides calcRHS.
+     * @param y      Current state; replaced by the new state.
+     * @param htry   Step size to try first.
+     * @param hdid   Reference to step size actually done.
+     * @param hnext  Reference to estimated next step size.
+     */
+    template <class System>
+    void Step( const System &sys, double *y, double htry, double &hdid, double &hnext ) {
+        const double SAFETY = 0.9;
+        const double PGROW  = -1.0/Tableau::errOrder;
+        const double PSHRNK = -1.0/(Tableau::errOrder-1);
+        const double ERRCON = pow(5.0/SAFETY,1.0/PGROW);
+        int i;
+
+        for(i=0; i<N; i++) {
+            m_yscal[i] = fabs(y[i]) + fabs(m_k[0][i]*htry) + 1.0e-30;
+        }
+
+        double errmax, htemp;
+        double h = htry;
+        for(;;) {
+            errmax = trial(sys,y,h);
+            if (errmax <= 1.0) {
+                break;
+            }
+
+            htemp = SAFETY * h * pow(errmax, PSHRNK);
+            h = (h>=0.0 ? (htemp>0.1*h ? htemp : 0.1*h) : (htemp<0.1*h ? htemp : 0.1*h));
+            if (h<m_hmin) {
+                break;
+            }
+        }
+
+        if (errmax > ERRCON) {
+            hnext = SAFETY * h * pow(errmax,PGROW);
+        } else {
+            hnext = 5.0*h;
+        }
+
+        hdid = h;
+        if (Tableau::denseOrder>3) {
+            // the Hermite interpolant needs no stages; m_dense stays zero
+            for(i=0; i<N; i++) {
+                double sum = 0.0;
+                for(int j=0; j<Tableau::numStages; j++) {
+                    sum += Tableau::d(j)*m_k[j][i];
+                }
+                m_dense[i] = h*sum;
+            }
+        }
+        memcpy(y,m_yout,sizeof(double)*N);
+        if (Tableau::fsal) {
+            memcpy(m_k[0],m_k[Tableau::numStages-1],sizeof(double)*N);
+        } else {
+            sys.calcRHS(y,m_k[0]);
+        }
+    }
+
+    /** Derivative at the current state.
+     */
+    const double* Deriv() const {
+        return m_k[0];
+    }
+
+    /** Dense output coefficient r5 of the last step from (t0,y0,f0) to
+     *  (t1,y1,f1), h = t1-t0. For s = (t-t0)/h and dy = y1-y0,
+     *
+     *     y(t) = y0 + s*(dy + (1-s)*(r3 + s*(r4 + (1-s)*r5))),
+     *     r3 = h*f0 - dy,   r4 = dy - h*f1 - r3,
+     *
+     *  is accurate to order Tableau::denseOrder. With r5 = 0, this is the
+     *  cubic Hermite interpolant.
+     */
+    const double* Dense() const {
+        return m_dense;
+    }
+
+protected:
+    /** Evaluate all stages for step size h.
+     * @return  scaled maximum error.
+     */
+    template <class System>
+    double trial( const System &sys, const double *y, double h ) {
+        const int S = Tableau::numStages;
+        int s,j,i;
+
+        for(s=1; s<S; s++) {
+            for(i=0; i<N; i++) {
+                double sum = 0.0;
+                for(j=0; j<s; j++) {
+                    sum += Tableau::a(s,j)*m_k[j][i];
+                }
+                m_ytemp[i] = y[i] + h*sum;
+            }
+            sys.calcRHS(m_ytemp,m_k[s]);
+        }
+
+        double errmax = 0.0;
+        for(i=0; i<N; i++) {
+            double sum = 0.0;
+            double err = 0.0;
+            for(j=0; j<S; j++) {
+                sum += Tableau::b(j)*m_k[j][i];
+                err += Tableau::e(j)*m_k[j][i];
+            }
+            // with FSAL the last stage was evaluated exactly at the new state
+            m_yout[i] = (Tableau::fsal ? m_ytemp[i] : y[i] + h*sum);
+            err = fabs(h*err/m_yscal[i]);
+            errmax = (err>errmax ? err : errmax);
+        }
+        return errmax/m_eps;
+    }
+
+private:
+    double  m_eps;
+    double  m_hmin;
+
+    double  m_k[Tableau::numStages][N];
+    double  m_ytemp[N];
+    double  m_yout[N];
+    double  m_yscal[N];
+    double  m_dense[N];
+};
+
+
+inline const char* RKMethodName( rkMethod method ) {
+    switch (method) {
+        default:
+        case RK_CASH_KARP:
+            return "cashkarp";
+        case RK_DOPRI5:
+            return "dopri5";
+        case RK_BS23:
+            return "bs23";
+    }
+}
+
+/** Convert name to method.
+ * @return false if the name is unknown; 'method' is not changed then.
+ */
+inline bool RKMethodFromName( const char* name, rkMethod &method ) {
+    const rkMethod methods[] = { RK_CASH_KARP, RK_DOPRI5, RK_BS23 };
+    for(unsigned int i=0; i<sizeof(methods)/sizeof(rkMethod); i++) {
+        if (strcmp(name,RKMethodName(methods[i]))==0) {
+            method = methods[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // MPSIM_RK_STEPPER_H
@@ -0,0 +1,330 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Lane-parallel Cash-Karp kernel.
+    @file SimdKernel.inl
+
+    This file has no include guard on purpose. It is included by every
+    SimdStepper_*.cpp inside its own namespace after the vector type 'V' and
+    the target options of that instruction set are defined. V has to provide:
+
+      V::width, V::mask, V(double), V::load(), store(),
+      + - * /, sqrt(), abs(), max(), min(),
+      lt(), le(), gt(), select(mask,ifTrue,ifFalse), mask_or(), movemask()
+
+    With LANE_FAST_POW defined, the generic force law uses the vectorizable
+    FastPow instead of pow. Without 64-bit integer compares (SSE2) the
+    compiler cannot vectorize FastPow, and libm pow is faster.
+*/
+
+#define  LANE_SAFETY 0.9
+#define  LANE_PGROW  -0.2
+#define  LANE_ERRCON 1.89e-4
+#define  LANE_TINY   1.0e-30
+
+// Cash-Karp tableau of RKStepper.h, so the lanes and the scalar Stepper cannot drift apart
+static constexpr double
+lb21 = CashKarp::a(1,0), lb31 = CashKarp::a(2,0), lb32 = CashKarp::a(2,1),
+lb41 = CashKarp::a(3,0), lb42 = CashKarp::a(3,1), lb43 = CashKarp::a(3,2),
+lb51 = CashKarp::a(4,0), lb52 = CashKarp::a(4,1), lb53 = CashKarp::a(4,2), lb54 = CashKarp::a(4,3),
+lb61 = CashKarp::a(5,0), lb62 = CashKarp::a(5,1), lb63 = CashKarp::a(5,2),
+lb64 = CashKarp::a(5,3), lb65 = CashKarp::a(5,4),
+lc1 = CashKarp::b(0), lc3 = CashKarp::b(2), lc4 = CashKarp::b(3), lc6 = CashKarp::b(5),
+ldc1 = CashKarp::e(0), ldc3 = CashKarp::e(2), ldc4 = CashKarp::e(3), ldc5 = CashKarp::e(4),
+ldc6 = CashKarp::e(5);
+
+
+/**
+ *  Lane-wise power with scalar exponent for the step size control.
+ */
+static inline V lanePow( const V &a, double e ) {
+    alignas(64) double buf[V::width];
+    a.store(buf);
+    for(int l=0; l<V::width; l++) {
+        buf[l] = pow(buf[l],e);
+    }
+    return V::load(buf);
+}
+
+/**
+ *  Lane-wise power for ForceGeneric. FastPow has no branches, so the compiler
+ *  vectorizes this loop.
+ */
+static inline V ForcePow( const V &a, double e ) {
+    alignas(64) double buf[V::width];
+    a.store(buf);
+    for(int l=0; l<V::width; l++) {
+#ifdef LANE_FAST_POW
+        buf[l] = ::FastPow(buf[l],e);
+#else
+        buf[l] = pow(buf[l],e);
+#endif
+    }
+    return V::load(buf);
+}
+
+/**
+ *  Tag that replaces the force law if the magnet field is tabulated or
+ *  approximated by the magnet tree (see MagnetTable::IsExact).
+ */
+struct LaneTableField {};
+
+/**
+ *  Sum over all magnets: acceleration and magnet part of the potential.
+ */
+template <class Law>
+struct LaneMagnets {
+    static inline void accel( const laneSystem &sys, const V &x, const V &y, V &M1, V &M2 ) {
+        M1 = V(0.0);
+        M2 = V(0.0);
+        for(int i=0; i<sys.numMagnets; i++) {
+            V rx = x - V(sys.mx[i]);
+            V ry = y - V(sys.my[i]);
+            V r2 = rx*rx + ry*ry + V(sys.mrz2[i]);
+            V f = V(sys.mkam[i])*Law::Numer(r2,sys.kappa);
+            M1 = M1 + f*rx;
+            M2 = M2 + f*ry;
+        }
+    }
+
+    static inline V potential( const laneSystem &sys, const V &x, const V &y ) {
+        V U = V(0.0);
+        for(int i=0; i<sys.numMagnets; i++) {
+            V rx = x - V(sys.mx[i]);
+            V ry = y - V(sys.my[i]);
+            V r2 = rx*rx + ry*ry + V(sys.mrz2[i]);
+            U = U - V(sys.mam[i])*Law::Inverse(r2,sys.kappa);
+        }
+        return U;
+    }
+};
+
+/**
+ *  Tabulated or tree field: grid lookups and tree walks do not vectorize, so
+ *  the lanes simply evaluate the table one after the other.
+ */
+template <>
+struct LaneMagnets<LaneTableField> {
+    static inline void accel( const laneSystem &sys, const V &x, const V &y, V &M1, V &M2 ) {
+        alignas(64) double bx[V::width], by[V::width];
+        x.store(bx);
+        y.store(by);
+        for(int l=0; l<V::width; l++) {
+            sys.field->MagnetAccel(bx[l],by[l],bx[l],by[l]);
+        }
+        M1 = V::load(bx);
+        M2 = V::load(by);
+    }
+
+    static inline V potential( const laneSystem &sys, const V &x, const V &y ) {
+        alignas(64) double bx[V::width], by[V::width];
+        x.store(bx);
+        y.store(by);
+        for(int l=0; l<V::width; l++) {
+            bx[l] = sys.field->Potential(bx[l],by[l]) - 0.5*sys.g_l*(bx[l]*bx[l] + by[l]*by[l]);
+        }
+        return V::load(bx);
+    }
+};
+
+/**
+ *  Cartesian model of SystemData::calcRHS for all lanes.
+ */
+template <class Law>
+static inline void laneRHS( const laneSystem &sys, const V *y, V *dydx ) {
+    V M1, M2;
+    LaneMagnets<Law>::accel(sys,y[0],y[1],M1,M2);
+
+    dydx[0] = y[2];
+    dydx[1] = y[3];
+    dydx[2] = V(0.0) - V(sys.gamma)*y[2] - V(sys.g_l)*y[0] - M1;
+    dydx[3] = V(0.0) - V(sys.gamma)*y[3] - V(sys.g_l)*y[1] - M2;
+}
+
+/**
+ *  Total energy v^2/2 + V, see Equilibria::Energy.
+ */
+template <class Law>
+static inline V laneEnergy( const laneSystem &sys, const V *y ) {
+    V E = V(0.5)*(y[2]*y[2] + y[3]*y[3]) + V(0.5*sys.g_l)*(y[0]*y[0] + y[1]*y[1]);
+    return E + LaneMagnets<Law>::potential(sys,y[0],y[1]);
+}
+
+template <class Law>
+static inline void laneRKCK( const laneSystem &sys, const V *y, const V *dydx, const V &h,
+                             V *yout, V *yerr ) {
+    V ak2[4], ak3[4], ak4[4], ak5[4], ak6[4], ytemp[4];
+    int i;
+
+    for(i=0; i<4; i++) {
+        ytemp[i] = y[i] + h*(V(lb21)*dydx[i]);
+    }
+    laneRHS<Law>(sys,ytemp,ak2);
+    for(i=0; i<4; i++) {
+        ytemp[i] = y[i] + h*(V(lb31)*dydx[i] + V(lb32)*ak2[i]);
+    }
+    laneRHS<Law>(sys,ytemp,ak3);
+    for(i=0; i<4; i++) {
+        ytemp[i] = y[i] + h*(V(lb41)*dydx[i] + V(lb42)*ak2[i] + V(lb43)*ak3[i]);
+    }
+    laneRHS<Law>(sys,ytemp,ak4);
+    for(i=0; i<4; i++) {
+        ytemp[i] = y[i] + h*(V(lb51)*dydx[i] + V(lb52)*ak2[i] + V(lb53)*ak3[i] + V(lb54)*ak4[i]);
+    }
+    laneRHS<Law>(sys,ytemp,ak5);
+    for(i=0; i<4; i++) {
+        ytemp[i] = y[i] + h*(V(lb61)*dydx[i] + V(lb62)*ak2[i] + V(lb63)*ak3[i] + V(lb64)*ak4[i] + V(lb65)*ak5[i]);
+    }
+    laneRHS<Law>(sys,ytemp,ak6);
+    for(i=0; i<4; i++) {
+        yout[i] = y[i] + h*(V(lc1)*dydx[i] + V(lc3)*ak3[i] + V(lc4)*ak4[i] + V(lc6)*ak6[i]);
+        yerr[i] = h*(V(ldc1)*dydx[i] + V(ldc3)*ak3[i] + V(ldc4)*ak4[i] + V(ldc5)*ak5[i] + V(ldc6)*ak6[i]);
+    }
+}
+
+
+/**
+ *  Integrate all pixels of the batch. The lane state lives in small arrays so that
+ *  single lanes can be finished and refilled between the vector steps.
+ */
+template <class Law>
+static void integrateLanesFor( const laneSystem &sys, lanePixels &pix ) {
+    const int W = V::width;
+    alignas(64) double sy[4][W], sscal[4][W], sh[W], st[W], sfresh[W], sacc[W], strap[W];
+    int pixel[W], steps[W];
+    int next = 0;
+    int active = 0;
+    int i,l;
+
+    for(l=0; l<W; l++) {
+        pixel[l] = -1;
+        for(i=0; i<4; i++) {
+            sy[i][l] = sscal[i][l] = 0.0;
+        }
+        sh[l] = sys.hInit;
+        st[l] = 0.0;
+        sfresh[l] = 1.0;
+        steps[l] = 0;
+        if (next<pix.num) {
+            pixel[l] = next;
+            sy[0][l] = pix.x0[next];
+            sy[1][l] = pix.y0[next];
+            next++;
+            active++;
+        }
+    }
+
+    while (active>0) {
+        V y[4], dydx[4], yscal[4], yout[4], yerr[4];
+        for(i=0; i<4; i++) {
+            y[i] = V::load(sy[i]);
+        }
+        V h = V::load(sh);
+        V t = V::load(st);
+        typename V::mask fresh = gt(V::load(sfresh),V(0.5));
+
+        // yscal is only renewed at the beginning of a step, not for a retry
+        laneRHS<Law>(sys,y,dydx);
+        for(i=0; i<4; i++) {
+            yscal[i] = select(fresh, abs(y[i]) + abs(dydx[i]*h) + V(LANE_TINY), V::load(sscal[i]));
+            yscal[i].store(sscal[i]);
+        }
+
+        laneRKCK<Law>(sys,y,dydx,h,yout,yerr);
+
+        V errmax = abs(yerr[0]/yscal[0]);
+        for(i=1; i<4; i++) {
+            errmax = max(errmax,abs(yerr[i]/yscal[i]));
+        }
+        errmax = errmax/V(sys.eps);
+
+        // shrink: SAFETY*h*errmax^(-1/4), but at most by a factor of 10
+        V hshrink = max(V(LANE_SAFETY)*h/sqrt(sqrt(errmax)), V(0.1)*h);
+        typename V::mask accept = mask_or(le(errmax,V(1.0)), lt(hshrink,V(1e-12)));
+        V hdid = select(le(errmax,V(1.0)), h, hshrink);
+
+        V grow  = V(LANE_SAFETY)*hdid*lanePow(max(errmax,V(LANE_ERRCON)),LANE_PGROW);
+        V hnext = select(gt(errmax,V(LANE_ERRCON)), grow, V(5.0)*hdid);
+
+        for(i=0; i<4; i++) {
+            y[i] = select(accept, yout[i], y[i]);
+            y[i].store(sy[i]);
+        }
+        t = select(accept, t + hdid, t);
+        h = select(accept, hnext, hshrink);
+        t.store(st);
+        h.store(sh);
+        select(accept, V(1.0), V(0.0)).store(sacc);
+        select(accept, V(1.0), V(0.0)).store(sfresh);
+
+        // energy below the lowest saddle: outcome is decided
+        select(lt(laneEnergy<Law>(sys,y),V(sys.trapEnergy)), V(1.0), V(0.0)).store(strap);
+
+        for(l=0; l<W; l++) {
+            if (pixel[l]<0 || sacc[l]<0.5) {
+                continue;
+            }
+            steps[l]++;
+
+            int mIdx = -1;
+            if (strap[l]>0.5) {
+                double yl[4] = { sy[0][l], sy[1][l], sy[2][l], sy[3][l] };
+                mIdx = sys.equilibria->CapturedBy(yl);
+            }
+            if (mIdx<0 && st[l]<sys.maxTime && steps[l]<sys.maxSteps && fabs(sh[l])>=1e-12) {
+                continue;
+            }
+
+            // pixel finished: store result and refill lane
+            pix.index[pixel[l]] = mIdx;
+            pix.time[pixel[l]] = static_cast<float>(st[l]);
+            if (pix.steps!=NULL) {
+                pix.steps[pixel[l]] = steps[l];
+            }
+            active--;
+            pixel[l] = -1;
+            sh[l] = sys.hInit;
+            st[l] = 0.0;
+            steps[l] = 0;
+            sfresh[l] = 1.0;
+            if (next<pix.num) {
+                pixel[l] = next;
+                sy[0][l] = pix.x0[next];
+                sy[1][l] = pix.y0[next];
+                sy[2][l] = sy[3][l] = 0.0;
+                next++;
+                active++;
+            }
+        }
+    }
+}
+
+static void integrateLanes( const laneSystem &sys, lanePixels &pix ) {
+    if (sys.field!=NULL) {
+        integrateLanesFor<LaneTableField>(sys,pix);
+        return;
+    }
+    switch (sys.law) {
+        default:
+        case FORCE_KAPPA1:
+            integrateLanesFor<ForceKappa1>(sys,pix);
+            break;
+        case FORCE_KAPPA2:
+            integrateLanesFor<ForceKappa2>(sys,pix);
+            break;
+        case FORCE_GENERIC:
+            integrateLanesFor<ForceGeneric>(sys,pix);
+            break;
+    }
+}
+
+#undef  LANE_SAFETY
+#undef  LANE_PGROW
+#undef  LANE_ERRCON
+#undef  LANE_TINY
+#undef  LANE_FAST_POW
@@ -0,0 +1,166 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file SimdStepper.cpp
+*/
+
+#include "SimdStepper.h"
+
+#include <cmath>
+#include <cstring>
+
+/**
+ *  Scalar "vector" with a single lane. It runs the same kernel as the
+ *  vector units and is used if no vector unit is available.
+ */
+namespace lanes_scalar {
+
+struct V {
+    typedef bool mask;
+    static const int width = 1;
+
+    double v;
+    V() {}
+    V( double a ) : v(a) {}
+    static V load( const double* p ) { return V(*p); }
+    void store( double* p ) const { *p = v; }
+};
+
+inline V operator+( const V &a, const V &b ) { return V(a.v+b.v); }
+inline V operator-( const V &a, const V &b ) { return V(a.v-b.v); }
+inline V operator*( const V &a, const V &b ) { return V(a.v*b.v); }
+inline V operator/( const V &a, const V &b ) { return V(a.v/b.v); }
+inline V sqrt( const V &a ) { return V(std::sqrt(a.v)); }
+inline V abs ( const V &a ) { return V(std::fabs(a.v)); }
+inline V max ( const V &a, const V &b ) { return V(a.v>b.v ? a.v : b.v); }
+inline V min ( const V &a, const V &b ) { return V(a.v<b.v ? a.v : b.v); }
+inline bool lt( const V &a, const V &b ) { return a.v<b.v; }
+inline bool le( const V &a, const V &b ) { return a.v<=b.v; }
+inline bool gt( const V &a, const V &b ) { return a.v>b.v; }
+inline bool mask_or( bool a, bool b ) { return a || b; }
+inline V select( bool m, const V &a, const V &b ) { return (m ? a : b); }
+inline int movemask( bool m ) { return (m ? 1 : 0); }
+
+#include "SimdKernel.inl"
+
+} // namespace lanes_scalar
+
+
+void integrateLanes_scalar( const laneSystem &sys, lanePixels &pix ) {
+    lanes_scalar::integrateLanes(sys,pix);
+}
+
+
+simdLevel SimdStepper::DetectLevel() {
+#if defined(MPSIM_HAVE_X86_LANES) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SIMD_SSE2;
+    }
+    return SIMD_NONE;
+#elif defined(MPSIM_HAVE_X86_LANES)
+    return SIMD_SSE2;
+#elif defined(MPSIM_HAVE_NEON_LANES)
+    return SIMD_NEON;
+#else
+    return SIMD_NONE;
+#endif
+}
+
+bool SimdStepper::IsSupported( simdLevel level ) {
+    simdLevel best = DetectLevel();
+    switch (level) {
+        default:
+            return false;
+        case SIMD_NONE:
+            return true;
+        case SIMD_SSE2:
+        case SIMD_AVX2:
+        case SIMD_AVX512:
+            return (best!=SIMD_NEON && best>=level);
+        case SIMD_NEON:
+            return (best==SIMD_NEON);
+    }
+    return false;
+}
+
+simdLevel SimdStepper::Resolve( simdLevel level ) {
+    if (level==SIMD_AUTO || !IsSupported(level)) {
+        return DetectLevel();
+    }
+    return level;
+}
+
+laneIntegrateFunc SimdStepper::Select( simdLevel level ) {
+    switch (Resolve(level)) {
+        default:
+            break;
+#ifdef MPSIM_HAVE_X86_LANES
+        case SIMD_SSE2:
+            return integrateLanes_sse2;
+        case SIMD_AVX2:
+            return integrateLanes_avx2;
+        case SIMD_AVX512:
+            return integrateLanes_avx512;
+#endif
+#ifdef MPSIM_HAVE_NEON_LANES
+        case SIMD_NEON:
+            return integrateLanes_neon;
+#endif
+    }
+    return integrateLanes_scalar;
+}
+
+int SimdStepper::LaneWidth( simdLevel level ) {
+    switch (Resolve(level)) {
+        default:
+            break;
+        case SIMD_SSE2:
+        case SIMD_NEON:
+            return 2;
+        case SIMD_AVX2:
+            return 4;
+        case SIMD_AVX512:
+            return 8;
+    }
+    return 1;
+}
+
+const char* SimdStepper::LevelName( simdLevel level ) {
+    switch (level) {
+        default:
+            break;
+        case SIMD_AUTO:
+            return "auto";
+        case SIMD_SSE2:
+            return "sse2";
+        case SIMD_AVX2:
+            return "avx2";
+        case SIMD_AVX512:
+            return "avx512";
+        case SIMD_NEON:
+            return "neon";
+    }
+    return "off";
+}
+
+simdLevel SimdStepper::LevelFromName( const char* name ) {
+    const simdLevel levels[] = { SIMD_AUTO, SIMD_NONE, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512, SIMD_NEON };
+    for(unsigned int i=0; i<sizeof(levels)/sizeof(simdLevel); i++) {
+        if (strcmp(name,LevelName(levels[i]))==0) {
+            return levels[i];
+        }
+    }
+    return SIMD_AUTO;
+}
@@ -0,0 +1,109 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the lane-parallel Cash-Karp integrator.
+    @file SimdStepper.h
+*/
+
+#ifndef MPSIM_SIMD_STEPPER_H
+#define MPSIM_SIMD_STEPPER_H
+
+#include "Equilibria.h"
+#include "RKStepper.h"
+
+enum simdLevel {
+    SIMD_AUTO = -1,
+    SIMD_NONE = 0,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_NEON
+};
+
+/**
+ *  Data that is the same for all lanes. The magnets are given as structure of
+ *  arrays: rz2 is the squared vertical distance between bob plane and magnet,
+ *  am = alpha*magFactor, and kam = kappa*am. If the magnet field is tabulated or
+ *  approximated by a tree, the lanes evaluate it through 'field' instead of
+ *  summing over the magnets.
+ */
+typedef struct laneSystem_t {
+    double  g_l;            //!< gravity/pendulumLength
+    double  gamma;          //!< damping
+    double  kappa;
+    forceLaw  law;          //!< selects the kernel once per batch
+    int     numMagnets;
+    const double *mx, *my, *mrz2, *mam, *mkam;
+    const MagnetTable* field;   //!< table with field grid or magnet tree, else NULL
+
+    double  eps;            //!< integration tolerance
+    double  hInit;          //!< initial step size
+    double  maxTime;
+    int     maxSteps;
+    double  trapEnergy;     //!< lanes with less energy are trapped
+    const Equilibria* equilibria;
+} laneSystem;
+
+/**
+ *  Initial positions and results of a batch of pixels.
+ */
+typedef struct lanePixels_t {
+    int           num;
+    const double  *x0, *y0;
+    int           *index;   //!< magnet index or -1
+    float         *time;    //!< capture time
+    int           *steps;   //!< accepted steps, may be NULL
+} lanePixels;
+
+typedef void (*laneIntegrateFunc)( const laneSystem &sys, lanePixels &pix );
+
+
+/**
+ * @brief The SimdStepper class
+ *
+ *  Every lane of a vector register holds one pixel. All lanes are advanced by the
+ *  Cash-Karp step together, but each lane has its own step size. Accept/reject is
+ *  done by masking, and a lane whose pixel is captured is immediately refilled
+ *  with the next pixel of the batch.
+ *
+ *  The instruction set is selected at runtime. The kernels work in double
+ *  precision, hence SSE2/NEON hold 2, AVX2 4, and AVX-512 8 pixels per vector.
+ */
+class SimdStepper
+{
+public:
+    /** Best instruction set supported by the cpu.
+     */
+    static simdLevel          DetectLevel();
+
+    /** Integration function for the given level; SIMD_AUTO detects the level.
+     *    If the level is not compiled in or not supported, the best available one is used.
+     */
+    static laneIntegrateFunc  Select( simdLevel level );
+
+    static simdLevel          Resolve( simdLevel level );
+    static bool               IsSupported( simdLevel level );
+    static int                LaneWidth( simdLevel level );
+    static const char*        LevelName( simdLevel level );
+    static simdLevel          LevelFromName( const char* name );
+};
+
+
+void integrateLanes_scalar( const laneSystem &sys, lanePixels &pix );
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define MPSIM_HAVE_X86_LANES
+void integrateLanes_sse2( const laneSystem &sys, lanePixels &pix );
+void integrateLanes_avx2( const laneSystem &sys, lanePixels &pix );
+void integrateLanes_avx512( const laneSystem &sys, lanePixels &pix );
+#endif
+#if defined(__aarch64__)
+#define MPSIM_HAVE_NEON_LANES
+void integrateLanes_neon( const laneSystem &sys, lanePixels &pix );
+#endif
+
+#endif // MPSIM_SIMD_STEPPER_H
@@ -0,0 +1,74 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief AVX2 lanes (4 pixels per vector).
+    @file SimdStepper_avx2.cpp
+*/
+
+#include "SimdStepper.h"
+
+#include <cmath>
+
+#ifdef MPSIM_HAVE_X86_LANES
+#include <immintrin.h>
+
+// compile this unit for AVX2 regardless of the global compiler flags;
+// it is only called if SimdStepper::DetectLevel() reports AVX2
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+namespace lanes_avx2 {
+
+struct V {
+    typedef __m256d mask;
+    static const int width = 4;
+
+    __m256d v;
+    V() {}
+    V( __m256d a ) : v(a) {}
+    V( double a ) : v(_mm256_set1_pd(a)) {}
+    static V load( const double* p ) { return V(_mm256_load_pd(p)); }
+    void store( double* p ) const { _mm256_store_pd(p,v); }
+};
+
+inline V operator+( const V &a, const V &b ) { return V(_mm256_add_pd(a.v,b.v)); }
+inline V operator-( const V &a, const V &b ) { return V(_mm256_sub_pd(a.v,b.v)); }
+inline V operator*( const V &a, const V &b ) { return V(_mm256_mul_pd(a.v,b.v)); }
+inline V operator/( const V &a, const V &b ) { return V(_mm256_div_pd(a.v,b.v)); }
+inline V sqrt( const V &a ) { return V(_mm256_sqrt_pd(a.v)); }
+inline V abs ( const V &a ) { return V(_mm256_andnot_pd(_mm256_set1_pd(-0.0),a.v)); }
+inline V max ( const V &a, const V &b ) { return V(_mm256_max_pd(a.v,b.v)); }
+inline V min ( const V &a, const V &b ) { return V(_mm256_min_pd(a.v,b.v)); }
+inline __m256d lt( const V &a, const V &b ) { return _mm256_cmp_pd(a.v,b.v,_CMP_LT_OQ); }
+inline __m256d le( const V &a, const V &b ) { return _mm256_cmp_pd(a.v,b.v,_CMP_LE_OQ); }
+inline __m256d gt( const V &a, const V &b ) { return _mm256_cmp_pd(a.v,b.v,_CMP_GT_OQ); }
+inline __m256d mask_or( __m256d a, __m256d b ) { return _mm256_or_pd(a,b); }
+inline V select( __m256d m, const V &a, const V &b ) { return V(_mm256_blendv_pd(b.v,a.v,m)); }
+inline int movemask( __m256d m ) { return _mm256_movemask_pd(m); }
+
+// 64-bit integer compares are native, so FastPow vectorizes
+#define LANE_FAST_POW
+#include "SimdKernel.inl"
+
+} // namespace lanes_avx2
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+void integrateLanes_avx2( const laneSystem &sys, lanePixels &pix ) {
+    lanes_avx2::integrateLanes(sys,pix);
+}
+
+#endif // MPSIM_HAVE_X86_LANES
@@ -0,0 +1,79 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief AVX-512 lanes (8 pixels per vector).
+    @file SimdStepper_avx512.cpp
+*/
+
+#include "SimdStepper.h"
+
+#include <cmath>
+
+#ifdef MPSIM_HAVE_X86_LANES
+#include <immintrin.h>
+
+// compile this unit for AVX-512 regardless of the global compiler flags;
+// it is only called if SimdStepper::DetectLevel() reports AVX-512
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+// avx512fintrin.h of gcc 12 initializes undefined vectors with themselves
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+namespace lanes_avx512 {
+
+struct V {
+    typedef __mmask8 mask;
+    static const int width = 8;
+
+    __m512d v;
+    V() {}
+    V( __m512d a ) : v(a) {}
+    V( double a ) : v(_mm512_set1_pd(a)) {}
+    static V load( const double* p ) { return V(_mm512_load_pd(p)); }
+    void store( double* p ) const { _mm512_store_pd(p,v); }
+};
+
+inline V operator+( const V &a, const V &b ) { return V(_mm512_add_pd(a.v,b.v)); }
+inline V operator-( const V &a, const V &b ) { return V(_mm512_sub_pd(a.v,b.v)); }
+inline V operator*( const V &a, const V &b ) { return V(_mm512_mul_pd(a.v,b.v)); }
+inline V operator/( const V &a, const V &b ) { return V(_mm512_div_pd(a.v,b.v)); }
+inline V sqrt( const V &a ) { return V(_mm512_sqrt_pd(a.v)); }
+inline V abs ( const V &a ) { return V(_mm512_abs_pd(a.v)); }
+inline V max ( const V &a, const V &b ) { return V(_mm512_max_pd(a.v,b.v)); }
+inline V min ( const V &a, const V &b ) { return V(_mm512_min_pd(a.v,b.v)); }
+inline __mmask8 lt( const V &a, const V &b ) { return _mm512_cmp_pd_mask(a.v,b.v,_CMP_LT_OQ); }
+inline __mmask8 le( const V &a, const V &b ) { return _mm512_cmp_pd_mask(a.v,b.v,_CMP_LE_OQ); }
+inline __mmask8 gt( const V &a, const V &b ) { return _mm512_cmp_pd_mask(a.v,b.v,_CMP_GT_OQ); }
+inline __mmask8 mask_or( __mmask8 a, __mmask8 b ) { return static_cast<__mmask8>(a | b); }
+inline V select( __mmask8 m, const V &a, const V &b ) { return V(_mm512_mask_blend_pd(m,b.v,a.v)); }
+inline int movemask( __mmask8 m ) { return static_cast<int>(m); }
+
+// 64-bit integer compares are native, so FastPow vectorizes
+#define LANE_FAST_POW
+#include "SimdKernel.inl"
+
+} // namespace lanes_avx512
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+#endif
+
+void integrateLanes_avx512( const laneSystem &sys, lanePixels &pix ) {
+    lanes_avx512::integrateLanes(sys,pix);
+}
+
+#endif // MPSIM_HAVE_X86_LANES
@@ -0,0 +1,61 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief NEON lanes (2 pixels per vector).
+    @file SimdStepper_neon.cpp
+*/
+
+#include "SimdStepper.h"
+
+#include <cmath>
+
+#ifdef MPSIM_HAVE_NEON_LANES
+#include <arm_neon.h>
+
+namespace lanes_neon {
+
+struct V {
+    typedef uint64x2_t mask;
+    static const int width = 2;
+
+    float64x2_t v;
+    V() {}
+    V( float64x2_t a ) : v(a) {}
+    V( double a ) : v(vdupq_n_f64(a)) {}
+    static V load( const double* p ) { return V(vld1q_f64(p)); }
+    void store( double* p ) const { vst1q_f64(p,v); }
+};
+
+inline V operator+( const V &a, const V &b ) { return V(vaddq_f64(a.v,b.v)); }
+inline V operator-( const V &a, const V &b ) { return V(vsubq_f64(a.v,b.v)); }
+inline V operator*( const V &a, const V &b ) { return V(vmulq_f64(a.v,b.v)); }
+inline V operator/( const V &a, const V &b ) { return V(vdivq_f64(a.v,b.v)); }
+inline V sqrt( const V &a ) { return V(vsqrtq_f64(a.v)); }
+inline V abs ( const V &a ) { return V(vabsq_f64(a.v)); }
+inline V max ( const V &a, const V &b ) { return V(vmaxq_f64(a.v,b.v)); }
+inline V min ( const V &a, const V &b ) { return V(vminq_f64(a.v,b.v)); }
+inline uint64x2_t lt( const V &a, const V &b ) { return vcltq_f64(a.v,b.v); }
+inline uint64x2_t le( const V &a, const V &b ) { return vcleq_f64(a.v,b.v); }
+inline uint64x2_t gt( const V &a, const V &b ) { return vcgtq_f64(a.v,b.v); }
+inline uint64x2_t mask_or( uint64x2_t a, uint64x2_t b ) { return vorrq_u64(a,b); }
+inline V select( uint64x2_t m, const V &a, const V &b ) { return V(vbslq_f64(m,a.v,b.v)); }
+inline int movemask( uint64x2_t m ) {
+    return static_cast<int>((vgetq_lane_u64(m,0) & 1) | ((vgetq_lane_u64(m,1) & 1) << 1));
+}
+
+// 64-bit integer compares are native, so FastPow vectorizes
+#define LANE_FAST_POW
+#include "SimdKernel.inl"
+
+} // namespace lanes_neon
+
+void integrateLanes_neon( const laneSystem &sys, lanePixels &pix ) {
+    lanes_neon::integrateLanes(sys,pix);
+}
+
+#endif // MPSIM_HAVE_NEON_LANES
@@ -0,0 +1,68 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief SSE2 lanes (2 pixels per vector).
+    @file SimdStepper_sse2.cpp
+*/
+
+#include "SimdStepper.h"
+
+#include <cmath>
+
+#ifdef MPSIM_HAVE_X86_LANES
+#include <emmintrin.h>
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+namespace lanes_sse2 {
+
+struct V {
+    typedef __m128d mask;
+    static const int width = 2;
+
+    __m128d v;
+    V() {}
+    V( __m128d a ) : v(a) {}
+    V( double a ) : v(_mm_set1_pd(a)) {}
+    static V load( const double* p ) { return V(_mm_load_pd(p)); }
+    void store( double* p ) const { _mm_store_pd(p,v); }
+};
+
+inline V operator+( const V &a, const V &b ) { return V(_mm_add_pd(a.v,b.v)); }
+inline V operator-( const V &a, const V &b ) { return V(_mm_sub_pd(a.v,b.v)); }
+inline V operator*( const V &a, const V &b ) { return V(_mm_mul_pd(a.v,b.v)); }
+inline V operator/( const V &a, const V &b ) { return V(_mm_div_pd(a.v,b.v)); }
+inline V sqrt( const V &a ) { return V(_mm_sqrt_pd(a.v)); }
+inline V abs ( const V &a ) { return V(_mm_andnot_pd(_mm_set1_pd(-0.0),a.v)); }
+inline V max ( const V &a, const V &b ) { return V(_mm_max_pd(a.v,b.v)); }
+inline V min ( const V &a, const V &b ) { return V(_mm_min_pd(a.v,b.v)); }
+inline __m128d lt( const V &a, const V &b ) { return _mm_cmplt_pd(a.v,b.v); }
+inline __m128d le( const V &a, const V &b ) { return _mm_cmple_pd(a.v,b.v); }
+inline __m128d gt( const V &a, const V &b ) { return _mm_cmpgt_pd(a.v,b.v); }
+inline __m128d mask_or( __m128d a, __m128d b ) { return _mm_or_pd(a,b); }
+inline V select( __m128d m, const V &a, const V &b ) {
+    return V(_mm_or_pd(_mm_and_pd(m,a.v),_mm_andnot_pd(m,b.v)));
+}
+inline int movemask( __m128d m ) { return _mm_movemask_pd(m); }
+
+#include "SimdKernel.inl"
+
+} // namespace lanes_sse2
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+void integrateLanes_sse2( const laneSystem &sys, lanePixels &pix ) {
+    lanes_sse2::integrateLanes(sys,pix);
+}
+
+#endif // MPSIM_HAVE_X86_LANES
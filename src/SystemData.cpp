@@ -13,36 +13,16 @@
 #include "OpenGL2d.h"
 
 
+#include <algorithm>
+
 #include <QCoreApplication>
 #include <QDir>
 #include <QMessageBox>
 #include <QTextStream>
 
-#define DEF_MAX(x,y)  ((x)>(y)?(x):(y))
-#define DEF_MIN(x,y)  ((x)<(y)?(x):(y))
-
-#define  SAFETY 0.9
-#define  PGROW  -0.2
-#define  PSHRNK -0.25
-#define  ERRCON 1.89e-4
-#define  TINY   1.0e-30
-
-double
-b21 = 0.2, b31 = 3.0/40.0, b32 = 9.0/40.0, b41 = 0.3, b42 = -0.9, b43 = 1.2,
-b51 = -11.0/54.0, b52 = 2.5, b53 = -70.0/27.0, b54 = 35.0/27.0,
-b61 = 1631.0/55296.0, b62 = 175.0/512.0, b63 = 575.0/13824.0,
-b64 = 44275.0/110592.0, b65 = 253.0/4096.0,
-c1 = 37.0/378.0, c3 = 250.0/621.0, c4=125.0/594.0, c6 =512.0/1771.0,
-dc5 = -277.0/14336.0;
-
-double dc1 = c1-2825.0/27648.0, dc3 = c3-18575.0/48384.0, dc4 = c4-13525.0/55296.0,
-dc6 = c6-0.25;
-
-
 
 SystemData::SystemData() :
     mOpenGL2d(NULL),
-    m_trajectory(NULL),
     m_timer(NULL)
 {
     ResetParams();
@@ -66,15 +46,20 @@ SystemData::SystemData() :
     k_diffuse = 0.8f;
     k_specular = 0.0f;
     k_exp = 120.0f;
+
+    // the service calls back from its worker thread
+    m_trajService.SetNotify([this]() {
+        QMetaObject::invokeMethod(this,"fetchTrajectory",Qt::QueuedConnection);
+    });
+    m_trajService.Start();
 }
 
 
 SystemData::~SystemData() {
+    m_trajService.Stop();
     m_timer->stop();
     delete m_timer;
     mOpenGL2d = NULL;
-    delete [] m_trajectory;
-    m_trajTime.clear();
 }
 
 
@@ -108,32 +93,35 @@ void SystemData::ResetParams() {
     m_damping = 1.0;
     m_kappa = 1.0;
     m_magFactor = 0.01;
+    m_magnetRadius = 0.0;
     m_maxTheta = 5.0;
+    m_fieldGrid = 0;
+    m_treeTheta = 0.0;
 
     m_rmax = 1.0;
     m_rmaxX = 1.0;
     m_rmaxY = 1.0;
+    m_simWidth = m_simHeight = 0;
+    m_supersample = 1;
 
     m_numPoints = 0;
     m_maxNumPoints = 1500;
     m_lineWidth = 2;
-#ifdef HAVE_COMP_SHADER      
     m_lineColor = Qt::black;
-#else
-    m_lineColor = Qt::white;
-#endif    
 
     m_tScale = 1.0;
+    m_integrator = RK_CASH_KARP;
 
-    m_trajectory = new float[m_maxNumPoints*4];
     m_currAnimPos = glm::vec2(0,0);
     m_currIndex = 0;
     m_currAnimTime = 0.0f;
 }
 
 void SystemData::ResetAnim() {
-    if (m_trajectory!=NULL) {
-        m_currAnimPos = glm::vec2(m_trajectory[0],m_trajectory[1]);
+    if (m_numPoints>0) {
+        double y[4];
+        Trajectory().store.State(0,y);
+        m_currAnimPos = glm::vec2(y[0],y[1]);
     } else {
         m_currAnimPos = glm::vec2(0);
     }
@@ -141,7 +129,8 @@ void SystemData::ResetAnim() {
     m_currIndex = 0;
 }
 
-void SystemData::calcRHS( double *y, double *rhs ) {
+void SystemData::calcRHS( const double *y, double *rhs ) const {
+#ifdef USE_SPHERICAL
     double l  = m_pendulumLength;
     double z0 = m_pendulumHeight;
     double g  = m_gravity;
@@ -149,7 +138,6 @@ void SystemData::calcRHS( double *y, double *rhs ) {
     double mf = m_magFactor;
     double kappa = m_kappa;
 
-#ifdef USE_SPHERICAL
     double theta = y[0];
     double phi   = y[1];
     double Dth   = y[2];
@@ -169,211 +157,139 @@ void SystemData::calcRHS( double *y, double *rhs ) {
     double alpha,rx,ry,rz,numer;
     double M1 = 0.0;
     double M2 = 0.0;
-    for(unsigned int i=0; i<m_magnets.size(); i++) {
-        alpha = m_magnets[i].alpha*mf;
-        rx = l*sth*cph - m_magnets[i].pos.x;
-        ry = l*sth*sph - m_magnets[i].pos.y;
-        rz = z0 - l*cth - m_magnets[i].pos.z;
-        numer = pow(sqrt(rx*rx + ry*ry + rz*rz),-2.0-kappa);
-
-        M1 += kappa*alpha/l*(rx*cth*cph + ry*cth*sph + rz*sth)*numer;
-        M2 += kappa*alpha/(l*sth)*(-rx*sph + ry*cph)*numer;
+    const MagnetTree &tree = m_magnetTable.Tree();
+    if (tree.IsValid()) {
+        double P[3] = { l*sth*cph, l*sth*sph, z0 - l*cth };
+        double F[3];
+        tree.Field(P,F);
+        M1 = (F[0]*cth*cph + F[1]*cth*sph + F[2]*sth)/l;
+        M2 = (-F[0]*sph + F[1]*cph)/(l*sth);
+    } else {
+        for(unsigned int i=0; i<m_magnets.size(); i++) {
+            alpha = m_magnets[i].alpha*mf;
+            rx = l*sth*cph - m_magnets[i].pos.x;
+            ry = l*sth*sph - m_magnets[i].pos.y;
+            rz = z0 - l*cth - m_magnets[i].pos.z;
+            numer = pow(sqrt(rx*rx + ry*ry + rz*rz),-2.0-kappa);
+
+            M1 += kappa*alpha/l*(rx*cth*cph + ry*cth*sph + rz*sth)*numer;
+            M2 += kappa*alpha/(l*sth)*(-rx*sph + ry*cph)*numer;
+        }
     }
     rhs[2] -= M1;
     rhs[3] -= M2;
 
 #else
-
-    double xx = y[0];
-    double yy = y[1];
-    double dx = y[2];
-    double dy = y[3];
-
-    rhs[0] = y[2];
-    rhs[1] = y[3];
-    rhs[2] = -gamma*dx - g/l*xx;
-    rhs[3] = -gamma*dy - g/l*yy;
-
-    double alpha,numer,rx,ry,rz;
-    double M1 = 0.0;
-    double M2 = 0.0;
-    for(int i=0; i<m_magnets.size(); i++) {
-        alpha = m_magnets[i].alpha*mf;
-        rx = xx - m_magnets[i].pos.x;
-        ry = yy - m_magnets[i].pos.y;
-        rz = z0-l - m_magnets[i].pos.z;
-        numer = pow(sqrt(rx*rx + ry*ry + rz*rz),-2.0-kappa);
-
-        M1 += kappa*alpha*rx*numer;
-        M2 += kappa*alpha*ry*numer;
-    }
-    rhs[2] -= M1;
-    rhs[3] -= M2;
+    // the magnet table is built by SyncParams()
+    m_magnetTable.CalcRHS(y,rhs);
 #endif
 }
 
 /**
- *  Runge-Kutta Cash-Karp step
+ *  Only the newest request is integrated; see TrajectoryService. The bob is
+ *  integrated as long as a pixel of the basin map; m_maxNumPoints only limits
+ *  the drawn line.
  */
-void SystemData::rkck( double *y, double *dydx, int n, double h,
-                       double *yout, double *yerr )
-{
-    register int i;
-    double *ak2 = new double[n];
-    double *ak3 = new double[n];
-    double *ak4 = new double[n];
-    double *ak5 = new double[n];
-    double *ak6 = new double[n];
-    double *ytemp = new double[n];
-
-    for(i=0; i<n; i++) {
-        ytemp[i] = y[i] + h * b21 * dydx[i];
-    }
-
-    calcRHS( ytemp, ak2);
-    for(i=0; i<n; i++) {
-        ytemp[i] = y[i] + h * (b31*dydx[i] + b32*ak2[i]);
-    }
-
-    calcRHS( ytemp, ak3);
-    for(i=0; i<n; i++) {
-        ytemp[i] = y[i] + h * (b41*dydx[i] + b42*ak2[i] + b43*ak3[i]);
-    }
-
-    calcRHS( ytemp, ak4);
-    for(i=0; i<n; i++) {
-        ytemp[i] = y[i] + h * (b51*dydx[i] + b52*ak2[i] + b53*ak3[i] + b54*ak4[i]);
-    }
-
-    calcRHS( ytemp, ak5);
-    for(i=0; i<n; i++) {
-        ytemp[i] = y[i] + h * (b61*dydx[i] + b62*ak2[i] + b63*ak3[i] + b64*ak4[i] + b65*ak5[i]);
-    }
-
-    calcRHS( ytemp, ak6);
-    for(i=0; i<n; i++) {
-        yout[i] = y[i] + h * (c1*dydx[i] + c3*ak3[i] + c4*ak4[i] + c6*ak6[i]);
-        yerr[i] = h * (dc1*dydx[i] + dc3*ak3[i] + dc4*ak4[i] + dc5*ak5[i] + dc6*ak6[i]);
-    }
-
-    delete [] ytemp;
-    delete [] ak6;
-    delete [] ak5;
-    delete [] ak4;
-    delete [] ak3;
-    delete [] ak2;
+void SystemData::CalcTrajectory(double initX, double initY) {
+    PendulumParams params;
+    GetParams(params);
+    double maxTime = (mOpenGL2d!=NULL ? mOpenGL2d->MaxTime() : TRAJ_MAX_TIME);
+    m_trajService.Request(params,initX,initY,maxTime,m_maxNumPoints,m_trajLine.Tolerance());
 }
 
+void SystemData::CancelTrajectory() {
+    m_trajService.Cancel();
+    m_trajLine.Clear();
+    m_numPoints = 0;
+}
 
 /**
- *  stepper function
+ *  Called in the GUI thread whenever the service has published a trajectory.
  */
-void SystemData::rkqs( double *y, double *dydx, int n, double *t,
-                       double htry, double eps, double *yscal, double &hdid, double &hnext )
-{
-    register int i;
-    double errmax, h, htemp, *yerr, *ytemp;
-
-    yerr  = new double[n];
-    ytemp = new double[n];
-
-    h = htry;
-    for(;;) {
-        rkck( y, dydx, n, h, ytemp, yerr );
-
-        errmax = 0.0;
-        for(i=0; i<n; i++) {
-            errmax = DEF_MAX( errmax, fabs(yerr[i]/yscal[i]) );
-        }
-        errmax /= eps;
-
-        if (errmax <= 1.0) {  // Step succeeded. Compute size of next step.
-            break;
-        }
-
-        htemp = SAFETY * h * pow(errmax, PSHRNK);
-        h = (h>=0.0 ? DEF_MAX(htemp,0.1*h) : DEF_MIN(htemp,0.1*h));
-        if (h<1e-8) {
-            break;
-        }
+void SystemData::fetchTrajectory() {
+    if (!m_trajService.Fetch()) {
+        return;
     }
-
-    if (errmax > ERRCON) {
-        hnext = SAFETY * h * pow(errmax,PGROW);
+    const trajectory &traj = Trajectory();
+    m_numPoints = std::min(traj.store.NumNodes(),m_maxNumPoints);
+    if (traj.line.NumInput()==m_numPoints && traj.line.Tolerance()==m_trajLine.Tolerance()) {
+        m_trajLine = traj.line;
     } else {
-        hnext = 5.0*h;
+        m_trajLine.Simplify(traj.store,m_numPoints);
     }
-
-    *t += (hdid=h);
-    for(i=0; i<n; i++) {
-        y[i] = ytemp[i];
+    m_currIndex = 0;
+    if (m_numPoints>1) {
+        m_currAnimTime = static_cast<float>(traj.store.StartTime());
     }
-
-    delete [] yerr;
-    delete [] ytemp;
+    emit trajectoryChanged();
 }
 
+/**
+ *  The trajectory stays in the front buffer of the service until the next
+ *  fetchTrajectory(); nothing is copied.
+ */
+const trajectory& SystemData::Trajectory() const {
+    return m_trajService.Latest();
+}
 
-void SystemData::CalcTrajectory(double initX, double initY) {
-    double y[4], yscal[4], dydx[4];
-    double h = 0.005;
-    y[0] = initX;
-    y[1] = initY;
-    y[2] = 0.0;
-    y[3] = 0.0;
-
-    if (m_trajectory==NULL) {
-        m_trajectory = new float[m_maxNumPoints*4];
+/**
+ *  The service simplifies new trajectories with the tolerance of the request;
+ *  only the current one has to be simplified again when the view scale changes.
+ */
+bool SystemData::SetLineTolerance( double eps ) {
+    if (eps==m_trajLine.Tolerance()) {
+        return false;
     }
-    m_trajTime.clear();
-
-    int N = m_maxNumPoints;
-    float* fptr = m_trajectory;
-
-    double t = 0.0;
-    double hdid;
-    double hnext = h;
-
-    m_numPoints = 0;
-    register int nstp,i;
-
-    for(nstp=0; nstp<N; nstp++) {
-#ifdef USE_SPHERICAL
-        *(fptr++) = static_cast<float>(l*sin(y[0])*cos(y[1]));
-        *(fptr++) = static_cast<float>(l*sin(y[0])*sin(y[1]));
-#else
-        *(fptr++) = static_cast<float>(y[0]);
-        *(fptr++) = static_cast<float>(y[1]);
-#endif
-        *(fptr++) = static_cast<float>(y[2]);
-        *(fptr++) = static_cast<float>(y[3]);
-        m_trajTime.push_back(t);
-
-        //fprintf(stdout,"%f %f\n",pos[nstp*4+0],pos[nstp*4+1]);
-
-        calcRHS(y,dydx);
-        for(i=0; i<4; i++) {
-            yscal[i] = fabs(y[i]) + fabs(dydx[i]*h) + TINY;
-        }
-        rkqs(y,dydx,4,&t,h,1e-8,yscal,hdid,hnext);
-        t += hdid;
+    m_trajLine.SetTolerance(eps);
+    m_trajLine.Simplify(Trajectory().store,m_numPoints);
+    return true;
+}
 
-        m_numPoints = m_numPoints+1;
-        if (fabs(hnext)<1e-8) {
-            break;
+void SystemData::GetParams( PendulumParams &params ) const {
+    params.m_pendulumLength = m_pendulumLength;
+    params.m_pendulumHeight = m_pendulumHeight;
+    params.m_gravity = m_gravity;
+    params.m_damping = m_damping;
+    params.m_kappa = m_kappa;
+    params.m_magFactor = m_magFactor;
+    params.m_magnetRadius = m_magnetRadius;
+    params.m_maxTheta = m_maxTheta;
+    params.m_fieldGrid = m_fieldGrid;
+    params.m_treeTheta = m_treeTheta;
+    params.m_integrator = m_integrator;
+
+    params.m_magnets.clear();
+    for(int m=0; m<m_magnets.size(); m++) {
+        magnetParams mp;
+        mp.x = m_magnets[m].pos.x;
+        mp.y = m_magnets[m].pos.y;
+        mp.z = m_magnets[m].pos.z;
+        mp.alpha = m_magnets[m].alpha;
+        for(int c=0; c<4; c++) {
+            mp.color[c] = m_magnets[m].color[c];
         }
-        h = hnext;
-    }
-    //std::cerr << m_numPoints << " " << (*vbo) << std::endl;
-    if (m_numPoints>1) {
-        m_currAnimTime = m_trajTime.at(0);
+        params.m_magnets.push_back(mp);
     }
 }
 
-void SystemData::UpdateTrajectory(unsigned int *vbo) {
-    glBindBuffer( GL_ARRAY_BUFFER, *vbo );
-    glBufferSubData( GL_ARRAY_BUFFER, 0, sizeof(float)*m_numPoints*4,m_trajectory);
-    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+void SystemData::SyncParams() {
+    PendulumParams params;
+    GetParams(params);
+    if (m_magnetTable.Size()>0 && params==m_syncedParams) {
+        return;
+    }
+    m_syncedParams = params;
+    m_magnetTable.Build(params);
+    m_magnetTable.BuildTree(params);
+    m_magnetTable.BuildFieldGrid(params);
+    m_equilibria.Solve(params);
+
+    const FieldGrid &grid = m_magnetTable.Grid();
+    if (grid.IsValid()) {
+        double maxAbs, maxRel;
+        grid.EstimateError(m_magnetTable,maxAbs,maxRel);
+        fprintf(stderr,"Field grid %dx%d: max. error %g (%g relative)\n",grid.NumNodes(),grid.NumNodes(),maxAbs,maxRel);
+    }
 }
 
 void SystemData::LoadParams( QString filename ) {
@@ -405,6 +321,20 @@ void SystemData::LoadParams( QString filename ) {
                     else if (sepLine[0].compare("maxTheta")==0) {
                         m_maxTheta = sepLine[1].toDouble();
                     }
+                    else if (sepLine[0].compare("magnetRadius")==0) {
+                        m_magnetRadius = sepLine[1].toDouble();
+                    }
+                    else if (sepLine[0].compare("fieldGrid")==0) {
+                        m_fieldGrid = sepLine[1].toInt();
+                    }
+                    else if (sepLine[0].compare("treeTheta")==0) {
+                        m_treeTheta = sepLine[1].toDouble();
+                    }
+                    else if (sepLine[0].compare("integrator")==0) {
+                        if (!RKMethodFromName(sepLine[1].toStdString().c_str(),m_integrator)) {
+                            fprintf(stderr,"Unknown integrator %s\n",sepLine[1].toStdString().c_str());
+                        }
+                    }
                     else if (sepLine[0].compare("magnet")==0 && sepLine.size()>6) {
                         magnetProps mp = { glm::vec3( sepLine[1].toFloat(), sepLine[2].toFloat(),0.0),
                                            sepLine[6].toFloat(),
@@ -441,6 +371,10 @@ void SystemData::SaveParams( QString filename ) {
         ts << "damping " << m_kappa << endl;
         ts << "magFactor " << m_magFactor << endl;
         ts << "maxTheta " << m_maxTheta << endl;
+        ts << "magnetRadius " << m_magnetRadius << endl;
+        ts << "fieldGrid " << m_fieldGrid << endl;
+        ts << "treeTheta " << m_treeTheta << endl;
+        ts << "integrator " << RKMethodName(m_integrator) << endl;
         ts << endl;
         for(int m=0; m<m_magnets.size(); m++) {
             ts << "magnet " << m_magnets[m].pos.x << " " << m_magnets[m].pos.y << " "
@@ -462,18 +396,15 @@ bool SystemData::CalcNextPos() {
 
     if (m_currIndex < m_numPoints-1) {
         m_currAnimTime += m_animateTimer->interval() * 0.001f * TIMER_INTERVAL * TIMER_SCALING;
-        int i = m_currIndex;
-        while (i>=0 && i<(int)m_trajTime.size()-1) {
-            if (m_currAnimTime>=m_trajTime[i] && m_currAnimTime < m_trajTime[i+1]) {
-                m_currIndex = i;
-                float t = (m_currAnimTime - m_trajTime[i])/(m_trajTime[i+1] - m_trajTime[i]);
-                glm::vec2 p1 = glm::vec2(m_trajectory[4*i+0],m_trajectory[4*i+1]);
-                glm::vec2 p2 = glm::vec2(m_trajectory[4*(i+1)+0],m_trajectory[4*(i+1)+1]);
-                m_currAnimPos = p1 + t*(p2-p1);
-                //fprintf(stderr,"%f  %f %f\n",m_currAnimTime,m_currAnimPos.x,m_currAnimPos.y);
-                return true;
-            }
-            i++;
+        // dense output of the integrator instead of a linear interpolation
+        const TrajectoryStore &store = Trajectory().store;
+        if (m_currAnimTime < store.Time(m_numPoints-1)) {
+            double y[4];
+            m_currIndex = store.Find(m_currAnimTime);
+            store.Evaluate(m_currAnimTime,y);
+            m_currAnimPos = glm::vec2(y[0],y[1]);
+            //fprintf(stderr,"%f  %f %f\n",m_currAnimTime,m_currAnimPos.x,m_currAnimPos.y);
+            return true;
         }
     }
     return false;
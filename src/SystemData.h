@@ -22,10 +22,16 @@
 #define BOB_COLOR_ID           15000
 #define TIMER_INTERVAL            10
 #define TIMER_SCALING           0.1f
+#define TRAJ_MAX_TIME          100.0   // maximum time of a trajectory without a 2D view
 
 class OpenGL2d;
 
 #include "glm.hpp"
+#include "Equilibria.h"
+#include "MagnetTable.h"
+#include "PendulumParams.h"
+#include "RKStepper.h"
+#include "TrajectoryService.h"
 
 typedef struct magnetProps_t {
     glm::vec3 pos;
@@ -48,12 +54,37 @@ public:
     void   AddObjectsToScriptEngine ( QScriptEngine* engine );   //!< Add this object to the script engine.
     void   setOpenGLPtr             ( OpenGL2d* ogl );
 
+    /** Request the trajectory from (initX,initY) from the trajectory service.
+     *  It replaces the current one once it is done; see trajectoryChanged().
+     */
     void   CalcTrajectory(double initX, double initY);
-    void   UpdateTrajectory(unsigned int *vbo);
+    void   CancelTrajectory();    //!< Drop outstanding requests and clear the trajectory.
+
+    /** Current trajectory; only its first m_numPoints nodes are shown.
+     */
+    const trajectory&  Trajectory() const;
+
+    /** Tolerance of the drawn line, usually half a pixel.
+     * @return true if the line was simplified again.
+     */
+    bool   SetLineTolerance( double eps );
     void   LoadParams( QString filename );
     void   SaveParams( QString filename );
     bool   CalcNextPos();
 
+    /** Equations of motion; called by the Stepper.
+     */
+    void   calcRHS( const double *y, double *rhs ) const;
+
+    /** Copy the physical parameters into a Qt-free parameter set.
+     */
+    void   GetParams( PendulumParams &params ) const;
+
+    /** Rebuild magnet table and equilibria if any parameter has changed
+     *  since the last call.
+     */
+    void   SyncParams();
+
     glm::vec3    idToColor( unsigned int id );
     unsigned int colorToId( unsigned char buf[3] );
 
@@ -64,12 +95,10 @@ public slots:
 
 signals:
     void   dataRead();
+    void   trajectoryChanged();
 
-
-private:
-    void  calcRHS( double *y, double *rhs );
-    void  rkck( double *y, double *dydx, int n, double h, double *yout, double *yerr );
-    void  rkqs( double *y, double *dydx, int n, double *t, double htry, double eps, double *yscal, double &hdid, double &hnext );
+private slots:
+    void   fetchTrajectory();
 
 private:
     OpenGL2d*   mOpenGL2d;
@@ -81,14 +110,22 @@ public:
     double  m_damping;
     double  m_kappa;
     double  m_magFactor;
+    double  m_magnetRadius;
     double  m_maxTheta;
+    int     m_fieldGrid;
+    double  m_treeTheta;
     double  m_rmax, m_rmaxX, m_rmaxY;
+    int     m_simWidth, m_simHeight;   //!< resolution of the basin map, 0 for the size of the 2D view
+    int     m_supersample;             //!< samples per pixel and direction
+    rkMethod  m_integrator;
 
     QList<magnetProps>  m_magnets;
+    MagnetTable         m_magnetTable;
+    Equilibria          m_equilibria;
+    PendulumParams      m_syncedParams;
     float   m_magnetSize;
-    float*  m_trajectory;
-    std::vector<float>  m_trajTime;
-    std::vector<float>::iterator m_TrajTimeItr;
+    TrajectoryService   m_trajService;
+    PolylineSimplifier  m_trajLine;    //!< drawn line of the current trajectory
 
     int     m_maxNumPoints;
     int     m_numPoints;
@@ -97,7 +134,6 @@ public:
 
     bool    m_play;
     QTimer* m_timer;
-    int     m_numSteps;
     double  m_tScale;
 
     QTimer* m_animateTimer;
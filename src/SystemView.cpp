@@ -34,7 +34,6 @@ void SystemView::AddObjectsToScriptEngine( QScriptEngine* engine ) {
     engine->globalObject().setProperty("Ctrl",sv);
 }
 
-#ifdef HAVE_COMP_SHADER
 void SystemView::SetView( int view ) {
     if (view==0) {        
         grb_control->setEnabled(true);
@@ -43,9 +42,6 @@ void SystemView::SetView( int view ) {
         grb_control->setEnabled(false);
         grb_anim->setEnabled(true);
     }
-#else
-void SystemView::SetView( int ) {
-#endif // HAVE_COMP_SHADER
 }
 
 void SystemView::SetTimer( bool status ) {
@@ -53,10 +49,12 @@ void SystemView::SetTimer( bool status ) {
         mData->m_timer->setSingleShot(false);
         //        mData->m_time.restart();
         mData->m_timer->start();
+        mOpenGL2d->SetSimulationPlaying(true);
         pub_play->setIcon(QIcon(":/pause.png"));
         pub_step->setEnabled(false);
     } else {
         mData->m_timer->stop();
+        mOpenGL2d->SetSimulationPlaying(false);
         pub_play->setIcon(QIcon(":/play.png"));
         pub_step->setEnabled(true);
     }
@@ -65,6 +63,7 @@ void SystemView::SetTimer( bool status ) {
 
 
 void SystemView::SingleTimeStep() {
+    mOpenGL2d->StepSimulation();
     mData->m_timer->setSingleShot(true);
     mData->m_timer->start();
     mOpenGL2d->updateGL();
@@ -136,6 +135,7 @@ void SystemView::updateParams() {
     mData->m_damping = led_damping->getValue();
     mData->m_kappa   = led_kappa->getValue();
     mData->m_magFactor = led_magFactor->getValue();
+    mData->m_magnetRadius = led_magnetRadius->getValue();
     mData->m_maxTheta = led_maxTheta->getValue();
     mOpenGL2d->ResetParticleSimulation();
     mData->m_numPoints = 0;
@@ -149,6 +149,7 @@ void SystemView::SetAllParams() {
     led_damping->setValue( mData->m_damping );
     led_kappa->setValue( mData->m_kappa );
     led_magFactor->setValue( mData->m_magFactor );
+    led_magnetRadius->setValue( mData->m_magnetRadius );
     led_maxTheta->setValue( mData->m_maxTheta );
     mOpenGL2d->ResetParticleSimulation();
     mData->m_numPoints = 0;
@@ -222,6 +223,16 @@ void SystemView::setLineColor() {
     }
 }
 
+/**
+ *  A width or height of 0 takes the size of the 2D view at the next reset.
+ */
+void SystemView::setResolution() {
+    mData->m_simWidth = spb_simWidth->value();
+    mData->m_simHeight = spb_simHeight->value();
+    mData->m_supersample = cob_supersample->currentIndex()+1;
+    mOpenGL2d->ResetParticleSimulation();
+}
+
 void SystemView::setMaxNumPoints(int num) {
     SetAnimTimer(false);
     mOpenGL2d->SetMaxNumPoints(num);
@@ -252,6 +263,8 @@ void SystemView::initElements() {
     led_kappa   = new DoubleEdit(3, mData->m_kappa, 0.001, true);
     lab_magFactor = new QLabel("magFactor");
     led_magFactor = new DoubleEdit(3, mData->m_magFactor, 0.001, true );
+    lab_magnetRadius = new QLabel("magRadius");
+    led_magnetRadius = new DoubleEdit(3, mData->m_magnetRadius, 0.001, true );
     lab_maxTheta = new QLabel("maxTheta");
     led_maxTheta = new DoubleEdit(2, mData->m_maxTheta, 0.01, true);
 
@@ -264,7 +277,7 @@ void SystemView::initElements() {
     pub_trajColor->setPalette( QPalette( mData->m_lineColor) );
     lab_trajMaxNumPoints = new QLabel("#steps");
     spb_trajMaxNumPoints = new QSpinBox();
-    spb_trajMaxNumPoints->setRange(1,10000);
+    spb_trajMaxNumPoints->setRange(1,1000000);
     spb_trajMaxNumPoints->setValue( mData->m_maxNumPoints );
 
     lab_currMagnet = new QLabel("ID");
@@ -300,6 +313,25 @@ void SystemView::initElements() {
     led_timeScale = new DoubleEdit(2,mData->m_tScale,0.01);
     led_timeScale->setRange(0.0,100.0);
 
+    lab_simSize = new QLabel("Size");
+    spb_simWidth = new QSpinBox();
+    spb_simWidth->setRange(0,8192);
+    spb_simWidth->setSpecialValueText("view");
+    spb_simWidth->setKeyboardTracking(false);
+    spb_simWidth->setValue( mData->m_simWidth );
+    spb_simHeight = new QSpinBox();
+    spb_simHeight->setRange(0,8192);
+    spb_simHeight->setSpecialValueText("view");
+    spb_simHeight->setKeyboardTracking(false);
+    spb_simHeight->setValue( mData->m_simHeight );
+    lab_supersample = new QLabel("Samples");
+    cob_supersample = new QComboBox();
+    cob_supersample->addItem("1x1");
+    cob_supersample->addItem("2x2");
+    cob_supersample->addItem("3x3");
+    cob_supersample->addItem("4x4");
+    cob_supersample->setCurrentIndex( mData->m_supersample-1 );
+
     pub_anim_reset = new QPushButton(QIcon(":/back.png"),"");
     pub_anim_play  = new QPushButton(QIcon(":/play.png"),"");
     pub_anim_play->setCheckable(true);
@@ -328,9 +360,11 @@ void SystemView::initGUI() {
     layout_pend->addWidget( led_kappa, 4, 1 );
     layout_pend->addWidget( lab_magFactor, 5, 0 );
     layout_pend->addWidget( led_magFactor, 5, 1 );
-    layout_pend->addWidget( lab_maxTheta, 6, 0 );
-    layout_pend->addWidget( led_maxTheta, 6, 1 );
-    layout_pend->setRowStretch(7,5);
+    layout_pend->addWidget( lab_magnetRadius, 6, 0 );
+    layout_pend->addWidget( led_magnetRadius, 6, 1 );
+    layout_pend->addWidget( lab_maxTheta, 7, 0 );
+    layout_pend->addWidget( led_maxTheta, 7, 1 );
+    layout_pend->setRowStretch(8,5);
 #else
     layout_pend->addWidget( lab_damping, 0, 0 );
     layout_pend->addWidget( led_damping, 0, 1 );
@@ -374,7 +408,6 @@ void SystemView::initGUI() {
     layout_anim->addWidget( pub_anim_step );
     grb_anim->setLayout(layout_anim);
 
-#ifdef HAVE_COMP_SHADER
     grb_control = new QGroupBox("Control");
     QGridLayout* layout_control = new QGridLayout();
     layout_control->addWidget( pub_reset, 0, 0 );
@@ -384,23 +417,27 @@ void SystemView::initGUI() {
     layout_scale->addWidget( lab_timeScale );
     layout_scale->addWidget( led_timeScale );
     layout_control->addLayout( layout_scale, 1, 0, 1, 3 );
-    layout_control->setRowStretch(2,5);
+    QHBoxLayout* layout_size = new QHBoxLayout();
+    layout_size->addWidget( lab_simSize );
+    layout_size->addWidget( spb_simWidth );
+    layout_size->addWidget( spb_simHeight );
+    layout_control->addLayout( layout_size, 2, 0, 1, 3 );
+    QHBoxLayout* layout_samples = new QHBoxLayout();
+    layout_samples->addWidget( lab_supersample );
+    layout_samples->addWidget( cob_supersample );
+    layout_control->addLayout( layout_samples, 3, 0, 1, 3 );
+    layout_control->setRowStretch(4,5);
     grb_control->setLayout(layout_control);
     grb_control->setEnabled(true);
     grb_anim->setEnabled(false);
-#endif // HAVE_COMP_SHADER
 
 
     QGridLayout* layout_complete = new QGridLayout();
     layout_complete->addWidget( grb_pend, 0, 0 );
     layout_complete->addWidget( grb_magnets, 1, 0 );
     layout_complete->addWidget( grb_traj, 2, 0 );
-#ifdef HAVE_COMP_SHADER      
     layout_complete->addWidget( grb_control, 3, 0 );
     layout_complete->addWidget( grb_anim, 4, 0 );
-#else
-    layout_complete->addWidget( grb_anim, 3, 0 );
-#endif 
 
     QWidget* centralWidget = new QWidget();
     centralWidget->setLayout( layout_complete );
@@ -423,6 +460,7 @@ void SystemView::initConnect() {
     connect( led_damping, SIGNAL(returnPressed()), this, SLOT(updateParams()) );
     connect( led_kappa, SIGNAL(returnPressed()), this, SLOT(updateParams()) );
     connect( led_magFactor, SIGNAL(returnPressed()), this, SLOT(updateParams()) );
+    connect( led_magnetRadius, SIGNAL(returnPressed()), this, SLOT(updateParams()) );
     connect( led_maxTheta, SIGNAL(returnPressed()), this, SLOT(updateParams()) );
 
     connect( spb_trajWidth, SIGNAL(valueChanged(int)), this, SLOT(setLineWidth(int)) );
@@ -435,12 +473,13 @@ void SystemView::initConnect() {
     connect( led_alpha, SIGNAL(returnPressed()), this, SLOT(setMagnetParams()) );
     connect( pub_color, SIGNAL(pressed()), this, SLOT(setMagnetColor()) );
 
-#ifdef HAVE_COMP_SHADER  
     connect( pub_play, SIGNAL(toggled(bool)), this,      SLOT(SetTimer(bool)) );
     connect( pub_step, SIGNAL(pressed()),     this,      SLOT(SingleTimeStep()) );
     connect( pub_reset, SIGNAL(pressed()),    this,      SLOT(Reset()) );
     connect( led_timeScale, SIGNAL(editingFinished()), this, SLOT(setTScale()) );
-#endif // HAVE_COMP_SHADER      
+    connect( spb_simWidth, SIGNAL(valueChanged(int)), this, SLOT(setResolution()) );
+    connect( spb_simHeight, SIGNAL(valueChanged(int)), this, SLOT(setResolution()) );
+    connect( cob_supersample, SIGNAL(currentIndexChanged(int)), this, SLOT(setResolution()) );
     connect( pub_anim_play,  SIGNAL(toggled(bool)), this, SLOT(SetAnimTimer(bool)) );
     connect( pub_anim_reset, SIGNAL(pressed()), this, SLOT(AnimReset()) );
     connect( pub_anim_step,  SIGNAL(pressed()), this, SLOT(SingleAnimTimeStep()) );
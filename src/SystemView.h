@@ -74,6 +74,7 @@ protected slots:
     void setLineWidth(int);
     void setLineColor();
     void setMaxNumPoints(int);
+    void setResolution();
 
 signals:
     void emitReset();
@@ -108,6 +109,8 @@ private:
     DoubleEdit*   led_kappa;
     QLabel*       lab_magFactor;
     DoubleEdit*   led_magFactor;
+    QLabel*       lab_magnetRadius;
+    DoubleEdit*   led_magnetRadius;
     QLabel*       lab_maxTheta;
     DoubleEdit*   led_maxTheta;
 
@@ -134,6 +137,11 @@ private:
     QPushButton*  pub_step;
     QLabel*       lab_timeScale;
     DoubleEdit*   led_timeScale;
+    QLabel*       lab_simSize;
+    QSpinBox*     spb_simWidth;
+    QSpinBox*     spb_simHeight;
+    QLabel*       lab_supersample;
+    QComboBox*    cob_supersample;
 
     QPushButton*  pub_anim_reset;
     QPushButton*  pub_anim_play;
@@ -0,0 +1,151 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file TileScheduler.cpp
+*/
+
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+
+TileScheduler::TileScheduler() {
+}
+
+TileScheduler::~TileScheduler() {
+    for(unsigned int i=0; i<m_queues.size(); i++) {
+        delete m_queues[i];
+    }
+    m_queues.clear();
+}
+
+void TileScheduler::SetImage( int width, int height, int tileSize ) {
+    m_tiles.clear();
+    if (tileSize<1) {
+        tileSize = 1;
+    }
+    for(int y=0; y<height; y+=tileSize) {
+        for(int x=0; x<width; x+=tileSize) {
+            basinTile tile = { x, y, (x+tileSize<width ? x+tileSize : width), (y+tileSize<height ? y+tileSize : height) };
+            m_tiles.push_back(tile);
+        }
+    }
+    m_costs.clear();
+}
+
+void TileScheduler::SetCosts( const std::vector<double> &costs ) {
+    m_costs = costs;
+}
+
+void TileScheduler::Run( int numThreads, std::function<void(const basinTile&)> func ) {
+    if (numThreads<1) {
+        numThreads = NumCores();
+    }
+
+    for(unsigned int i=0; i<m_queues.size(); i++) {
+        delete m_queues[i];
+    }
+    m_queues.clear();
+    for(int i=0; i<numThreads; i++) {
+        m_queues.push_back(new workQueue);
+    }
+    if (static_cast<int>(m_costs.size())==NumTiles()) {
+        distributeByCost(numThreads);
+    } else {
+        for(int t=0; t<NumTiles(); t++) {
+            m_queues[t % numThreads]->tiles.push_back(t);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    for(int i=1; i<numThreads; i++) {
+        workers.push_back(std::thread(&TileScheduler::workerLoop,this,i,func));
+    }
+    workerLoop(0,func);
+    for(unsigned int i=0; i<workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+int TileScheduler::NumTiles() const {
+    return static_cast<int>(m_tiles.size());
+}
+
+const basinTile& TileScheduler::Tile( int num ) const {
+    return m_tiles[num];
+}
+
+int TileScheduler::NumCores() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return (n>0 ? static_cast<int>(n) : 1);
+}
+
+/**
+ *  Take the next tile from the own queue or steal one from the back of
+ *  another queue.
+ * @param worker  Index of calling worker.
+ * @param tile    Reference to tile index.
+ * @return false if there is no tile left.
+ */
+bool TileScheduler::nextTile( int worker, int &tile ) {
+    {
+        workQueue* q = m_queues[worker];
+        std::lock_guard<std::mutex> lock(q->mutex);
+        if (!q->tiles.empty()) {
+            tile = q->tiles.front();
+            q->tiles.pop_front();
+            return true;
+        }
+    }
+
+    int num = static_cast<int>(m_queues.size());
+    for(int i=1; i<num; i++) {
+        workQueue* q = m_queues[(worker+i) % num];
+        std::lock_guard<std::mutex> lock(q->mutex);
+        if (!q->tiles.empty()) {
+            tile = q->tiles.back();
+            q->tiles.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ *  Longest processing time first: the queues end up sorted by decreasing cost.
+ *  Tiles of equal cost keep their order.
+ */
+void TileScheduler::distributeByCost( int numThreads ) {
+    std::vector<int> order(NumTiles());
+    for(int t=0; t<NumTiles(); t++) {
+        order[t] = t;
+    }
+    std::stable_sort(order.begin(),order.end(),[this](int a, int b) {
+        return m_costs[a]>m_costs[b];
+    });
+
+    std::vector<double> load(numThreads,0.0);
+    for(unsigned int i=0; i<order.size(); i++) {
+        int least = 0;
+        for(int w=1; w<numThreads; w++) {
+            if (load[w]<load[least]) {
+                least = w;
+            }
+        }
+        load[least] += m_costs[order[i]];
+        m_queues[least]->tiles.push_back(order[i]);
+    }
+}
+
+void TileScheduler::workerLoop( int worker, std::function<void(const basinTile&)> func ) {
+    int tile;
+    while (nextTile(worker,tile)) {
+        func(m_tiles[tile]);
+    }
+}
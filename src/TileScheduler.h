@@ -0,0 +1,87 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the work-stealing tile scheduler.
+    @file TileScheduler.h
+*/
+
+#ifndef MPSIM_TILE_SCHEDULER_H
+#define MPSIM_TILE_SCHEDULER_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+typedef struct basinTile_t {
+    int x0, y0;     //!< lower left pixel
+    int x1, y1;     //!< upper right pixel (exclusive)
+} basinTile;
+
+
+/**
+ * @brief The TileScheduler class
+ *
+ *  Every worker thread owns a deque of tile indices. A worker takes tiles from the
+ *  front of its own deque and, if that one is empty, steals from the back of the
+ *  deque of another worker. Tiles are initially distributed round-robin so that
+ *  neighbouring tiles, which have similar cost, end up on different workers.
+ *
+ *  If the costs of the tiles are known in advance, see SetCosts(), the tiles are
+ *  instead sorted by decreasing cost and each one is given to the worker with
+ *  the least total cost so far (longest processing time first). Every worker
+ *  thus starts with its most expensive tile, and what is stolen from the back
+ *  are the cheap ones, which keeps the workers finishing at about the same time.
+ */
+class TileScheduler
+{
+public:
+    TileScheduler();
+    ~TileScheduler();
+
+public:
+    /** Split image into tiles.
+     * @param width     Image width in pixels.
+     * @param height    Image height in pixels.
+     * @param tileSize  Edge length of a tile in pixels.
+     */
+    void  SetImage( int width, int height, int tileSize );
+
+    /** Set the predicted cost of every tile for the next Run(), in the order
+     *  of Tile(). An empty vector restores the round-robin distribution.
+     */
+    void  SetCosts( const std::vector<double> &costs );
+
+    /** Process all tiles.
+     * @param numThreads  Number of worker threads; 0 uses all cores.
+     * @param func        Function that is called for every tile.
+     */
+    void  Run( int numThreads, std::function<void(const basinTile&)> func );
+
+    int   NumTiles() const;
+    const basinTile& Tile( int num ) const;
+
+    static int  NumCores();
+
+protected:
+    bool  nextTile( int worker, int &tile );
+    void  distributeByCost( int numThreads );
+    void  workerLoop( int worker, std::function<void(const basinTile&)> func );
+
+private:
+    struct workQueue {
+        std::mutex       mutex;
+        std::deque<int>  tiles;
+    };
+
+    std::vector<basinTile>  m_tiles;
+    std::vector<double>     m_costs;
+    std::vector<workQueue*> m_queues;
+};
+
+#endif // MPSIM_TILE_SCHEDULER_H
@@ -0,0 +1,235 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file TrajectoryService.cpp
+*/
+
+#include "TrajectoryService.h"
+
+#include <cmath>
+
+#define TRAJ_INDEX_MASK  3
+#define TRAJ_FRESH       4   // set in m_ready until the consumer takes the buffer
+
+
+TrajectoryService::TrajectoryService() :
+    m_quit(false),
+    m_pending(false),
+    m_newest(0),
+    m_cancelled(0),
+    m_valid(false),
+    m_back(0),
+    m_front(2),
+    m_ready(1),
+    m_numFinished(0),
+    m_numCancelled(0)
+{
+    for(int i=0; i<3; i++) {
+        m_buffers[i].x0 = m_buffers[i].y0 = 0.0;
+        m_buffers[i].request = 0;
+        m_buffers[i].trapped = false;
+    }
+}
+
+TrajectoryService::~TrajectoryService() {
+    Stop();
+}
+
+void TrajectoryService::Start() {
+    if (m_thread.joinable()) {
+        return;
+    }
+    m_quit = false;
+    m_thread = std::thread(&TrajectoryService::workerLoop,this);
+}
+
+void TrajectoryService::Stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_mutex.lock();
+    m_quit = true;
+    m_pending = false;
+    m_newest++;
+    m_mutex.unlock();
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+unsigned int TrajectoryService::Request( const PendulumParams &params, double x0, double y0, double maxTime,
+                                        int maxNumPoints, double tolerance ) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_request.params = params;
+    m_request.x0 = x0;
+    m_request.y0 = y0;
+    m_request.maxTime = maxTime;
+    m_request.maxNumPoints = maxNumPoints;
+    m_request.tolerance = tolerance;
+    m_request.number = ++m_newest;
+    m_pending = true;
+    m_wake.notify_all();
+    return m_request.number;
+}
+
+void TrajectoryService::Cancel() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending = false;
+    m_cancelled = ++m_newest;
+}
+
+void TrajectoryService::SetNotify( std::function<void()> func ) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_notify = func;
+}
+
+bool TrajectoryService::Fetch() {
+    if ((m_ready.load(std::memory_order_acquire) & TRAJ_FRESH)==0) {
+        return false;
+    }
+    int ready = m_ready.exchange(m_front,std::memory_order_acq_rel);
+    m_front = ready & TRAJ_INDEX_MASK;
+    if (m_buffers[m_front].request <= m_cancelled) {
+        m_buffers[m_front].store.Clear();
+        m_buffers[m_front].line.Clear();
+    }
+    return true;
+}
+
+const trajectory& TrajectoryService::Latest() const {
+    return m_buffers[m_front];
+}
+
+unsigned int TrajectoryService::NumFinished() const {
+    return m_numFinished;
+}
+
+unsigned int TrajectoryService::NumCancelled() const {
+    return m_numCancelled;
+}
+
+void TrajectoryService::calcRHS( const double *y, double *dydx ) const {
+    m_table.CalcRHS(y,dydx);
+}
+
+// *********************************** protected methods ******************************
+
+void TrajectoryService::workerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_quit) {
+        if (!m_pending) {
+            m_wake.wait(lock);
+            continue;
+        }
+        request req = m_request;
+        m_pending = false;
+        lock.unlock();
+
+        // Rebuilding can take a while for large magnet arrays; a newer
+        // request is checked for once it is done.
+        if (!m_valid || req.params!=m_params) {
+            m_params = req.params;
+            m_table.Build(m_params);
+            m_table.BuildTree(m_params);
+            m_table.BuildFieldGrid(m_params,1);
+            m_equilibria.Solve(m_params);
+            m_valid = true;
+        }
+
+        trajectory &traj = m_buffers[m_back];
+        bool done = false;
+        switch (req.params.m_integrator) {
+            default:
+            case RK_CASH_KARP:
+                done = integrate<CashKarp>(req,traj);
+                break;
+            case RK_DOPRI5:
+                done = integrate<DormandPrince5>(req,traj);
+                break;
+            case RK_BS23:
+                done = integrate<BogackiShampine3>(req,traj);
+                break;
+        }
+
+        if (done) {
+            publish();
+            m_numFinished++;
+        } else {
+            m_numCancelled++;
+        }
+        lock.lock();
+        if (done && m_notify) {
+            m_notify();
+        }
+    }
+}
+
+/**
+ *  Swap the filled back buffer with the ready one.
+ */
+void TrajectoryService::publish() {
+    int ready = m_ready.exchange(m_back | TRAJ_FRESH,std::memory_order_acq_rel);
+    m_back = ready & TRAJ_INDEX_MASK;
+}
+
+bool TrajectoryService::isStale( unsigned int number ) const {
+    return (m_newest.load(std::memory_order_relaxed)!=number);
+}
+
+/**
+ *  Same integration as the former SystemData::calcTrajectory, but not limited
+ *  by the number of points: the trajectory ends as soon as the bob is trapped
+ *  by a minimum of the potential, at maxTime, or at the step size floor. Every
+ *  step checks for a newer request, which is a single atomic load. The
+ *  derivative and the dense output coefficient are stored with each node;
+ *  only the first maxNumPoints nodes go into the line.
+ * @return false if the request was superseded.
+ */
+template <class Tableau>
+bool TrajectoryService::integrate( const request &req, trajectory &traj ) {
+    double y[4];
+    y[0] = req.x0;
+    y[1] = req.y0;
+    y[2] = 0.0;
+    y[3] = 0.0;
+
+    traj.store.Clear();
+    traj.line.SetTolerance(req.tolerance);
+    traj.line.Clear();
+    traj.x0 = req.x0;
+    traj.y0 = req.y0;
+    traj.request = req.number;
+    traj.trapped = false;
+
+    double t = 0.0;
+    double h = 0.005;
+    double hdid, hnext;
+
+    Stepper<Tableau,4> stepper(1e-8,1e-8);
+    stepper.Init(*this,y);
+    traj.store.Append(t,y,stepper.Deriv());
+    traj.line.Add(y[0],y[1]);
+
+    while (!traj.trapped && t<req.maxTime) {
+        if (isStale(req.number)) {
+            return false;
+        }
+        stepper.Step(*this,y,h,hdid,hnext);
+        t += hdid;
+        traj.store.Append(t,y,stepper.Deriv(),stepper.Dense());
+        if (traj.store.NumNodes()<=req.maxNumPoints) {
+            traj.line.Add(y[0],y[1]);
+        }
+
+        if (fabs(hnext)<1e-8) {
+            break;
+        }
+        h = hnext;
+        traj.trapped = (m_equilibria.CapturedBy(y)>=0);
+    }
+    return !isStale(req.number);
+}
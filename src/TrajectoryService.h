@@ -0,0 +1,150 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the background trajectory service.
+    @file TrajectoryService.h
+*/
+
+#ifndef MPSIM_TRAJECTORY_SERVICE_H
+#define MPSIM_TRAJECTORY_SERVICE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "Equilibria.h"
+#include "MagnetTable.h"
+#include "PendulumParams.h"
+#include "PolylineSimplifier.h"
+#include "RKStepper.h"
+#include "TrajectoryStore.h"
+
+/**
+ *  Trajectory of the bob released at rest from (x0,y0).
+ */
+typedef struct trajectory_t {
+    TrajectoryStore  store;        //!< one node per integration step
+    PolylineSimplifier  line;      //!< first positions, simplified while integrating
+    double        x0, y0;
+    unsigned int  request;         //!< number of the request it answers
+    bool          trapped;         //!< ends in the trapping region of a magnet
+} trajectory;
+
+
+/**
+ * @brief The TrajectoryService class
+ *
+ *  Integrates trajectories on a worker thread. Only the newest request counts:
+ *  a request replaces the one that is still pending, and the worker gives up
+ *  the one it is integrating as soon as a newer one arrives. However many
+ *  mouse events come in while the bob is dragged, the worker only ever works
+ *  on the newest position.
+ *
+ *  Finished trajectories are handed over by a triple buffer. The worker fills
+ *  the back buffer and swaps it with the ready one; Fetch() swaps the ready
+ *  buffer with the front one if it is new. Neither side ever waits for the
+ *  other. There must be a single consumer; Latest() is only valid in the
+ *  thread that calls Fetch().
+ *
+ *  The worker keeps its own magnet table and equilibria, which are rebuilt
+ *  only if the parameters of a request differ from those of the previous one.
+ */
+class TrajectoryService
+{
+public:
+    TrajectoryService();
+    ~TrajectoryService();
+
+public:
+    void   Start();
+    void   Stop();   //!< Cancel all requests and join the worker.
+
+    /** Request the trajectory from (x0,y0). Replaces a pending request.
+     *  It ends once the bob is trapped, at maxTime, or if the step size
+     *  drops below the minimum of the stepper.
+     * @param params        Pendulum parameters.
+     * @param x0            Initial x-position.
+     * @param y0            Initial y-position.
+     * @param maxTime       Maximum integration time.
+     * @param maxNumPoints  Points of the simplified line; the store keeps all nodes.
+     * @param tolerance     Tolerance of the simplified line.
+     * @return number of the request.
+     */
+    unsigned int  Request( const PendulumParams &params, double x0, double y0, double maxTime,
+                           int maxNumPoints, double tolerance = 0.0 );
+
+    /** Drop the pending request and abort the running one. Trajectories
+     *  that were published before are not returned by Fetch() anymore.
+     */
+    void   Cancel();
+
+    /** Function that is called by the worker after a trajectory was
+     *  published. It must not block.
+     */
+    void   SetNotify( std::function<void()> func );
+
+    /** Take the newest published trajectory. If it was cancelled in the
+     *  meantime, it is returned empty.
+     * @return true if it is newer than the last one taken.
+     */
+    bool   Fetch();
+    const trajectory&  Latest() const;
+
+    unsigned int  NumFinished() const;
+    unsigned int  NumCancelled() const;
+
+    /** Cartesian equations of motion; called by the Stepper.
+     */
+    void   calcRHS( const double *y, double *dydx ) const;
+
+protected:
+    struct request {
+        PendulumParams  params;
+        double  x0, y0;
+        double  maxTime;
+        int     maxNumPoints;
+        double  tolerance;
+        unsigned int  number;
+    };
+
+    void   workerLoop();
+    void   publish();
+    bool   isStale( unsigned int number ) const;
+
+    template <class Tableau>
+    bool   integrate( const request &req, trajectory &traj );
+
+private:
+    std::thread  m_thread;
+    std::mutex   m_mutex;
+    std::condition_variable  m_wake;
+    bool     m_quit;
+    bool     m_pending;
+    request  m_request;                     //!< pending request, guarded by m_mutex
+    std::atomic<unsigned int>  m_newest;    //!< number of the newest request
+    std::atomic<unsigned int>  m_cancelled; //!< requests up to this number were cancelled
+    std::function<void()>      m_notify;
+
+    // worker only
+    PendulumParams  m_params;
+    MagnetTable     m_table;
+    Equilibria      m_equilibria;
+    bool            m_valid;
+
+    trajectory  m_buffers[3];
+    int         m_back;                     //!< worker only
+    int         m_front;                    //!< consumer only
+    std::atomic<int>  m_ready;              //!< last published buffer, see TRAJ_FRESH
+
+    std::atomic<unsigned int>  m_numFinished;
+    std::atomic<unsigned int>  m_numCancelled;
+};
+
+#endif // MPSIM_TRAJECTORY_SERVICE_H
@@ -0,0 +1,139 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @file TrajectoryStore.cpp
+*/
+
+#include "TrajectoryStore.h"
+
+#define TRAJ_CHUNK_MASK  (TRAJ_CHUNK_SIZE-1)
+
+
+TrajectoryStore::TrajectoryStore() :
+    m_numNodes(0)
+{
+}
+
+TrajectoryStore::~TrajectoryStore() {
+    for(unsigned int c=0; c<m_chunks.size(); c++) {
+        delete m_chunks[c];
+    }
+    m_chunks.clear();
+}
+
+void TrajectoryStore::Clear() {
+    m_numNodes = 0;
+}
+
+void TrajectoryStore::Append( double t, const double *y, const double *dydt, const double *dense ) {
+    int c = m_numNodes >> TRAJ_CHUNK_BITS;
+    if (c>=static_cast<int>(m_chunks.size())) {
+        m_chunks.push_back(new chunk);
+    }
+    chunk &ch = *m_chunks[c];
+    int j = m_numNodes & TRAJ_CHUNK_MASK;
+    ch.t[j] = t;
+    for(int k=0; k<4; k++) {
+        ch.y[k][j] = y[k];
+        ch.dydt[k][j] = dydt[k];
+        ch.dense[k][j] = (dense!=NULL ? dense[k] : 0.0);
+    }
+    m_numNodes++;
+}
+
+int TrajectoryStore::NumNodes() const {
+    return m_numNodes;
+}
+
+bool TrajectoryStore::IsEmpty() const {
+    return (m_numNodes==0);
+}
+
+double TrajectoryStore::Time( int i ) const {
+    return chunkOf(i).t[i & TRAJ_CHUNK_MASK];
+}
+
+void TrajectoryStore::State( int i, double *y ) const {
+    const chunk &ch = chunkOf(i);
+    int j = i & TRAJ_CHUNK_MASK;
+    for(int k=0; k<4; k++) {
+        y[k] = ch.y[k][j];
+    }
+}
+
+double TrajectoryStore::StartTime() const {
+    return (m_numNodes>0 ? Time(0) : 0.0);
+}
+
+double TrajectoryStore::EndTime() const {
+    return (m_numNodes>0 ? Time(m_numNodes-1) : 0.0);
+}
+
+int TrajectoryStore::Find( double t ) const {
+    if (m_numNodes<2 || t<=Time(0)) {
+        return 0;
+    }
+    if (t>=Time(m_numNodes-1)) {
+        return m_numNodes-1;
+    }
+    int lo = 0;
+    int hi = m_numNodes-1;
+    while (hi-lo>1) {
+        int mid = (lo+hi)/2;
+        if (Time(mid)<=t) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void TrajectoryStore::Evaluate( double t, double *y ) const {
+    if (m_numNodes==0) {
+        for(int k=0; k<4; k++) {
+            y[k] = 0.0;
+        }
+        return;
+    }
+    int i = Find(t);
+    if (i>=m_numNodes-1 || t<=Time(i)) {
+        State(i,y);
+        return;
+    }
+
+    const chunk &c0 = chunkOf(i);
+    const chunk &c1 = chunkOf(i+1);
+    int j0 = i & TRAJ_CHUNK_MASK;
+    int j1 = (i+1) & TRAJ_CHUNK_MASK;
+
+    double h = c1.t[j1] - c0.t[j0];
+    double s = (t - c0.t[j0])/h;
+    double r = 1.0 - s;
+    for(int k=0; k<4; k++) {
+        double dy = c1.y[k][j1] - c0.y[k][j0];
+        double r3 = h*c0.dydt[k][j0] - dy;
+        double r4 = dy - h*c1.dydt[k][j1] - r3;
+        y[k] = c0.y[k][j0] + s*(dy + r*(r3 + s*(r4 + r*c1.dense[k][j1])));
+    }
+}
+
+void TrajectoryStore::CopyPositions( float *xy, int first, int num ) const {
+    for(int i=first; i<first+num; ) {
+        const chunk &ch = chunkOf(i);
+        int j = i & TRAJ_CHUNK_MASK;
+        int end = j + (first + num - i);
+        if (end>TRAJ_CHUNK_SIZE) {
+            end = TRAJ_CHUNK_SIZE;
+        }
+        for(; j<end; j++, i++) {
+            *(xy++) = static_cast<float>(ch.y[0][j]);
+            *(xy++) = static_cast<float>(ch.y[1][j]);
+        }
+    }
+}
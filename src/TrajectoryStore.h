@@ -0,0 +1,101 @@
+/**
+    Copyright (c) 2014, Universitaet Stuttgart, VISUS, SFB 716, Thomas Mueller
+
+    MPSim is licensed under a Creative Commons
+    Attribution-ShareAlike 3.0 Unported License.
+
+    http://creativecommons.org/licenses/by-sa/3.0/deed.en_US
+
+    @brief Header file for the chunked trajectory storage.
+    @file TrajectoryStore.h
+*/
+
+#ifndef MPSIM_TRAJECTORY_STORE_H
+#define MPSIM_TRAJECTORY_STORE_H
+
+#include <cstddef>
+#include <vector>
+
+#define TRAJ_CHUNK_BITS  12
+#define TRAJ_CHUNK_SIZE  (1<<TRAJ_CHUNK_BITS)   // nodes per chunk
+
+/**
+ * @brief The TrajectoryStore class
+ *
+ *  Nodes of an integrated trajectory: time, state y = (x,y,vx,vy), its
+ *  derivative, and the dense output coefficient of the step that ends at the
+ *  node. The nodes live in fixed-size chunks with one column per quantity, so
+ *  appending never moves a node and there is no upper limit. Clear() keeps
+ *  the chunks for the next trajectory.
+ *
+ *  Between two nodes the state is the dense output of the stepper, see
+ *  Stepper::Dense. For the step from t_i to t_{i+1} = t_i + h, s = (t-t_i)/h
+ *  and dy = y_{i+1} - y_i,
+ *
+ *     y(t) = y_i + s*(dy + (1-s)*(r3 + s*(r4 + (1-s)*r5))),
+ *     r3 = h*f_i - dy,   r4 = dy - h*f_{i+1} - r3.
+ *
+ *  With Dormand-Prince, r5 makes it accurate to fourth order in h. The other
+ *  methods have r5 = 0, i.e. the cubic Hermite interpolant, which is third
+ *  order and thus below the order of the Cash-Karp step itself. Find()
+ *  locates the step of a time by bisection.
+ */
+class TrajectoryStore
+{
+public:
+    TrajectoryStore();
+    ~TrajectoryStore();
+
+public:
+    void   Clear();
+
+    /** Append a node; the times have to increase.
+     * @param t      Time.
+     * @param y      State (x,y,vx,vy).
+     * @param dydt   Derivative of the state.
+     * @param dense  Dense output coefficient r5 of the step to this node; NULL for zero.
+     */
+    void   Append( double t, const double *y, const double *dydt, const double *dense = NULL );
+
+    int    NumNodes() const;
+    bool   IsEmpty() const;
+
+    double Time( int i ) const;
+    void   State( int i, double *y ) const;
+    double StartTime() const;
+    double EndTime() const;
+
+    /** Index i of the step with t_i <= t < t_{i+1}; the first or last
+     *  node for times outside.
+     */
+    int    Find( double t ) const;
+
+    /** State at time t, clamped to the time span of the nodes.
+     */
+    void   Evaluate( double t, double *y ) const;
+
+    /** Write (x,y) of the nodes first..first+num-1 as float pairs.
+     */
+    void   CopyPositions( float *xy, int first, int num ) const;
+
+protected:
+    struct chunk {
+        double  t[TRAJ_CHUNK_SIZE];
+        double  y[4][TRAJ_CHUNK_SIZE];
+        double  dydt[4][TRAJ_CHUNK_SIZE];
+        double  dense[4][TRAJ_CHUNK_SIZE];   //!< r5 of the step that ends at the node
+    };
+
+    const chunk& chunkOf( int i ) const {
+        return *m_chunks[i >> TRAJ_CHUNK_BITS];
+    }
+
+private:
+    TrajectoryStore( const TrajectoryStore &other );
+    TrajectoryStore& operator=( const TrajectoryStore &other );
+
+    std::vector<chunk*>  m_chunks;   //!< allocated chunks, also the unused ones
+    int   m_numNodes;
+};
+
+#endif // MPSIM_TRAJECTORY_STORE_H